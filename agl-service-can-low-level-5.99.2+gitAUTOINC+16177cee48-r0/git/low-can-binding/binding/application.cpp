@@ -85,6 +85,45 @@ uint32_t application_t::get_signal_id(can_signal_t& sig) const
 void application_t::set_active_message_set(uint8_t id)
 {
 	active_message_set_ = id;
+	utils::signals_manager_t::instance().clear_signals_index();
+}
+
+/// @brief Replace the message sets generated at build time by the ones of a
+/// binary signals database, compiled from a JSON signals description by
+/// signals-compiler. Must be called before any subscription.
+///
+/// @param[in] path - signals database file path.
+///
+/// @return 0 on success, -1 if the database can't be used, generated message
+/// sets are kept in that case.
+int application_t::load_signals_database(const std::string& path)
+{
+	std::vector<std::shared_ptr<can_message_set_t> > message_sets;
+	utils::signals_database_t database;
+	if(database.open(path) < 0 || database.load(message_sets) < 0 || message_sets.empty())
+	{
+		AFB_ERROR("Signals database %s can't be loaded, keep built-in signals", path.c_str());
+		return -1;
+	}
+
+	for(auto& cms: message_sets)
+	{
+		for(auto& cmd : cms->get_can_message_definition())
+		{
+			cmd->set_parent(cms.get());
+			for(auto& sig: cmd->get_can_signals())
+				{sig->set_parent(cmd.get());}
+		}
+		for(auto& dm : cms->get_diagnostic_messages())
+			{dm->set_parent(cms.get());}
+	}
+
+	// Previous message sets may point into the previous database, drop them first.
+	can_message_set_.swap(message_sets);
+	message_sets.clear();
+	signals_database_ = std::move(database);
+	set_active_message_set(0);
+	return 0;
 }
 
 bool application_t::isEngineOn()
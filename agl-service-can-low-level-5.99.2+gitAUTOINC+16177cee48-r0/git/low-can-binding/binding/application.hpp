@@ -26,6 +26,7 @@
 #include "../can/can-message-set.hpp"
 #include "../can/can-signals.hpp"
 #include "../diagnostic/diagnostic-manager.hpp"
+#include "../utils/signals-database.hpp"
 
 ///
 /// @brief Class represents a configuration attached to the binding.
@@ -45,6 +46,7 @@ class application_t
 		diagnostic_manager_t diagnostic_manager_; ///< Diagnostic manager use to manage diagnostic message communication.
 		uint8_t active_message_set_ = 0; ///< Which is the active message set ? Default to 0.
 
+		utils::signals_database_t signals_database_; ///< signals_database_ - mapped signals database, if any. Declared before can_message_set_ which points into it.
 		std::vector<std::shared_ptr<can_message_set_t> > can_message_set_; ///< Vector holding all message set from JSON signals description file
 
 		std::map<std::string, std::shared_ptr<low_can_socket_t> > can_devices_; ///< Map containing all independant opened CAN sockets, key is the socket int value.
@@ -82,6 +84,8 @@ class application_t
 
 		void set_active_message_set(uint8_t id);
 
+		int load_signals_database(const std::string& path);
+
 /*
 		/// TODO: implement this function as method into can_bus class
 		/// @brief Pre initialize actions made before CAN bus initialization
@@ -21,6 +21,8 @@
 
 #include <map>
 #include <queue>
+#include <algorithm>
+#include <cstdlib>
 #include <mutex>
 #include <vector>
 #include <thread>
@@ -29,6 +31,7 @@
 
 #include "openxc.pb.h"
 #include "application.hpp"
+#include "low-can-cyclic.hpp"
 #include "../can/can-encoder.hpp"
 #include "../can/can-bus.hpp"
 #include "../can/can-signals.hpp"
@@ -36,6 +39,7 @@
 #include "../utils/signals.hpp"
 #include "../diagnostic/diagnostic-message.hpp"
 #include "../utils/openxc-utils.hpp"
+#include "../utils/trace.hpp"
 
 ///******************************************************************************
 ///
@@ -50,14 +54,7 @@ void on_no_clients(std::shared_ptr<low_can_subscription_t> can_subscription, uin
 	if( ! can_subscription->get_diagnostic_message().empty() && can_subscription->get_diagnostic_message(pid) != nullptr)
 	{
 		DiagnosticRequest diag_req = can_subscription->get_diagnostic_message(pid)->build_diagnostic_request();
-		active_diagnostic_request_t* adr = application_t::instance().get_diagnostic_manager().find_recurring_request(diag_req);
-		if( adr != nullptr)
-		{
-			is_permanent_recurring_request = adr->get_permanent();
-
-			if(! is_permanent_recurring_request)
-				application_t::instance().get_diagnostic_manager().cleanup_request(adr, true);
-		}
+		is_permanent_recurring_request = application_t::instance().get_diagnostic_manager().cleanup_recurring_request(diag_req, true);
 	}
 
 	if(! is_permanent_recurring_request)
@@ -67,17 +64,27 @@ void on_no_clients(std::shared_ptr<low_can_subscription_t> can_subscription, uin
 void on_no_clients(std::shared_ptr<low_can_subscription_t> can_subscription, std::map<int, std::shared_ptr<low_can_subscription_t> >& s)
 {
 	auto it = s.find(can_subscription->get_index());
+	if(it == s.end())
+		return;
 	s.erase(it);
+	utils::signals_manager_t::instance().update_dispatch_table();
 }
 
-static void push_n_notify(const can_message_t& cm)
+static void push_n_notify(const std::vector<can_message_t>& vcm)
 {
 	can_bus_t& cbm = application_t::instance().get_can_bus_manager();
+	int pushed = 0;
+	for(const auto& cm: vcm)
 	{
-		std::lock_guard<std::mutex> can_message_lock(cbm.get_can_message_mutex());
-	 	cbm.push_new_can_message(cm);
+		// Sure we got a valid CAN message ?
+		if(! cm.get_id() == 0 && ! cm.get_length() == 0)
+		{
+			cbm.push_new_can_message(cm);
+			pushed++;
+		}
 	}
-	cbm.get_new_can_message_cv().notify_one();
+	if(pushed)
+		{cbm.notify_new_can_message();}
 }
 
 int read_message(sd_event_source *event_source, int fd, uint32_t revents, void *userdata)
@@ -85,13 +92,14 @@ int read_message(sd_event_source *event_source, int fd, uint32_t revents, void *
 	low_can_subscription_t* can_subscription = (low_can_subscription_t*)userdata;
 	if ((revents & EPOLLIN) != 0)
 	{
-		can_message_t cm;
+		utils::scoped_latency_t latency(application_t::instance().get_can_bus_manager().get_read_latency());
+		// Event loop is single threaded, reuse the buffer to not allocate at each read.
+		static std::vector<can_message_t> vcm;
+		vcm.clear();
 		utils::socketcan_bcm_t& s = can_subscription->get_socket();
-		s >> cm;
+		s >> vcm;
 
-		// Sure we got a valid CAN message ?
-		if(! cm.get_id() == 0 && ! cm.get_length() == 0)
-			{push_n_notify(cm);}
+		push_n_notify(vcm);
 	}
 
 	// check if error or hangup
@@ -103,6 +111,41 @@ int read_message(sd_event_source *event_source, int fd, uint32_t revents, void *
 	return 0;
 }
 
+int read_bus_message(sd_event_source *event_source, int fd, uint32_t revents, void *userdata)
+{
+	low_can_reader_t* reader = (low_can_reader_t*)userdata;
+	if ((revents & EPOLLIN) != 0)
+	{
+		can_bus_t& cbm = application_t::instance().get_can_bus_manager();
+		utils::scoped_latency_t latency(cbm.get_read_latency());
+
+		// Event loop is single threaded, reuse the buffer to not allocate at each read.
+		static std::vector<can_message_t> vcm;
+		vcm.clear();
+		utils::socketcan_bcm_t& s = reader->get_socket();
+		s >> vcm;
+
+		int pushed = 0;
+		for(auto& cm: vcm)
+		{
+			// Sure we got a valid CAN message ?
+			if(! cm.get_id() == 0 && ! cm.get_length() == 0)
+				{pushed += reader->dispatch(cm, cbm);}
+		}
+		if(pushed)
+			{cbm.notify_new_can_message();}
+	}
+
+	// check if error or hangup
+	if ((revents & (EPOLLERR|EPOLLRDHUP|EPOLLHUP)) != 0)
+	{
+		sd_event_source_unref(event_source);
+		reader->set_event_source(nullptr);
+		reader->get_socket().close();
+	}
+	return 0;
+}
+
 ///******************************************************************************
 ///
 ///		Subscription and unsubscription
@@ -176,6 +219,24 @@ static int subscribe_unsubscribe_signal(struct afb_req request,
 static int add_to_event_loop(std::shared_ptr<low_can_subscription_t>& can_subscription)
 {
 		struct sd_event_source* event_source = nullptr;
+		std::shared_ptr<low_can_reader_t> reader = can_subscription->get_reader();
+
+		// Subscriptions on a bus reader are read by it, only the reader has to
+		// be watched and only once.
+		if(reader)
+		{
+			if(reader->get_event_source())
+				return 0;
+			int ret = sd_event_add_io(afb_daemon_get_event_loop(),
+				&event_source,
+				reader->get_socket().socket(),
+				EPOLLIN,
+				read_bus_message,
+				reader.get());
+			reader->set_event_source(event_source);
+			return ret;
+		}
+
 		return ( sd_event_add_io(afb_daemon_get_event_loop(),
 			&event_source,
 			can_subscription->get_socket().socket(),
@@ -219,8 +280,7 @@ static int subscribe_unsubscribe_diagnostic_messages(struct afb_req request,
 			AFB_DEBUG("Signal: %s subscribed", sig->get_name().c_str());
 			if(it == s.end() && add_to_event_loop(can_subscription) < 0)
 			{
-				diag_m.cleanup_request(
-					diag_m.find_recurring_request(*diag_req), true);
+				diag_m.cleanup_recurring_request(*diag_req, false);
 				AFB_WARNING("signal: %s isn't supported. Canceling operation.",  sig->get_name().c_str());
 				return -1;
 			}
@@ -300,10 +360,92 @@ static int subscribe_unsubscribe_signals(struct afb_req request,
 
 	rets += subscribe_unsubscribe_diagnostic_messages(request, subscribe, signals.diagnostic_messages, event_filter, s, false);
 	rets += subscribe_unsubscribe_can_signals(request, subscribe, signals.can_signals, event_filter, s);
+	sm.update_dispatch_table();
 
 	return rets;
 }
 
+///
+/// @brief subscribe to a snapshot of the signals matching a pattern: a single event
+/// pushed at the snapshot rate with the last value of each signal. The snapshot is
+/// created at first subscription, with one member subscription by signal to decode it.
+///
+/// @param[in] afb_req request : contains original request use to subscribe or unsubscribe
+/// @param[in] subscribe boolean value, which chooses between a subscription operation or an unsubscription
+/// @param[in] tag - the signals pattern, naming the snapshot event.
+/// @param[in] signals -  struct containing vectors with can_signal_t and diagnostic_messages found for the tag
+/// @param[in] event_filter - filter with the snapshot rate, frequency thins the member subscriptions.
+///
+/// @return Number of signals in the snapshot, -1 on error.
+///
+static int subscribe_unsubscribe_snapshot(struct afb_req request,
+										bool subscribe,
+										const std::string& tag,
+										const struct utils::signals_found& signals,
+										struct event_filter_t event_filter)
+{
+	utils::signals_manager_t& sm = utils::signals_manager_t::instance();
+
+	std::lock_guard<std::mutex> subscribed_signals_lock(sm.get_subscribed_signals_mutex());
+	std::map<int, std::shared_ptr<low_can_subscription_t> >& s = sm.get_subscribed_signals();
+	std::map<std::pair<std::string, float>, std::shared_ptr<low_can_snapshot_t> >& snapshots = sm.get_snapshots();
+
+	if(! signals.diagnostic_messages.empty())
+		{AFB_WARNING("Diagnostic messages can't be part of snapshot %s, they are ignored.", tag.c_str());}
+
+	std::shared_ptr<low_can_snapshot_t> snapshot;
+	auto it = snapshots.find(std::make_pair(tag, event_filter.snapshot));
+	if(it != snapshots.end())
+		{snapshot = it->second;}
+	else if(subscribe)
+	{
+		if(signals.can_signals.empty())
+		{
+			AFB_NOTICE("No CAN signal found for snapshot %s.", tag.c_str());
+			return -1;
+		}
+
+		// Members don't need to receive CAN messages more often than the snapshot is pushed.
+		if(event_filter.frequency == 0)
+			{event_filter.frequency = event_filter.snapshot;}
+
+		snapshot = std::make_shared<low_can_snapshot_t>(tag, event_filter.snapshot, signals.can_signals);
+		snapshots[std::make_pair(tag, event_filter.snapshot)] = snapshot;
+		for(const auto& sig: signals.can_signals)
+		{
+			std::shared_ptr<low_can_subscription_t> member = std::make_shared<low_can_subscription_t>(low_can_subscription_t(event_filter));
+			if(member->create_rx_filter(sig) < 0 || add_to_event_loop(member) < 0)
+			{
+				AFB_ERROR("Can't subscribe signal %s of snapshot %s", sig->get_name().c_str(), tag.c_str());
+				sm.remove_snapshot(snapshot.get());
+				return -1;
+			}
+			member->set_event({nullptr, nullptr});
+			s[member->get_index()] = member;
+			snapshot->add_member(member->get_index());
+		}
+		if(snapshot->start() < 0)
+		{
+			sm.remove_snapshot(snapshot.get());
+			return -1;
+		}
+		sm.update_dispatch_table();
+	}
+	else
+	{
+		AFB_NOTICE("Snapshot %s isn't subscribed, no need to unsubscribe.", tag.c_str());
+		return -1;
+	}
+
+	if(request.itf && request.closure &&
+	   ((subscribe ? afb_req_subscribe : afb_req_unsubscribe)(request, snapshot->get_event())) < 0)
+	{
+		AFB_ERROR("Operation goes wrong for snapshot: %s", tag.c_str());
+		return -1;
+	}
+	return (int)snapshot->get_can_signals().size();
+}
+
 static int one_subscribe_unsubscribe(struct afb_req request,
 									bool subscribe,
 									const std::string& tag,
@@ -326,6 +468,23 @@ static int one_subscribe_unsubscribe(struct afb_req request,
 		if (json_object_object_get_ex(filter, "max", &obj)
 		&& (json_object_is_type(obj, json_type_double) || json_object_is_type(obj, json_type_int)))
 			{event_filter.max = (float)json_object_get_double(obj);}
+		if (json_object_object_get_ex(filter, "snapshot", &obj)
+		&& (json_object_is_type(obj, json_type_double) || json_object_is_type(obj, json_type_int)))
+			{event_filter.snapshot = (float)json_object_get_double(obj);}
+	}
+
+	// computes the delivery options
+	if (json_object_object_get_ex(args, "format", &obj) && json_object_is_type(obj, json_type_string))
+	{
+		if (strcmp(json_object_get_string(obj), "binary") == 0)
+			{event_filter.format = event_format_t::BINARY;}
+		else if (strcmp(json_object_get_string(obj), "json") != 0)
+			{AFB_WARNING("Unknown event format '%s', using json", json_object_get_string(obj));}
+	}
+	if (json_object_object_get_ex(args, "batch", &obj) && json_object_is_type(obj, json_type_int))
+	{
+		int batch = json_object_get_int(obj);
+		event_filter.batch = batch < 1 ? 1 : (batch > EVENT_BATCH_MAX ? EVENT_BATCH_MAX : (unsigned int)batch);
 	}
 
 	// subscribe or unsubscribe
@@ -336,6 +495,8 @@ static int one_subscribe_unsubscribe(struct afb_req request,
 		AFB_NOTICE("No signal(s) found for %s.", tag.c_str());
 		ret = -1;
 	}
+	else if (event_filter.snapshot > 0)
+		{ret = subscribe_unsubscribe_snapshot(request, subscribe, tag, sf, event_filter);}
 	else
 		{ret = subscribe_unsubscribe_signals(request, subscribe, sf, event_filter);}
 
@@ -408,41 +569,104 @@ void unsubscribe(struct afb_req request)
 	do_subscribe_unsubscribe(request, false);
 }
 
-static int send_frame(const std::string& bus_name, const struct can_frame& cf)
+static int send_frame(const std::string& bus_name, const struct canfd_frame& cf, bool fd)
 {
 	std::map<std::string, std::shared_ptr<low_can_socket_t> >& cd = application_t::instance().get_can_devices();
 
 	if( cd.count(bus_name) == 0)
 		{cd[bus_name] = std::make_shared<low_can_socket_t>(low_can_socket_t());}
 
-	return cd[bus_name]->tx_send(cf, bus_name);
+	return cd[bus_name]->tx_send(cf, bus_name, fd);
 }
 
-static int write_raw_frame(const std::string& bus_name, uint32_t can_id, uint8_t can_dlc, struct json_object* can_data)
+/// @brief Check a CAN FD frame length, above 8 bytes only the lengths a DLC
+/// can encode are valid.
+///
+/// @param[in] len - frame length in bytes.
+///
+/// @return True if a CAN FD frame can have that length.
+static bool is_valid_canfd_len(int len)
 {
-	int rc = 0;
-	struct can_frame cf;
+	switch(len)
+	{
+		case 12: case 16: case 20: case 24: case 32: case 48: case 64:
+			return true;
+		default:
+			return len >= 0 && len <= CAN_MAX_DLEN;
+	}
+}
 
-	::memset(&cf, 0, sizeof(cf));
+/// @brief Build a frame from the "frame" object of a write request.
+///
+/// @param[in] json_frame - {"can_id": int, "can_dlc": int, "can_data": [int...]} with
+///  optional "fd" and "brs" booleans.
+/// @param[out] cf - built frame.
+/// @param[out] fd - true if the frame is a CAN FD frame.
+///
+/// @return 0 if ok else -1
+static int build_raw_frame(struct json_object* json_frame, struct canfd_frame& cf, bool& fd)
+{
+	struct json_object* json_can_id = nullptr,
+		*json_can_dlc = nullptr,
+		*json_can_data = nullptr,
+		*json_fd = nullptr,
+		*json_brs = nullptr;
+
+	if(! (json_object_object_get_ex(json_frame, "can_id", &json_can_id) && (json_object_is_type(json_can_id, json_type_double) || json_object_is_type(json_can_id, json_type_int))) ||
+	   ! (json_object_object_get_ex(json_frame, "can_dlc", &json_can_dlc) && (json_object_is_type(json_can_dlc, json_type_double) || json_object_is_type(json_can_dlc, json_type_int))) ||
+	   ! (json_object_object_get_ex(json_frame, "can_data", &json_can_data) && json_object_is_type(json_can_data, json_type_array)))
+	{
+		AFB_ERROR("Frame object malformed (must be \n \"frame\": {\"can_id\": int, \"can_dlc\": int, \"can_data\": [ int, int , int, int ,int , int ,int ,int], \"fd\": bool, \"brs\": bool}");
+		return -1;
+	}
+
+	// Optional CAN FD frame, with bit rate switch or not.
+	fd = json_object_object_get_ex(json_frame, "fd", &json_fd) && json_object_get_boolean(json_fd);
+	bool brs = json_object_object_get_ex(json_frame, "brs", &json_brs) && json_object_get_boolean(json_brs);
+
+	int can_dlc = json_object_get_int(json_can_dlc);
+	size_t maxdlen = fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+	size_t n = json_object_array_length(json_can_data);
+	if(can_dlc < 0 || (size_t)can_dlc > maxdlen || n > maxdlen)
+	{
+		AFB_ERROR("Frame too long, %d bytes at most are allowed%s", (int)maxdlen, fd ? "" : " without \"fd\": true");
+		return -1;
+	}
+	if(fd && ! is_valid_canfd_len(can_dlc))
+	{
+		AFB_ERROR("Invalid CAN FD frame length %d, must be 0 to 8, 12, 16, 20, 24, 32, 48 or 64", can_dlc);
+		return -1;
+	}
 
-	cf.can_id = can_id;
-	cf.can_dlc = can_dlc;
+	::memset(&cf, 0, sizeof(cf));
+	cf.can_id = json_object_get_int(json_can_id);
+	cf.len = (uint8_t)can_dlc;
+	if(fd && brs)
+		cf.flags = CANFD_BRS;
 
 	struct json_object *x;
-	size_t n = json_object_array_length(can_data);
-	if(n <= 8)
+	for (size_t i = 0 ; i < n ; i++)
 	{
-		for (int i = 0 ; i < n ; i++)
-		{
-			x = json_object_array_get_idx(can_data, i);
-			cf.data[i] = json_object_get_type(x) == json_type_int ? (uint8_t)json_object_get_int(x) : 0;
-		}
+		x = json_object_array_get_idx(json_can_data, i);
+		cf.data[i] = json_object_get_type(x) == json_type_int ? (uint8_t)json_object_get_int(x) : 0;
 	}
 
+	return 0;
+}
+
+static int write_raw_frame(const std::string& bus_name, struct json_object* json_frame)
+{
+	int rc = 0;
+	struct canfd_frame cf;
+	bool fd;
+
+	if(build_raw_frame(json_frame, cf, fd) < 0)
+		return -1;
+
 	const std::string found_device = application_t::instance().get_can_bus_manager().get_can_device_name(bus_name);
 	if( ! found_device.empty())
 	{
-		rc = send_frame(found_device, cf);
+		rc = send_frame(found_device, cf, fd);
 	}
 
 	return rc;
@@ -450,7 +674,7 @@ static int write_raw_frame(const std::string& bus_name, uint32_t can_id, uint8_t
 static int write_signal(const std::string& name, uint64_t value)
 {
 	int rc = 0;
-	struct can_frame cf;
+	struct canfd_frame cf;
 	struct utils::signals_found sf;
 
 	::memset(&cf, 0, sizeof(cf));
@@ -471,7 +695,7 @@ static int write_signal(const std::string& name, uint64_t value)
 			{
 				cf = encoder_t::build_frame(sig, value);
 				const std::string bus_name = sig->get_message()->get_bus_device_name();
-				rc = send_frame(bus_name, cf);
+				rc = send_frame(bus_name, cf, sig->get_message()->is_fd());
 			}
 			else
 			{
@@ -498,36 +722,291 @@ void write(struct afb_req request)
 		(json_object_object_get_ex(args, "bus_name", &json_name) && json_object_is_type(json_name, json_type_string) ) &&
 		(json_object_object_get_ex(args, "frame", &json_value) && json_object_is_type(json_value, json_type_object) ))
 	{
-		struct json_object* json_can_id = nullptr,
-			*json_can_dlc = nullptr,
-			*json_can_data = nullptr;
+		rc = write_raw_frame(json_object_get_string(json_name), json_value);
+	}
+	// Search signal then encode value.
+	else if(args != NULL &&
+		(json_object_object_get_ex(args, "signal_name", &json_name) && json_object_is_type(json_name, json_type_string)) &&
+		(json_object_object_get_ex(args, "signal_value", &json_value) && (json_object_is_type(json_value, json_type_double) || json_object_is_type(json_value, json_type_int))))
+	{
+		rc = write_signal(json_object_get_string(json_name),
+			(uint64_t)json_object_get_double(json_value));
+	}
+	else
+	{
+		AFB_ERROR("Request argument malformed. Please use the following syntax:");
+		rc = -1;
+	}
+
+	if (rc >= 0)
+		afb_req_success(request, NULL, NULL);
+	else
+		afb_req_fail(request, "error", NULL);
+}
+
+/// @brief A frame being built by a batch write, with the message it belongs to.
+struct batch_frame_t
+{
+	can_message_definition_t* message;
+	struct canfd_frame cf;
+};
+
+/// @brief Write several signals at once. Signals of the same CAN message are
+/// merged in a single frame, built over the last known payload of the message,
+/// then frames are sent with one socket operation by CAN bus. Nothing is sent
+/// if a signal isn't found, isn't writable or if its value doesn't fit.
+///
+/// @param[in] signals - array of {"signal_name": string, "signal_value": number}.
+///
+/// @return 0 if ok else -1
+static int write_signals(struct json_object* signals)
+{
+	std::vector<batch_frame_t> frames;
+	std::vector<std::pair<std::shared_ptr<can_signal_t>, uint64_t> > written;
+
+	for(int i = 0; i < json_object_array_length(signals); i++)
+	{
+		struct json_object* x = json_object_array_get_idx(signals, i),
+			*json_name = nullptr,
+			*json_value = nullptr;
 
-		if( (json_object_object_get_ex(json_value, "can_id", &json_can_id) && (json_object_is_type(json_can_id, json_type_double) || json_object_is_type(json_can_id, json_type_int))) &&
-			(json_object_object_get_ex(json_value, "can_dlc", &json_can_dlc) && (json_object_is_type(json_can_dlc, json_type_double) || json_object_is_type(json_can_dlc, json_type_int))) &&
-			(json_object_object_get_ex(json_value, "can_data", &json_can_data) && json_object_is_type(json_can_data, json_type_array) ))
+		if(! (json_object_object_get_ex(x, "signal_name", &json_name) && json_object_is_type(json_name, json_type_string)) ||
+		   ! (json_object_object_get_ex(x, "signal_value", &json_value) && (json_object_is_type(json_value, json_type_double) || json_object_is_type(json_value, json_type_int))))
 		{
-			rc = write_raw_frame(json_object_get_string(json_name),
-				json_object_get_int(json_can_id),
-				(uint8_t)json_object_get_int(json_can_dlc),
-				json_can_data);
+			AFB_ERROR("Signal %d malformed (must be {\"signal_name\": string, \"signal_value\": number}). Nothing sent.", i);
+			return -1;
 		}
-		else
+
+		const std::string name = json_object_get_string(json_name);
+		uint64_t value = (uint64_t)json_object_get_double(json_value);
+
+		openxc_DynamicField search_key = build_DynamicField(name);
+		struct utils::signals_found sf = utils::signals_manager_t::instance().find_signals(search_key);
+		if (sf.can_signals.empty())
+		{
+			AFB_WARNING("No signal(s) found for %s. Nothing sent.", name.c_str());
+			return -1;
+		}
+
+		for(const auto& sig: sf.can_signals)
 		{
-			AFB_ERROR("Frame object malformed (must be \n \"frame\": {\"can_id\": int, \"can_dlc\": int, \"can_data\": [ int, int , int, int ,int , int ,int ,int]}");
+			if(! sig->get_writable())
+			{
+				AFB_WARNING("%s isn't writable. Nothing sent.", sig->get_name().c_str());
+				return -1;
+			}
+
+			can_message_definition_t* message = sig->get_message();
+			auto it = std::find_if(frames.begin(), frames.end(), [message](const batch_frame_t& f) { return f.message == message; });
+			if(it == frames.end())
+				{it = frames.insert(frames.end(), batch_frame_t{message, encoder_t::build_frame(*message)});}
+
+			if(! encoder_t::encode_signal(sig, value, it->cf))
+			{
+				AFB_WARNING("Value %llu doesn't fit in %s. Nothing sent.", (unsigned long long)value, sig->get_name().c_str());
+				return -1;
+			}
+			written.push_back(std::make_pair(sig, value));
+		}
+	}
+
+	// Frames keep the order of their first signal, on each CAN bus.
+	std::map<std::string, std::shared_ptr<low_can_socket_t> >& cd = application_t::instance().get_can_devices();
+	std::map<std::string, std::vector<struct utils::simple_bcm_msg> > bcm_msgs;
+	for(const auto& frame: frames)
+	{
+		const std::string bus_name = frame.message->get_bus_device_name();
+		if( cd.count(bus_name) == 0)
+			{cd[bus_name] = std::make_shared<low_can_socket_t>(low_can_socket_t());}
+
+		struct utils::simple_bcm_msg bcm_msg = cd[bus_name]->make_bcm_head(TX_SEND, 0, frame.message->is_fd() ? CAN_FD_FRAME : 0);
+		// A TX_SEND needs exactly one frame, even when its payload is all zeros.
+		bcm_msg.msg_head.nframes = 1;
+		bcm_msg.frames = frame.cf;
+		bcm_msgs[bus_name].push_back(bcm_msg);
+	}
+
+	// Only frames the kernel accepted update the last known values, a bus
+	// sending less than all its frames fails the whole batch.
+	int rc = 0;
+	std::map<std::string, size_t> sent;
+	for(const auto& bus: bcm_msgs)
+	{
+		ssize_t n = cd[bus.first]->tx_send(bus.second, bus.first);
+		sent[bus.first] = n > 0 ? (size_t)n : 0;
+		if(n < 0 || (size_t)n < bus.second.size())
 			rc = -1;
+	}
+
+	std::vector<can_message_definition_t*> committed;
+	std::map<std::string, size_t> rank;
+	for(const auto& frame: frames)
+	{
+		const std::string bus_name = frame.message->get_bus_device_name();
+		if(rank[bus_name]++ < sent[bus_name])
+		{
+			frame.message->set_last_value(frame.cf.data, frame.cf.len);
+			committed.push_back(frame.message);
 		}
 	}
-	// Search signal then encode value.
+	for(const auto& w: written)
+	{
+		if(std::find(committed.begin(), committed.end(), w.first->get_message()) != committed.end())
+			w.first->set_last_value((float)w.second);
+	}
+
+	return rc;
+}
+
+void write_batch(struct afb_req request)
+{
+	int rc = 0;
+	struct json_object* args = nullptr,
+		*json_signals = nullptr;
+
+	args = afb_req_json(request);
+
+	if (args != NULL &&
+		json_object_object_get_ex(args, "signals", &json_signals) && json_object_is_type(json_signals, json_type_array))
+	{
+		rc = write_signals(json_signals);
+	}
+	else
+	{
+		AFB_ERROR("Request argument malformed. Please use the following syntax: {\"signals\": [{\"signal_name\": string, \"signal_value\": number}, ...]}");
+		rc = -1;
+	}
+
+	if (rc >= 0)
+		afb_req_success(request, NULL, NULL);
+	else
+		afb_req_fail(request, "error", NULL);
+}
+
+/// @brief Get the writable CAN signals matching a name.
+///
+/// @return 0 if ok, -1 if there is none or one isn't writable.
+static int find_writable_signals(const std::string& name, std::vector<std::shared_ptr<can_signal_t> >& can_signals)
+{
+	openxc_DynamicField search_key = build_DynamicField(name);
+	struct utils::signals_found sf = utils::signals_manager_t::instance().find_signals(search_key);
+
+	if (sf.can_signals.empty())
+	{
+		AFB_WARNING("No signal(s) found for %s.", name.c_str());
+		return -1;
+	}
+	for(const auto& sig: sf.can_signals)
+	{
+		if(! sig->get_writable())
+		{
+			AFB_WARNING("%s isn't writable.", sig->get_name().c_str());
+			return -1;
+		}
+	}
+	can_signals = sf.can_signals;
+	return 0;
+}
+
+/// @brief Install, or update, a cyclic transmission done by the kernel for the
+/// request session. It is removed with stop_cyclic or when the session is closed.
+///
+/// Either a raw frame with "bus_name" and "frame", as for write, or a signal with
+/// "signal_name" and "signal_value" are expected, along with "interval" in
+/// milliseconds and an optional "count" of frames to send. Without interval an
+/// installed transmission only gets its frame updated, its timing goes on.
+void write_cyclic(struct afb_req request)
+{
+	int rc = 0;
+	struct json_object* args = nullptr,
+		*json_name = nullptr,
+		*json_value = nullptr,
+		*json_interval = nullptr,
+		*json_count = nullptr;
+
+	args = afb_req_json(request);
+
+	double interval_ms = 0;
+	uint32_t count = 0;
+	if(args != NULL && json_object_object_get_ex(args, "interval", &json_interval))
+		{interval_ms = json_object_get_double(json_interval);}
+	if(args != NULL && json_object_object_get_ex(args, "count", &json_count))
+		{count = (uint32_t)json_object_get_int(json_count);}
+
+	low_can_cyclic_t& cyclic = low_can_cyclic_t::from_session(request);
+
+	if (args != NULL &&
+		(json_object_object_get_ex(args, "bus_name", &json_name) && json_object_is_type(json_name, json_type_string) ) &&
+		(json_object_object_get_ex(args, "frame", &json_value) && json_object_is_type(json_value, json_type_object) ))
+	{
+		struct canfd_frame cf;
+		bool fd;
+		const std::string found_device = application_t::instance().get_can_bus_manager().get_can_device_name(json_object_get_string(json_name));
+		if(build_raw_frame(json_value, cf, fd) < 0 || found_device.empty())
+			rc = -1;
+		else
+			rc = cyclic.setup(found_device, cf, fd, interval_ms, count);
+	}
 	else if(args != NULL &&
 		(json_object_object_get_ex(args, "signal_name", &json_name) && json_object_is_type(json_name, json_type_string)) &&
 		(json_object_object_get_ex(args, "signal_value", &json_value) && (json_object_is_type(json_value, json_type_double) || json_object_is_type(json_value, json_type_int))))
 	{
-		rc = write_signal(json_object_get_string(json_name),
-			(uint64_t)json_object_get_double(json_value));
+		std::vector<std::shared_ptr<can_signal_t> > can_signals;
+		rc = find_writable_signals(json_object_get_string(json_name), can_signals);
+		for(const auto& sig: can_signals)
+		{
+			if(cyclic.setup(sig, (uint64_t)json_object_get_double(json_value), interval_ms, count) < 0)
+			{
+				rc = -1;
+				break;
+			}
+		}
 	}
 	else
 	{
-		AFB_ERROR("Request argument malformed. Please use the following syntax:");
+		AFB_ERROR("Request argument malformed. Please use the write syntax with \"interval\": ms and optional \"count\": int");
+		rc = -1;
+	}
+
+	if (rc >= 0)
+		afb_req_success(request, NULL, NULL);
+	else
+		afb_req_fail(request, "error", NULL);
+}
+
+/// @brief Stop a cyclic transmission of the request session, given by "bus_name"
+/// and "can_id" or by "signal_name" for the transmission of its message.
+void stop_cyclic(struct afb_req request)
+{
+	int rc = 0;
+	struct json_object* args = nullptr,
+		*json_name = nullptr,
+		*json_can_id = nullptr;
+
+	args = afb_req_json(request);
+	low_can_cyclic_t& cyclic = low_can_cyclic_t::from_session(request);
+
+	if (args != NULL &&
+		(json_object_object_get_ex(args, "bus_name", &json_name) && json_object_is_type(json_name, json_type_string) ) &&
+		(json_object_object_get_ex(args, "can_id", &json_can_id) && (json_object_is_type(json_can_id, json_type_double) || json_object_is_type(json_can_id, json_type_int))))
+	{
+		const std::string found_device = application_t::instance().get_can_bus_manager().get_can_device_name(json_object_get_string(json_name));
+		rc = found_device.empty() ? -1 : cyclic.remove(found_device, (canid_t)json_object_get_int(json_can_id));
+	}
+	else if(args != NULL &&
+		(json_object_object_get_ex(args, "signal_name", &json_name) && json_object_is_type(json_name, json_type_string)))
+	{
+		std::vector<std::shared_ptr<can_signal_t> > can_signals;
+		rc = find_writable_signals(json_object_get_string(json_name), can_signals);
+		for(const auto& sig: can_signals)
+		{
+			if(cyclic.remove(sig->get_message()->get_bus_device_name(), sig->get_message()->get_id()) < 0)
+				rc = -1;
+		}
+	}
+	else
+	{
+		AFB_ERROR("Request argument malformed. Please use {\"bus_name\": string, \"can_id\": int} or {\"signal_name\": string}");
 		rc = -1;
 	}
 
@@ -647,6 +1126,127 @@ void list(struct afb_req request)
 		afb_req_fail(request, "error", NULL);
 }
 
+///******************************************************************************
+///
+///		Statistics
+///
+///*******************************************************************************/
+
+static struct afb_event stats_event; ///< stats_event - event pushing statistics periodically, invalid if not configured.
+static uint64_t stats_period_us = 0; ///< stats_period_us - period of the statistics event.
+
+/// @brief Gather CAN bus manager statistics and the counters of each subscription.
+static struct json_object *jsonify_stats()
+{
+	json_object* ans = application_t::instance().get_can_bus_manager().jsonify_stats();
+	json_object* signals = json_object_new_array();
+
+	utils::signals_manager_t& sm = utils::signals_manager_t::instance();
+	{
+		std::lock_guard<std::mutex> subscribed_signals_lock(sm.get_subscribed_signals_mutex());
+		for(const auto& s: sm.get_subscribed_signals())
+		{
+			subscription_metrics_t& metrics = s.second->get_metrics();
+			json_object* jsig = json_object_new_object();
+			json_object_object_add(jsig, "event", json_object_new_string(s.second->get_name().c_str()));
+			json_object_object_add(jsig, "index", json_object_new_int(s.first));
+			json_object_object_add(jsig, "decoded", json_object_new_int64(metrics.decoded.get()));
+			json_object_object_add(jsig, "pushed", json_object_new_int64(metrics.pushed.get()));
+			json_object_object_add(jsig, "failures", json_object_new_int64(metrics.failures.get()));
+			json_object_array_add(signals, jsig);
+		}
+	}
+	json_object_object_add(ans, "signals", signals);
+	return ans;
+}
+
+/// @brief Timer callback pushing the statistics event, then re-arming the
+/// timer one period later.
+static int on_stats_timer(sd_event_source* s, uint64_t usec, void* userdata)
+{
+	if(afb_event_push(stats_event, jsonify_stats()) < 0)
+		{AFB_WARNING("Can't push statistics event");}
+
+	uint64_t now;
+	uint64_t next = usec + stats_period_us;
+	sd_event_now(afb_daemon_get_event_loop(), CLOCK_MONOTONIC, &now);
+	if(next < now)
+		{next = now + stats_period_us;}
+
+	sd_event_source_set_time(s, next);
+	sd_event_source_set_enabled(s, SD_EVENT_ON);
+	return 0;
+}
+
+/// @brief Create the statistics event and its timer, if a "stats-interval" in
+/// milliseconds is set in section CANbus-options of the configuration file.
+///
+/// @return 0 if ok or not configured, -1 if the event or the timer can't be created.
+static int start_stats_event(const std::string& interval)
+{
+	if(interval.empty())
+		return 0;
+
+	long interval_ms = std::strtol(interval.c_str(), nullptr, 10);
+	if(interval_ms <= 0)
+	{
+		AFB_ERROR("Invalid stats-interval %s", interval.c_str());
+		return -1;
+	}
+	stats_period_us = (uint64_t)interval_ms * 1000;
+
+	stats_event = afb_daemon_make_event("stats");
+	if(! afb_event_is_valid(stats_event))
+	{
+		AFB_ERROR("Can't create the statistics event");
+		return -1;
+	}
+
+	uint64_t now;
+	sd_event_source* timer;
+	sd_event* loop = afb_daemon_get_event_loop();
+	sd_event_now(loop, CLOCK_MONOTONIC, &now);
+	if(sd_event_add_time(loop, &timer, CLOCK_MONOTONIC, now + stats_period_us, 0, on_stats_timer, nullptr) < 0)
+	{
+		AFB_ERROR("Can't create the timer of the statistics event");
+		return -1;
+	}
+	sd_event_source_set_enabled(timer, SD_EVENT_ON);
+	return 0;
+}
+
+/// @brief Reply with the counters and latency histograms of the reading,
+/// decoding and pushing threads, and the counters of each subscription.
+///
+/// With {"event": true} or {"event": false}, the client is also subscribed
+/// or unsubscribed to the periodic "stats" event, if it is configured.
+void stats(struct afb_req request)
+{
+	int rc = 0;
+	struct json_object* args = nullptr,
+		*json_event = nullptr;
+
+	args = afb_req_json(request);
+	if (args != nullptr && json_object_object_get_ex(args, "event", &json_event))
+	{
+		if(! afb_event_is_valid(stats_event))
+		{
+			AFB_ERROR("Statistics event isn't configured, set stats-interval in section CANbus-options");
+			rc = -1;
+		}
+		else if((json_object_get_boolean(json_event) ? afb_req_subscribe : afb_req_unsubscribe)(request, stats_event) < 0)
+		{
+			AFB_ERROR("Operation goes wrong for statistics event");
+			rc = -1;
+		}
+	}
+
+	if (rc >= 0)
+		afb_req_success(request, jsonify_stats(), NULL);
+	else
+		afb_req_fail(request, "error", NULL);
+}
+
 /// @brief Initialize the binding.
 ///
 /// @param[in] service Structure which represent the Application Framework Binder.
@@ -658,8 +1258,23 @@ int initv2()
 	can_bus_t& can_bus_manager = application_t::instance().get_can_bus_manager();
 
 	can_bus_manager.set_can_devices();
+
+	// Replace generated signals before anything refers to them.
+	std::string signals_database = can_bus_manager.get_conf_file().get_option("signals-database");
+	if(! signals_database.empty())
+		application_t::instance().load_signals_database(signals_database);
+
+	utils::config_parser_t& conf_file = can_bus_manager.get_conf_file();
+	std::string trace_records = conf_file.get_option("trace-records");
+	if(utils::tracer_t::instance().configure(conf_file.get_option("trace"), conf_file.get_option("trace-file"),
+		trace_records.empty() ? TRACE_RECORDS_DEFAULT : std::strtoul(trace_records.c_str(), nullptr, 10)) < 0)
+		AFB_WARNING("Frame path isn't traced");
+
 	can_bus_manager.start_threads();
 
+	if(start_stats_event(can_bus_manager.get_conf_file().get_option("stats-interval")) < 0)
+		AFB_WARNING("Statistics are only available through verb stats");
+
 	/// Initialize Diagnostic manager that will handle obd2 requests.
 	/// We pass by default the first CAN bus device to its Initialization.
 	/// TODO: be able to choose the CAN bus device that will be use as Diagnostic bus.
@@ -680,9 +1295,11 @@ int initv2()
 		event_filter.frequency = sf.diagnostic_messages.front()->get_frequency();
 
 		utils::signals_manager_t& sm = utils::signals_manager_t::instance();
+		std::lock_guard<std::mutex> subscribed_signals_lock(sm.get_subscribed_signals_mutex());
 		std::map<int, std::shared_ptr<low_can_subscription_t> >& s = sm.get_subscribed_signals();
 
 		subscribe_unsubscribe_diagnostic_messages(request, true, sf.diagnostic_messages, event_filter, s, true);
+		sm.update_dispatch_table();
 	}
 
 	if(ret)
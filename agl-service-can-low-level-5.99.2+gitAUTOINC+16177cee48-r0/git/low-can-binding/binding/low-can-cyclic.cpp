@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "low-can-cyclic.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "../can/can-encoder.hpp"
+#include "../can/can-message-definition.hpp"
+
+void* low_can_cyclic_t::create_context()
+{
+	return new low_can_cyclic_t();
+}
+
+/// @brief Called by the application framework when the session is closed,
+/// closing the sockets deletes their jobs.
+void low_can_cyclic_t::free_context(void* context)
+{
+	delete (low_can_cyclic_t*)context;
+}
+
+/// @brief Get the cyclic transmissions of the request session, created at first use.
+low_can_cyclic_t& low_can_cyclic_t::from_session(struct afb_req request)
+{
+	return *(low_can_cyclic_t*)afb_req_context(request, create_context, free_context);
+}
+
+/// @brief Get the session BCM socket of a CAN bus device, opened at first use.
+///
+/// Must be called with mutex_ locked.
+///
+/// @return nullptr if the socket can't be opened.
+utils::socketcan_bcm_t* low_can_cyclic_t::get_socket(const std::string& device_name)
+{
+	std::unique_ptr<utils::socketcan_bcm_t>& socket = sockets_[device_name];
+	if(! socket)
+		{socket.reset(new utils::socketcan_bcm_t());}
+	if(! *socket && socket->open(device_name) < 0)
+		return nullptr;
+	return socket.get();
+}
+
+/// @brief Install a cyclic transmission or update an installed one.
+///
+/// An interval of 0 for an installed job only replaces the frame in place, its
+/// timer goes on. Otherwise the timer is restarted and the frame is sent at once:
+/// count frames at the given interval then the job stays idle, or indefinitely if
+/// count is 0.
+///
+/// Must be called with mutex_ locked.
+///
+/// @param[in] device_name - CAN bus device name.
+/// @param[in] cf - frame to send, its CAN ID identifies the job.
+/// @param[in] fd - true to send a CAN FD frame.
+/// @param[in] interval_ms - interval between frames, in milliseconds.
+/// @param[in] count - number of frames to send, 0 for no limit.
+///
+/// @return 0 if ok else -1
+int low_can_cyclic_t::install(const std::string& device_name, const struct canfd_frame& cf, bool fd, double interval_ms, uint32_t count)
+{
+	auto key = std::make_pair(device_name, cf.can_id);
+	auto it = jobs_.find(key);
+	bool installed = it != jobs_.end();
+
+	if(! installed && interval_ms <= 0)
+	{
+		AFB_ERROR("No cyclic transmission of CAN ID 0x%X on %s to update, an interval is needed", cf.can_id, device_name.c_str());
+		return -1;
+	}
+	if(installed && it->second.fd != fd)
+	{
+		AFB_ERROR("Cyclic transmission of CAN ID 0x%X on %s is already installed as a %s frame", cf.can_id, device_name.c_str(), it->second.fd ? "CAN FD" : "CAN");
+		return -1;
+	}
+	if(! installed && jobs_.size() >= CYCLIC_JOBS_MAX)
+	{
+		AFB_ERROR("Too many cyclic transmissions in the session, %d at most", CYCLIC_JOBS_MAX);
+		return -1;
+	}
+
+	utils::socketcan_bcm_t* socket = get_socket(device_name);
+	if(! socket)
+		return -1;
+
+	struct utils::simple_bcm_msg bcm_msg;
+	::memset(&bcm_msg, 0, sizeof(bcm_msg));
+	bcm_msg.msg_head.opcode = TX_SETUP;
+	bcm_msg.msg_head.can_id = cf.can_id;
+	bcm_msg.msg_head.nframes = 1;
+	bcm_msg.frames = cf;
+	if(fd)
+		{bcm_msg.msg_head.flags |= CAN_FD_FRAME;}
+
+	if(interval_ms > 0)
+	{
+		struct bcm_timeval interval;
+		interval.tv_sec = (long)(interval_ms / 1000);
+		interval.tv_usec = (long)std::fmod(interval_ms * 1000, 1000000);
+
+		bcm_msg.msg_head.flags |= SETTIMER|STARTTIMER|TX_ANNOUNCE;
+		if(count)
+		{
+			bcm_msg.msg_head.count = count;
+			bcm_msg.msg_head.ival1 = interval;
+		}
+		else
+			{bcm_msg.msg_head.ival2 = interval;}
+	}
+
+	if(socket->write(bcm_msg) < 0)
+	{
+		AFB_ERROR("TX_SETUP of CAN ID 0x%X on %s failed. %s", cf.can_id, device_name.c_str(), strerror(errno));
+		return -1;
+	}
+
+	jobs_[key] = cyclic_job_t{cf, fd};
+	return 0;
+}
+
+/// @brief Install or update the cyclic transmission of a raw frame, see install().
+///
+/// @return 0 if ok else -1
+int low_can_cyclic_t::setup(const std::string& device_name, const struct canfd_frame& cf, bool fd, double interval_ms, uint32_t count)
+{
+	std::lock_guard<std::mutex> jobs_lock(mutex_);
+	return install(device_name, cf, fd, interval_ms, count);
+}
+
+/// @brief Install or update the cyclic transmission of the message of a signal,
+/// see install(). The signal value is written over the frame already sent by the
+/// job if any, else over the last known payload of the message, so that signals
+/// of a message can be updated one by one.
+///
+/// @param[in] sig - writable signal.
+/// @param[in] value - value to write in the signal.
+///
+/// @return 0 if ok else -1
+int low_can_cyclic_t::setup(const std::shared_ptr<can_signal_t>& sig, uint64_t value, double interval_ms, uint32_t count)
+{
+	can_message_definition_t* message = sig->get_message();
+	const std::string device_name = message->get_bus_device_name();
+
+	std::lock_guard<std::mutex> jobs_lock(mutex_);
+	auto it = jobs_.find(std::make_pair(device_name, message->get_id()));
+	struct canfd_frame cf = it != jobs_.end() ? it->second.frame : encoder_t::build_frame(*message);
+	if(! encoder_t::encode_signal(sig, value, cf))
+	{
+		AFB_WARNING("Value %llu doesn't fit in %s. Message not sent.", (unsigned long long)value, sig->get_name().c_str());
+		return -1;
+	}
+
+	if(install(device_name, cf, message->is_fd(), interval_ms, count) < 0)
+		return -1;
+
+	sig->set_last_value((float)value);
+	message->set_last_value(cf.data, cf.len);
+	return 0;
+}
+
+/// @brief Stop and delete a cyclic transmission.
+///
+/// @return 0 if ok, -1 if there is no such job.
+int low_can_cyclic_t::remove(const std::string& device_name, canid_t can_id)
+{
+	std::lock_guard<std::mutex> jobs_lock(mutex_);
+	auto it = jobs_.find(std::make_pair(device_name, can_id));
+	if(it == jobs_.end())
+	{
+		AFB_WARNING("No cyclic transmission of CAN ID 0x%X on %s", can_id, device_name.c_str());
+		return -1;
+	}
+
+	struct utils::simple_bcm_msg bcm_msg;
+	::memset(&bcm_msg, 0, sizeof(bcm_msg));
+	bcm_msg.msg_head.opcode = TX_DELETE;
+	bcm_msg.msg_head.can_id = can_id;
+	if(it->second.fd)
+		{bcm_msg.msg_head.flags |= CAN_FD_FRAME;}
+
+	utils::socketcan_bcm_t* socket = get_socket(device_name);
+	if(! socket || socket->write(bcm_msg) < 0)
+	{
+		AFB_ERROR("TX_DELETE of CAN ID 0x%X on %s failed. %s", can_id, device_name.c_str(), strerror(errno));
+		return -1;
+	}
+
+	jobs_.erase(it);
+	return 0;
+}
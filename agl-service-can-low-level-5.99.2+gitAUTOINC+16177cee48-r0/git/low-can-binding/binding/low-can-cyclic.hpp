@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <utility>
+#include <linux/can.h>
+
+#include "low-can-hat.hpp"
+#include "../can/can-signals.hpp"
+#include "../utils/socketcan-bcm.hpp"
+
+/// @brief Maximum number of cyclic transmissions installed by a client session.
+#define CYCLIC_JOBS_MAX 64
+
+/// @brief A cyclic transmission, as installed in the kernel.
+struct cyclic_job_t
+{
+	struct canfd_frame frame; ///< frame - frame sent.
+	bool fd; ///< fd - true if sent as a CAN FD frame, the kernel tells jobs apart with it.
+};
+
+/// @brief Cyclic transmissions installed by a client session.
+///
+/// Each transmission is a BCM TX_SETUP job: the kernel sends the frame at the
+/// given interval, with no wake up of the binding. Jobs are installed on BCM
+/// sockets owned by the session, one by CAN bus device, so they are all
+/// removed by the kernel when the object is destroyed with the session.
+class low_can_cyclic_t
+{
+private:
+	std::mutex mutex_; ///< mutex_ - serializes requests of the session.
+	std::map<std::string, std::unique_ptr<utils::socketcan_bcm_t> > sockets_; ///< sockets_ - BCM sockets by CAN bus device name.
+	std::map<std::pair<std::string, canid_t>, cyclic_job_t> jobs_; ///< jobs_ - installed jobs, by CAN bus device name and CAN ID.
+
+	utils::socketcan_bcm_t* get_socket(const std::string& device_name);
+	int install(const std::string& device_name, const struct canfd_frame& cf, bool fd, double interval_ms, uint32_t count);
+
+	static void* create_context();
+	static void free_context(void* context);
+
+public:
+	static low_can_cyclic_t& from_session(struct afb_req request);
+
+	int setup(const std::string& device_name, const struct canfd_frame& cf, bool fd, double interval_ms, uint32_t count);
+	int setup(const std::shared_ptr<can_signal_t>& sig, uint64_t value, double interval_ms, uint32_t count);
+	int remove(const std::string& device_name, canid_t can_id);
+};
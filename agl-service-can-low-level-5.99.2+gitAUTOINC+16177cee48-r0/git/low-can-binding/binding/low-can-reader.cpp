@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "low-can-reader.hpp"
+
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <sys/time.h>
+
+#include "../can/can-bus.hpp"
+
+low_can_reader_t::low_can_reader_t(const std::string& device_name)
+	: device_name_{device_name},
+	socket_{},
+	event_source_{nullptr}
+{}
+
+low_can_reader_t::~low_can_reader_t()
+{
+	if(event_source_)
+		sd_event_source_unref(event_source_);
+	socket_.close();
+}
+
+const std::string& low_can_reader_t::get_device_name() const
+{
+	return device_name_;
+}
+
+utils::socketcan_bcm_t& low_can_reader_t::get_socket()
+{
+	return socket_;
+}
+
+struct sd_event_source* low_can_reader_t::get_event_source() const
+{
+	return event_source_;
+}
+
+void low_can_reader_t::set_event_source(struct sd_event_source* event_source)
+{
+	event_source_ = event_source;
+}
+
+/// @brief Open the BCM socket on the reader CAN device if not already done.
+///
+/// @return INVALID_SOCKET on failure, else positive integer
+int low_can_reader_t::open()
+{
+	if(! socket_)
+		return socket_.open(device_name_);
+	return socket_.socket();
+}
+
+/// @brief Merge all RX_SETUP jobs asked for a CAN ID and send the resulting
+/// job to the kernel. The merged job uses the union of the content filters
+/// and the shortest frequency thinning interval asked. If no more subscription
+/// needs that CAN ID then the job is deleted.
+///
+/// Must be called with rx_filters_mutex_ locked.
+///
+/// @return 0 if ok else -1
+int low_can_reader_t::update_rx_setup(uint32_t can_id)
+{
+	struct utils::simple_bcm_msg merged;
+	::memset(&merged, 0, sizeof(merged));
+
+	auto it = rx_filters_.find(can_id);
+	if(it == rx_filters_.end() || it->second.empty())
+	{
+		merged.msg_head.opcode = RX_DELETE;
+		merged.msg_head.can_id = can_id;
+		rx_filters_.erase(can_id);
+
+		if(socket_.write(merged) < 0)
+		{
+			AFB_ERROR("RX_DELETE of CAN ID 0x%X on %s failed. %s", can_id, device_name_.c_str(), strerror(errno));
+			return -1;
+		}
+		return 0;
+	}
+
+	bool filter_id_only = false;
+	bool first = true;
+	for(const auto& job: it->second)
+	{
+		const struct bcm_msg_head& head = job.second.msg_head;
+		if(first)
+		{
+			merged.msg_head = head;
+			first = false;
+		}
+		else
+		{
+			merged.msg_head.flags |= head.flags;
+			if(! timerisset(&head.ival2) ||
+			   (timerisset(&merged.msg_head.ival2) && timercmp(&head.ival2, &merged.msg_head.ival2, <)))
+				merged.msg_head.ival2 = head.ival2;
+		}
+
+		if(head.nframes == 0 || (head.flags & RX_FILTER_ID))
+			filter_id_only = true;
+		if(job.second.frames.len > merged.frames.len)
+			merged.frames.len = job.second.frames.len;
+		for(int i = 0; i < CANFD_MAX_DLEN; i++)
+			merged.frames.data[i] |= job.second.frames.data[i];
+	}
+
+	merged.msg_head.can_id = can_id;
+	if(filter_id_only)
+	{
+		merged.msg_head.flags |= RX_FILTER_ID;
+		merged.msg_head.nframes = 0;
+	}
+	else
+		merged.msg_head.nframes = 1;
+
+	if(socket_.write(merged) < 0)
+	{
+		AFB_ERROR("RX_SETUP of CAN ID 0x%X on %s failed. %s", can_id, device_name_.c_str(), strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/// @brief Record a RX_SETUP job asked by a subscription then update the kernel
+/// job for its CAN ID.
+///
+/// @param[in] sub_index - subscription index that will receive frames for that CAN ID.
+/// @param[in] bcm_msg - the RX_SETUP job the subscription would have used on its own socket.
+///
+/// @return 0 if ok else -1
+int low_can_reader_t::add_rx_filter(int sub_index, const struct utils::simple_bcm_msg& bcm_msg)
+{
+	if(open() < 0)
+		return -1;
+
+	std::lock_guard<std::mutex> rx_filters_lock(rx_filters_mutex_);
+	uint32_t can_id = bcm_msg.msg_head.can_id;
+	rx_filters_[can_id][sub_index] = bcm_msg;
+	if(update_rx_setup(can_id) < 0)
+	{
+		// The kernel keeps the previous job, forget the one it refused.
+		rx_filters_[can_id].erase(sub_index);
+		if(rx_filters_[can_id].empty())
+			rx_filters_.erase(can_id);
+		return -1;
+	}
+	return 0;
+}
+
+/// @brief Remove all jobs recorded for a subscription, updating or deleting
+/// the kernel jobs of the CAN IDs it used.
+///
+/// @param[in] sub_index - subscription index to remove.
+void low_can_reader_t::remove_rx_filters(int sub_index)
+{
+	std::lock_guard<std::mutex> rx_filters_lock(rx_filters_mutex_);
+	std::vector<uint32_t> can_ids;
+	for(auto& filter: rx_filters_)
+	{
+		if(filter.second.erase(sub_index))
+			can_ids.push_back(filter.first);
+	}
+
+	for(uint32_t can_id: can_ids)
+		update_rx_setup(can_id);
+}
+
+/// @brief Push the CAN message once. The BCM socket only delivers CAN IDs having
+/// an RX_SETUP job, so no check is done here: it is pushed without subscription
+/// index and the decoding thread finds all subscriptions to notify in its dispatch
+/// table, none for a frame read just before its job was deleted. Must be called from
+/// the event loop, the only CAN message queue producer. Decoding thread isn't woken
+/// up, it is up to the caller.
+///
+/// @param[in] cm - CAN message read from the reader socket, its subscription index is
+///  overwritten.
+/// @param[in] can_bus_manager - CAN bus manager holding the queue to fill.
+///
+/// @return number of CAN messages pushed.
+int low_can_reader_t::dispatch(can_message_t& cm, can_bus_t& can_bus_manager)
+{
+	cm.set_sub_id(-1);
+	return can_bus_manager.push_new_can_message(cm) ? 1 : 0;
+}
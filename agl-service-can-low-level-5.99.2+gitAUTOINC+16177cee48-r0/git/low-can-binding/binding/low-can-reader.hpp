@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <systemd/sd-event.h>
+
+#include "../utils/socketcan-bcm.hpp"
+
+class can_bus_t;
+
+/// @brief One BCM socket per CAN device shared by all subscriptions made on it.
+///
+/// Instead of opening a socket by subscription, every subscription registers its
+/// RX_SETUP job here. Jobs for a same arbitration ID are merged into one kernel
+/// job and incoming frames are queued once, the decoding thread dispatching them
+/// to the subscriptions of their arbitration ID.
+class low_can_reader_t
+{
+private:
+	std::string device_name_; ///< device_name_ - Linux CAN device name read by this reader.
+	utils::socketcan_bcm_t socket_; ///< socket_ - The BCM socket shared by all subscriptions on the device.
+	struct sd_event_source* event_source_; ///< event_source_ - systemd event source reading socket_, nullptr if not attached yet.
+
+	std::mutex rx_filters_mutex_; ///< rx_filters_mutex_ - protects rx_filters_ map.
+	std::map<uint32_t, std::map<int, struct utils::simple_bcm_msg> > rx_filters_; ///< rx_filters_ - RX_SETUP jobs asked, by CAN ID then by subscription index.
+
+	int update_rx_setup(uint32_t can_id);
+
+public:
+	explicit low_can_reader_t(const std::string& device_name);
+	low_can_reader_t(const low_can_reader_t&) = delete;
+	~low_can_reader_t();
+
+	const std::string& get_device_name() const;
+	utils::socketcan_bcm_t& get_socket();
+	struct sd_event_source* get_event_source() const;
+	void set_event_source(struct sd_event_source* event_source);
+
+	int open();
+
+	int add_rx_filter(int sub_index, const struct utils::simple_bcm_msg& bcm_msg);
+	void remove_rx_filters(int sub_index);
+
+	int dispatch(can_message_t& cm, can_bus_t& can_bus_manager);
+};
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "low-can-snapshot.hpp"
+
+#include <time.h>
+#include <mutex>
+
+#include "../utils/signals.hpp"
+
+low_can_snapshot_t::low_can_snapshot_t(const std::string& name, float frequency, const std::vector<std::shared_ptr<can_signal_t> >& can_signals)
+	: name_{name},
+	frequency_{frequency},
+	period_us_{(uint64_t)(1000000 / frequency)},
+	event_{nullptr, nullptr},
+	can_signals_{can_signals},
+	timer_{nullptr}
+{}
+
+low_can_snapshot_t::~low_can_snapshot_t()
+{
+	if(timer_)
+		{sd_event_source_unref(timer_);}
+	if(afb_event_is_valid(event_))
+		{afb_event_drop(event_);}
+}
+
+const std::string& low_can_snapshot_t::get_name() const
+{
+	return name_;
+}
+
+float low_can_snapshot_t::get_frequency() const
+{
+	return frequency_;
+}
+
+struct afb_event& low_can_snapshot_t::get_event()
+{
+	return event_;
+}
+
+const std::vector<std::shared_ptr<can_signal_t> >& low_can_snapshot_t::get_can_signals() const
+{
+	return can_signals_;
+}
+
+const std::vector<int>& low_can_snapshot_t::get_members() const
+{
+	return members_;
+}
+
+/// @brief Record a member subscription, to remove it with the snapshot.
+///
+/// @param[in] sub_index - index of the member in the subscribed signals map.
+void low_can_snapshot_t::add_member(int sub_index)
+{
+	members_.push_back(sub_index);
+}
+
+/// @brief Create the event and arm the timer pushing it on the binding event loop.
+///
+/// @return 0 if ok, -1 if the event or the timer can't be created.
+int low_can_snapshot_t::start()
+{
+	event_ = afb_daemon_make_event(name_.c_str());
+	if(! afb_event_is_valid(event_))
+	{
+		AFB_ERROR("Can't create an event for snapshot %s, something goes wrong.", name_.c_str());
+		return -1;
+	}
+
+	uint64_t now;
+	sd_event* loop = afb_daemon_get_event_loop();
+	sd_event_now(loop, CLOCK_MONOTONIC, &now);
+	// Default accuracy is 250ms, too coarse for tens of Hertz.
+	if(sd_event_add_time(loop, &timer_, CLOCK_MONOTONIC, now + period_us_, SNAPSHOT_TIMER_ACCURACY_US, on_timer, this) < 0)
+	{
+		AFB_ERROR("Can't create the timer of snapshot %s", name_.c_str());
+		timer_ = nullptr;
+		return -1;
+	}
+	sd_event_source_set_enabled(timer_, SD_EVENT_ON);
+	return 0;
+}
+
+/// @brief Build the event data: the last value of each signal of the group
+/// received at least once, with the time it has been received.
+json_object* low_can_snapshot_t::jsonify() const
+{
+	json_object* values = json_object_new_array();
+	for(const auto& sig: can_signals_)
+	{
+		if(! sig->get_received())
+			continue;
+
+		std::pair<float, uint64_t> last = sig->get_last_value_with_timestamp();
+		json_object* jobj = json_object_new_object();
+		json_object_object_add(jobj, "event", json_object_new_string(sig->get_name().c_str()));
+		json_object_object_add(jobj, "value", json_object_new_double(last.first));
+		json_object_object_add(jobj, "timestamp", json_object_new_int64(last.second));
+		json_object_array_add(values, jobj);
+	}
+
+	json_object* jo = json_object_new_object();
+	json_object_object_add(jo, "name", json_object_new_string(name_.c_str()));
+	json_object_object_add(jo, "values", values);
+	return jo;
+}
+
+/// @brief Timer callback pushing the snapshot event, then re-arming the timer
+/// one period after its previous expiration so the rate doesn't drift.
+///
+/// When the event doesn't have any client anymore, the snapshot and its member
+/// subscriptions are removed instead.
+int low_can_snapshot_t::on_timer(sd_event_source* s, uint64_t usec, void* userdata)
+{
+	low_can_snapshot_t* snapshot = (low_can_snapshot_t*)userdata;
+
+	if(afb_event_push(snapshot->event_, snapshot->jsonify()) == 0)
+	{
+		utils::signals_manager_t& sm = utils::signals_manager_t::instance();
+		std::lock_guard<std::mutex> subscribed_signals_lock(sm.get_subscribed_signals_mutex());
+		sm.remove_snapshot(snapshot);
+		// snapshot is deleted now.
+		return 0;
+	}
+
+	// After a stall of the event loop, restart from now instead of catching up.
+	uint64_t now;
+	uint64_t next = usec + snapshot->period_us_;
+	sd_event_now(afb_daemon_get_event_loop(), CLOCK_MONOTONIC, &now);
+	if(next < now)
+		{next = now + snapshot->period_us_;}
+
+	sd_event_source_set_time(s, next);
+	sd_event_source_set_enabled(s, SD_EVENT_ON);
+	return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <json-c/json.h>
+#include <systemd/sd-event.h>
+
+#include "low-can-hat.hpp"
+#include "../can/can-signals.hpp"
+
+#define SNAPSHOT_TIMER_ACCURACY_US 1000
+
+/// @brief A group of CAN signals pushed together, at a fixed rate, as one event.
+///
+/// Signals of the group are decoded by member subscriptions which don't have
+/// their own event: they only keep the signal last value up to date. A timer of
+/// the binding event loop then pushes the last value of every received signal
+/// of the group in a single event, whatever the number of CAN frames received
+/// meanwhile.
+class low_can_snapshot_t
+{
+private:
+	std::string name_; ///< name_ - signals pattern the snapshot has been subscribed with, also the event name.
+	float frequency_; ///< frequency_ - rate in Hertz of the pushed events.
+	uint64_t period_us_; ///< period_us_ - period of the pushed events in microseconds.
+	struct afb_event event_; ///< event_ - application framework event pushed to clients.
+	std::vector<std::shared_ptr<can_signal_t> > can_signals_; ///< can_signals_ - signals of the group.
+	std::vector<int> members_; ///< members_ - indexes of member subscriptions in the subscribed signals map.
+	struct sd_event_source* timer_; ///< timer_ - event loop timer pushing the event, nullptr if not started.
+
+	static int on_timer(sd_event_source* s, uint64_t usec, void* userdata);
+
+public:
+	low_can_snapshot_t(const std::string& name, float frequency, const std::vector<std::shared_ptr<can_signal_t> >& can_signals);
+	low_can_snapshot_t(const low_can_snapshot_t&) = delete;
+	~low_can_snapshot_t();
+
+	const std::string& get_name() const;
+	float get_frequency() const;
+	struct afb_event& get_event();
+	const std::vector<std::shared_ptr<can_signal_t> >& get_can_signals() const;
+	const std::vector<int>& get_members() const;
+
+	void add_member(int sub_index);
+
+	int start();
+	json_object* jsonify() const;
+};
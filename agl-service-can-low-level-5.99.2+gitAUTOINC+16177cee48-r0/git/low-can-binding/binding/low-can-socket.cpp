@@ -19,21 +19,28 @@
 #include "low-can-subscription.hpp"
 #include "application.hpp"
 #include "canutil/write.h"
+#include "bitfield/bitfield.h"
+
+std::atomic<int> low_can_socket_t::next_reader_index_{1};
 
 low_can_socket_t::low_can_socket_t()
 	: index_{-1},
 	event_filter_{},
-	socket_{}
+	socket_{},
+	reader_{nullptr}
 {}
 
 low_can_socket_t::low_can_socket_t(struct event_filter_t event_filter)
-	: event_filter_{event_filter}
+	: index_{-1},
+	event_filter_{event_filter},
+	reader_{nullptr}
  {}
 
 low_can_socket_t::low_can_socket_t( low_can_socket_t&& s)
 	: index_{s.index_},
 	event_filter_{s.event_filter_},
-	socket_{std::move(s.socket_)}
+	socket_{std::move(s.socket_)},
+	reader_{std::move(s.reader_)}
 {}
 
 low_can_socket_t& low_can_socket_t::operator=(const low_can_socket_t& s)
@@ -44,6 +51,8 @@ low_can_socket_t& low_can_socket_t::operator=(const low_can_socket_t& s)
 
 low_can_socket_t::~low_can_socket_t()
 {
+	if(reader_)
+		reader_->remove_rx_filters(index_);
 	socket_.close();
 }
 
@@ -144,11 +153,33 @@ float low_can_socket_t::get_max() const
 	return event_filter_.max;
 }
 
+event_format_t low_can_socket_t::get_format() const
+{
+	return event_filter_.format;
+}
+
+unsigned int low_can_socket_t::get_batch() const
+{
+	return event_filter_.batch;
+}
+
+float low_can_socket_t::get_snapshot() const
+{
+	return event_filter_.snapshot;
+}
+
 utils::socketcan_bcm_t& low_can_socket_t::get_socket()
 {
 	return socket_;
 }
 
+/// @brief Return the per bus reader used by this subscription or nullptr if it
+/// uses its own socket.
+std::shared_ptr<low_can_reader_t> low_can_socket_t::get_reader() const
+{
+	return reader_;
+}
+
 void low_can_socket_t::set_frequency(float freq)
 {
 	event_filter_.frequency = freq;
@@ -163,6 +194,17 @@ void low_can_socket_t::set_max(float max)
 {
 	event_filter_.max = max;
 }
+/// @brief Return the CAN bus device name to use depending on which object is
+/// subscribed, a CAN signal or a diagnostic message. Else the provided bus name.
+const std::string low_can_socket_t::get_bus_device_name(const std::string& bus_name) const
+{
+	if( can_signal_ != nullptr)
+		{return can_signal_->get_message()->get_bus_device_name();}
+	else if (! diagnostic_message_ .empty())
+		{return application_t::instance().get_diagnostic_manager().get_bus_device_name();}
+	return bus_name;
+}
+
 /// @brief Based upon which object is a subscribed CAN signal or diagnostic message
 /// it will open the socket with the required CAN bus device name.
 ///
@@ -172,12 +214,9 @@ int low_can_socket_t::open_socket(const std::string& bus_name)
 	int ret = 0;
 	if(! socket_)
 	{
-		if( can_signal_ != nullptr)
-			{ret = socket_.open(can_signal_->get_message()->get_bus_device_name());}
-		else if (! diagnostic_message_ .empty())
-			{ret = socket_.open(application_t::instance().get_diagnostic_manager().get_bus_device_name());}
-		else if ( ! bus_name.empty())
-			{ ret = socket_.open(bus_name);}
+		const std::string device_name = get_bus_device_name(bus_name);
+		if( ! device_name.empty())
+			{ ret = socket_.open(device_name);}
 		index_ = (int)socket_.socket();
 	}
 	return ret;
@@ -203,12 +242,13 @@ struct utils::simple_bcm_msg low_can_socket_t::make_bcm_head(uint32_t opcode, ui
 	return bcm_msg;
 }
 
-/// @brief Take an existing simple_bcm_msg struct and add a can_frame.
-/// Currently only 1 uniq can_frame can be added, it's not possible to build
-/// a multiplexed message with several can_frame.
-void low_can_socket_t::add_bcm_frame(const struct can_frame& cf, struct utils::simple_bcm_msg& bcm_msg) const
+/// @brief Take an existing simple_bcm_msg struct and add a frame.
+/// Currently only 1 uniq frame can be added, it's not possible to build
+/// a multiplexed message with several frames. It is sent as a CAN FD frame
+/// if the head has the CAN_FD_FRAME flag.
+void low_can_socket_t::add_bcm_frame(const struct canfd_frame& cf, struct utils::simple_bcm_msg& bcm_msg) const
 {
-	for(int i=0; i < CAN_MAX_DLEN; i++)
+	for(int i=0; i < CANFD_MAX_DLEN; i++)
 	{
 		if(cf.data[i] != 0)
 		{
@@ -226,24 +266,28 @@ void low_can_socket_t::add_bcm_frame(const struct can_frame& cf, struct utils::s
 int low_can_socket_t::create_rx_filter(std::shared_ptr<can_signal_t> sig)
 {
 	can_signal_= sig;
+	can_message_definition_t* message = can_signal_->get_message();
 
-	struct can_frame cfd;
+	struct canfd_frame cfd;
 	memset(&cfd, 0, sizeof(cfd));
+	cfd.len = message->get_length();
 
 	float val = (float)(1 << can_signal_->get_bit_size()) - 1;
-	bitfield_encode_float(val,
+	set_bitfield(float_to_fixed_point(val, can_signal_->get_factor(), can_signal_->get_offset()),
 							can_signal_->get_bit_position(),
 							can_signal_->get_bit_size(),
-							can_signal_->get_factor(),
-							can_signal_->get_offset(),
 							cfd.data,
-							CAN_MAX_DLEN);
+							cfd.len);
 
 	struct timeval freq, timeout = {0, 0};
 	frequency_clock_t f = event_filter_.frequency == 0 ? can_signal_->get_frequency() : frequency_clock_t(event_filter_.frequency);
 	freq = f.get_timeval_from_period();
 
-	utils::simple_bcm_msg bcm_msg = make_bcm_head(RX_SETUP, can_signal_->get_message()->get_id(), SETTIMER|RX_NO_AUTOTIMER, timeout, freq);
+	uint32_t flags = SETTIMER|RX_NO_AUTOTIMER;
+	if(message->is_fd())
+		flags |= CAN_FD_FRAME;
+
+	utils::simple_bcm_msg bcm_msg = make_bcm_head(RX_SETUP, message->get_id(), flags, timeout, freq);
 	add_bcm_frame(cfd, bcm_msg);
 
 	return create_rx_filter(bcm_msg);
@@ -275,6 +319,9 @@ int low_can_socket_t::create_rx_filter(std::shared_ptr<diagnostic_message_t> sig
 /// @return 0 if ok else -1
 int low_can_socket_t::create_rx_filter(utils::simple_bcm_msg& bcm_msg)
 {
+	if(application_t::instance().get_can_bus_manager().get_bus_reader())
+		return create_reader_rx_filter(bcm_msg);
+
 	// Make sure that socket is opened.
 	if(open_socket() < 0)
 		{return -1;}
@@ -302,23 +349,54 @@ int low_can_socket_t::create_rx_filter(utils::simple_bcm_msg& bcm_msg)
 	return 0;
 }
 
+/// @brief Same as create_rx_filter but the RX_SETUP job is registered on the
+/// reader of the CAN bus device, shared with all other subscriptions on that
+/// bus, instead of a socket owned by the subscription. The subscription index
+/// is then allocated here as there isn't a socket to take it from.
+///
+/// @return 0 if ok else -1
+int low_can_socket_t::create_reader_rx_filter(utils::simple_bcm_msg& bcm_msg)
+{
+	if(! reader_)
+	{
+		reader_ = application_t::instance().get_can_bus_manager().get_reader(get_bus_device_name());
+		if(! reader_)
+			return -1;
+		index_ = next_reader_index_++;
+	}
+
+	if(bcm_msg.msg_head.can_id != OBD2_FUNCTIONAL_BROADCAST_ID)
+		return reader_->add_rx_filter(index_, bcm_msg);
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		bcm_msg.msg_head.can_id  =  OBD2_FUNCTIONAL_RESPONSE_START + i;
+		if(reader_->add_rx_filter(index_, bcm_msg) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
 /// @brief Creates a TX_SEND job that is used by the BCM socket to
-/// send a message
+/// send a message, as a CAN FD frame if the signal message is one.
 ///
 /// @return 0 if ok, else -1
-int low_can_socket_t::tx_send(const struct can_frame& cf, std::shared_ptr<can_signal_t> sig)
+int low_can_socket_t::tx_send(const struct canfd_frame& cf, std::shared_ptr<can_signal_t> sig)
 {
 	can_signal_ = sig;
 
-	utils::simple_bcm_msg bcm_msg =  make_bcm_head(TX_SEND);
+	utils::simple_bcm_msg bcm_msg =  make_bcm_head(TX_SEND, 0, sig->get_message()->is_fd() ? CAN_FD_FRAME : 0);
 	add_bcm_frame(cf, bcm_msg);
 
 	if(open_socket() < 0)
 		{return -1;}
 
-	socket_ << bcm_msg;
-	if(! socket_)
+	if(socket_.write(bcm_msg) < 0)
+	{
+		AFB_ERROR("Error sending : %i %s", errno, ::strerror(errno));
 		return -1;
+	}
 
 	return 0;
 }
@@ -326,20 +404,45 @@ int low_can_socket_t::tx_send(const struct can_frame& cf, std::shared_ptr<can_si
 /// @brief Creates a TX_SEND job that is used by the BCM socket to
 /// send a message
 ///
+/// @param[in] cf - frame to send, its length and flags are used as is for a CAN FD frame.
+/// @param[in] bus_name - CAN bus device name.
+/// @param[in] fd - true to send a CAN FD frame, else only its 8 first bytes are sent.
+///
 /// @return 0 if ok else -1
-int low_can_socket_t::tx_send(const struct can_frame& cf, const std::string& bus_name)
+int low_can_socket_t::tx_send(const struct canfd_frame& cf, const std::string& bus_name, bool fd)
 {
 	can_signal_ = nullptr;
 
-	utils::simple_bcm_msg bcm_msg =  make_bcm_head(TX_SEND);
+	utils::simple_bcm_msg bcm_msg =  make_bcm_head(TX_SEND, 0, fd ? CAN_FD_FRAME : 0);
 	add_bcm_frame(cf, bcm_msg);
 
 	if(open_socket(bus_name) < 0)
 		{return -1;}
 
-	socket_ << bcm_msg;
-	if(! socket_)
+	if(socket_.write(bcm_msg) < 0)
+	{
+		AFB_ERROR("Error sending : %i %s", errno, ::strerror(errno));
 		return -1;
+	}
 
 	return 0;
 }
+
+/// @brief Send several TX_SEND jobs, built with make_bcm_head and add_bcm_frame,
+/// at once on the BCM socket. Sending stops at the first job refused.
+///
+/// @return number of jobs sent, the first ones of bcm_msgs, or -1 if the
+/// socket can't be opened.
+ssize_t low_can_socket_t::tx_send(const std::vector<struct utils::simple_bcm_msg>& bcm_msgs, const std::string& bus_name)
+{
+	can_signal_ = nullptr;
+
+	if(open_socket(bus_name) < 0)
+		{return -1;}
+
+	ssize_t sent = socket_.write(bcm_msgs);
+	if((size_t)sent < bcm_msgs.size())
+		AFB_ERROR("Error sending %d frames on %s, %d sent : %i %s", (int)bcm_msgs.size(), bus_name.c_str(), (int)sent, errno, ::strerror(errno));
+
+	return sent;
+}
@@ -19,22 +19,38 @@
 
 #include <string>
 #include <cmath>
+#include <atomic>
+#include <memory>
 #include <utility>
 
+#include "low-can-reader.hpp"
 #include "../can/can-signals.hpp"
 #include "../diagnostic/diagnostic-message.hpp"
 #include "../utils/socketcan-bcm.hpp"
 
+/// @brief Maximum number of values pushed at once to a binary event.
+#define EVENT_BATCH_MAX 256
+
+/// @brief How decoded values are delivered to a subscribed event.
+enum class event_format_t {
+	JSON, ///< JSON - one JSON object per value, built by jsonify_vehicle.
+	BINARY ///< BINARY - length delimited openxc VehicleMessage protobuf frames, base64 encoded in a JSON string.
+};
+
 /// @brief Filtering values. Theses values have to be tested in
-/// can_bus_t::apply_filter method.
+/// can_bus_t::apply_filter method. Format and batch size are delivery options
+/// of the subscribed event, set at subscription like the filter.
 struct event_filter_t
 {
 	float frequency; ///< frequency - Maximum frequency which will be received and pushed to a subscribed event.
 	float min; ///< min - Minimum value that the signal doesn't have to go below to be pushed.
 	float max; ///< max - Maximum value that the signal doesn't have to go above to be pushed.
-	event_filter_t() : frequency{0}, min{-__FLT_MAX__}, max{__FLT_MAX__} {};
+	event_format_t format; ///< format - Format of the pushed events.
+	unsigned int batch; ///< batch - Maximum number of values pushed at once, binary format only.
+	float snapshot; ///< snapshot - Rate in Hertz of the grouped event of a snapshot subscription, 0 if the subscription has its own event.
+	event_filter_t() : frequency{0}, min{-__FLT_MAX__}, max{__FLT_MAX__}, format{event_format_t::JSON}, batch{1}, snapshot{0} {};
 	bool operator==(const event_filter_t& ext) const {
-		return frequency == ext.frequency && min == ext.min && max == ext.max;
+		return frequency == ext.frequency && min == ext.min && max == ext.max && format == ext.format && batch == ext.batch && snapshot == ext.snapshot;
 	}
 };
 
@@ -52,6 +68,12 @@ protected:
 				/// normal diagnostic request and response are not tested for now.
 
 	utils::socketcan_bcm_t socket_; ///< socket_ - socket_ that receives CAN messages.
+	std::shared_ptr<low_can_reader_t> reader_; ///< reader_ - per bus reader used instead of socket_ when the binding runs in bus reader mode.
+
+	static std::atomic<int> next_reader_index_; ///< next_reader_index_ - index given to subscriptions which don't own a socket.
+
+	const std::string get_bus_device_name(const std::string& bus_name = "") const;
+	int create_reader_rx_filter(utils::simple_bcm_msg& bcm_msg);
 
 public:
 	low_can_socket_t();
@@ -74,7 +96,11 @@ public:
 	float get_frequency() const;
 	float get_min() const;
 	float get_max() const;
+	event_format_t get_format() const;
+	unsigned int get_batch() const;
+	float get_snapshot() const;
 	utils::socketcan_bcm_t& get_socket();
+	std::shared_ptr<low_can_reader_t> get_reader() const;
 
 	void set_event(struct afb_event event);
 	void set_frequency(float freq);
@@ -82,7 +108,7 @@ public:
 	void set_max(float max);
 
 	struct utils::simple_bcm_msg make_bcm_head(uint32_t opcode, uint32_t can_id = 0, uint32_t flags = 0, const struct timeval& timeout = {0,0}, const struct timeval& frequency_thinning = {0,0}) const;
-	void add_bcm_frame(const struct can_frame& cfd, struct utils::simple_bcm_msg& bcm_msg) const;
+	void add_bcm_frame(const struct canfd_frame& cfd, struct utils::simple_bcm_msg& bcm_msg) const;
 
 	int open_socket(const std::string& bus_name = "");
 
@@ -90,6 +116,7 @@ public:
 	int create_rx_filter(std::shared_ptr<diagnostic_message_t> sig);
 	int create_rx_filter(utils::simple_bcm_msg& bcm_msg);
 
-	int tx_send(const struct can_frame& cf, std::shared_ptr<can_signal_t> sig);
-	int tx_send(const struct can_frame& cf, const std::string& bus_name);
+	int tx_send(const struct canfd_frame& cf, std::shared_ptr<can_signal_t> sig);
+	int tx_send(const struct canfd_frame& cf, const std::string& bus_name, bool fd = false);
+	ssize_t tx_send(const std::vector<struct utils::simple_bcm_msg>& bcm_msgs, const std::string& bus_name);
 };
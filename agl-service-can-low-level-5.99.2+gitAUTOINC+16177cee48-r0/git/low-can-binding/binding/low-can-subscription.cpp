@@ -20,6 +20,13 @@
 #include "application.hpp"
 #include "canutil/write.h"
 
+low_can_subscription_t::low_can_subscription_t(low_can_subscription_t&& s)
+	: low_can_socket_t(std::move(s)),
+	event_{s.event_},
+	metrics_(s.metrics_),
+	last_emit_{s.last_emit_.load(std::memory_order_relaxed)}
+{}
+
 struct afb_event& low_can_subscription_t::get_event()
 {
 	return event_;
@@ -29,3 +36,33 @@ void low_can_subscription_t::set_event(struct afb_event event)
 {
 	event_ = event;
 }
+
+subscription_metrics_t& low_can_subscription_t::get_metrics()
+{
+	return metrics_;
+}
+
+/// @brief Thin the values of the subscription to its frequency. A bus reader
+/// merges the kernel filters of all subscriptions on a CAN ID and keeps the
+/// fastest rate, so values read that way have to be thinned again for each
+/// subscription.
+///
+/// @param[in] timestamp - reception time of the value, in microseconds.
+///
+/// @return True if the value is at least one period after the last accepted one.
+bool low_can_subscription_t::check_rate(uint64_t timestamp)
+{
+	if(! can_signal_)
+		{return true;}
+
+	frequency_clock_t f = event_filter_.frequency == 0 ? can_signal_->get_frequency() : frequency_clock_t(event_filter_.frequency);
+	struct timeval freq = f.get_timeval_from_period();
+	uint64_t period = (uint64_t)freq.tv_sec * 1000000 + freq.tv_usec;
+	if(period == 0)
+		{return true;}
+
+	uint64_t last = last_emit_.load(std::memory_order_relaxed);
+	if(last != 0 && timestamp < last + period)
+		{return false;}
+	return last_emit_.compare_exchange_strong(last, timestamp, std::memory_order_relaxed);
+}
@@ -18,6 +18,7 @@
   #pragma once
 
 #include <string>
+#include <atomic>
 #include <cmath>
 #include <utility>
 
@@ -25,6 +26,15 @@
 #include "../can/can-signals.hpp"
 #include "../diagnostic/diagnostic-message.hpp"
 #include "../utils/socketcan-bcm.hpp"
+#include "../utils/metrics.hpp"
+
+/// @brief Counters of the values of a subscription.
+struct subscription_metrics_t
+{
+	utils::shared_counter_t decoded; ///< decoded - values queued to be pushed, written by decoding threads, several ones when CAN messages come from a bus reader.
+	utils::counter_t pushed; ///< pushed - values pushed to clients, written by the pushing thread.
+	utils::counter_t failures; ///< failures - events pushed without any client or with an error, written by the pushing thread.
+};
 
 /// @brief The subscription class has a context that can handle all needed values to describe a subscription
 /// to the low-can binding. It can hold a CAN signal or a diagnostic message. A diagnostic message for OBD2 is
@@ -34,10 +44,15 @@ class low_can_subscription_t : public low_can_socket_t
 {
 private:
 	struct afb_event event_; ///< event_ - application framework event used to push on client
+	subscription_metrics_t metrics_; ///< metrics_ - counters of the subscription values.
+	std::atomic<uint64_t> last_emit_{0}; ///< last_emit_ - timestamp in microseconds of the last value accepted by check_rate, 0 if none.
 
 public:
 	using low_can_socket_t::low_can_socket_t;
+	low_can_subscription_t(low_can_subscription_t&& s);
 
 	struct afb_event& get_event();
 	void set_event(struct afb_event event);
+	subscription_metrics_t& get_metrics();
+	bool check_rate(uint64_t timestamp);
 };
@@ -21,9 +21,14 @@
 #include <linux/can/raw.h>
 #include <map>
 #include <cerrno>
+#include <cstdlib>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <cstring>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
 
 #include "can-bus.hpp"
 
@@ -32,6 +37,28 @@
 #include "../binding/application.hpp"
 #include "../utils/signals.hpp"
 #include "../utils/openxc-utils.hpp"
+#include "../utils/trace.hpp"
+
+/// @brief Allocate a decoder with the alignment of its rings.
+///
+/// @param[in] size - size of the decoder.
+///
+/// @return Returns the allocated memory, throws std::bad_alloc on failure.
+void* decoder_worker_t::operator new(size_t size)
+{
+	void* ptr = nullptr;
+	if(::posix_memalign(&ptr, alignof(decoder_worker_t), size) != 0)
+		{throw std::bad_alloc();}
+	return ptr;
+}
+
+/// @brief Free a decoder allocated by operator new.
+///
+/// @param[in] ptr - memory to free.
+void decoder_worker_t::operator delete(void* ptr)
+{
+	::free(ptr);
+}
 
 /// @brief Class destructor
 ///
@@ -40,7 +67,6 @@
 can_bus_t::~can_bus_t()
 {
 	stop_threads();
-	new_can_message_cv_.notify_one();
 }
 
 /// @brief Class constructor
@@ -48,7 +74,16 @@ can_bus_t::~can_bus_t()
 /// @param[in] conf_file - handle to the json configuration file.
 can_bus_t::can_bus_t(utils::config_parser_t conf_file)
 	: conf_file_{conf_file}
-{}
+{
+	decoders_.emplace_back(new decoder_worker_t());
+}
+
+/// @brief Return the configuration file handle, to read options which
+/// aren't about CAN devices.
+utils::config_parser_t& can_bus_t::get_conf_file()
+{
+	return conf_file_;
+}
 
 /// @brief Take a decoded message to determine if its value complies with the desired
 /// filters.
@@ -56,9 +91,11 @@ can_bus_t::can_bus_t(utils::config_parser_t conf_file)
 /// @param[in] vehicle_message - The decoded message to be analyzed.
 /// @param[in] can_subscription - the subscription which will be notified depending
 ///  on its filtering values. Filtering values are stored in the event_filtermember.
+/// @param[in] shared_filter - the message was read by a bus reader, whose kernel
+///  filter may be faster than the subscription frequency.
 ///
 /// @return True if the value is compliant with event filter values, false if not...
-bool can_bus_t::apply_filter(const openxc_VehicleMessage& vehicle_message, std::shared_ptr<low_can_subscription_t> can_subscription)
+bool can_bus_t::apply_filter(const openxc_VehicleMessage& vehicle_message, std::shared_ptr<low_can_subscription_t> can_subscription, bool shared_filter)
 {
 	bool send = false;
 	if(is_valid(vehicle_message))
@@ -68,6 +105,8 @@ bool can_bus_t::apply_filter(const openxc_VehicleMessage& vehicle_message, std::
 		double value = get_numerical_from_DynamicField(vehicle_message);
 		send = (value < min || value > max) ? false : true;
 	}
+	if(send && shared_filter)
+		{send = can_subscription->check_rate(vehicle_message.timestamp);}
 	return send;
 }
 
@@ -78,30 +117,62 @@ bool can_bus_t::apply_filter(const openxc_VehicleMessage& vehicle_message, std::
 /// It will add to the vehicle_message queue the decoded message and tell the event push
 /// thread to process it.
 ///
-/// @param[in] can_message - a single CAN message from the CAN socket read, to be decode.
+/// Subscriptions which are members of a snapshot don't have their own event, the
+/// signal is decoded to update its last value but nothing is pushed.
+///
+/// A CAN message read on the socket of a subscription is only processed for it,
+/// one read by a bus reader, without subscription index, is processed for all
+/// subscriptions on its bus and arbitration ID.
 ///
-/// @return How many signals has been decoded.
-void can_bus_t::process_can_signals(const can_message_t& can_message, std::map<int, std::shared_ptr<low_can_subscription_t> >& s)
+/// @param[in] worker - the decoder processing the message, decoded values go in its ring.
+/// @param[in] can_message - a single CAN message from the CAN socket read, to be decode.
+/// @param[in] table - subscriptions indexed by bus and arbitration ID.
+void can_bus_t::process_can_signals(decoder_worker_t& worker, const can_message_t& can_message, const utils::dispatch_table_t& table)
 {
 	int subscription_id = can_message.get_sub_id();
 	openxc_DynamicField decoded_message;
 	openxc_VehicleMessage vehicle_message;
 
 	// First we have to found which can_signal_t it is
-	std::shared_ptr<low_can_subscription_t> sig = s[subscription_id];
+	const std::vector<utils::dispatch_entry_t>* entries = table.find(can_message.get_ifindex(), can_message.get_id());
+	if(entries == nullptr)
+		return;
+
+	// All signals of the message are extracted at once, on first subscription to process.
+	float values[DECODE_PLAN_MAX_SIGNALS];
+	bool decoded = false;
 
-	if( s.find(subscription_id) != s.end() && afb_event_is_valid(s[subscription_id]->get_event()))
+	for(const auto& entry: *entries)
 	{
+		const std::shared_ptr<low_can_subscription_t>& sig = entry.subscription;
+		bool snapshot_member = sig->get_snapshot() > 0;
+		if((subscription_id >= 0 && sig->get_index() != subscription_id) || (! snapshot_member && ! afb_event_is_valid(sig->get_event())))
+			continue;
+
 		bool send = true;
-		decoded_message = decoder_t::translate_signal(*sig->get_can_signal(), can_message, &send);
+		if(entry.plan_index >= 0)
+		{
+			if(! decoded)
+			{
+				entry.can_signal->get_message()->get_decode_plan().decode(can_message, values);
+				decoded = true;
+			}
+			decoded_message = decoder_t::translate_signal(*entry.can_signal, can_message, values[entry.plan_index], &send);
+		}
+		else
+			{decoded_message = decoder_t::translate_signal(*entry.can_signal, can_message, &send);}
+
+		// Snapshot members only keep the signal last value up to date, their snapshot pushes it.
+		if(snapshot_member)
+			continue;
+
 		openxc_SimpleMessage s_message = build_SimpleMessage(sig->get_name(), decoded_message);
 		vehicle_message = build_VehicleMessage(s_message, can_message.get_timestamp());
 
-		if(send && apply_filter(vehicle_message, sig))
+		if(send && apply_filter(vehicle_message, sig, subscription_id < 0))
 		{
-			std::lock_guard<std::mutex> decoded_can_message_lock(decoded_can_message_mutex_);
-			push_new_vehicle_message(subscription_id, vehicle_message);
-			AFB_DEBUG("%s CAN signals processed.",  sig->get_name().c_str());
+			push_new_vehicle_message(worker, sig->get_index(), vehicle_message);
+			sig->get_metrics().decoded.add();
 		}
 	}
 }
@@ -110,25 +181,58 @@ void can_bus_t::process_can_signals(const can_message_t& can_message, std::map<i
 /// corresponding and will add the vehicle_message to the queue of event to pushed before notifying
 /// the event push thread to process it.
 ///
+/// @param[in] worker - the decoder processing the message, always the first one.
 /// @param[in] manager - the diagnostic manager object that handle diagnostic communication
 /// @param[in] can_message - a single CAN message from the CAN socket read, to be decode.
-///
-/// @return How many signals has been decoded.
-void can_bus_t::process_diagnostic_signals(diagnostic_manager_t& manager, const can_message_t& can_message, std::map<int, std::shared_ptr<low_can_subscription_t> >& s)
+/// @param[in] table - subscriptions index holding the diagnostic subscription.
+void can_bus_t::process_diagnostic_signals(decoder_worker_t& worker, diagnostic_manager_t& manager, const can_message_t& can_message, const utils::dispatch_table_t& table)
 {
 	int subscription_id = can_message.get_sub_id();
+	std::shared_ptr<low_can_subscription_t> sub = table.get_diagnostic_subscription();
+
+	// Same CAN message read by another subscription socket, diagnostic subscription has its own copy.
+	if(sub && subscription_id >= 0 && sub->get_index() != subscription_id)
+		return;
 
 	openxc_VehicleMessage vehicle_message = manager.find_and_decode_adr(can_message);
-	if (can_message.get_timestamp())
-		{vehicle_message.timestamp = can_message.get_timestamp();}
+	push_diagnostic_message(worker, vehicle_message, can_message.get_timestamp(), table);
+}
+
+/// @brief Decode the diagnostic responses reassembled by kernel ISO-TP sockets,
+/// handed by the event loop to the first decoder.
+///
+/// @param[in] worker - the first decoder.
+/// @param[in] manager - the diagnostic manager object that handle diagnostic communication
+/// @param[in] table - subscriptions index holding the diagnostic subscription.
+void can_bus_t::process_diagnostic_pdus(decoder_worker_t& worker, diagnostic_manager_t& manager, const utils::dispatch_table_t& table)
+{
+	diagnostic_pdu_t pdu;
+	while(manager.next_pdu(pdu))
+	{
+		openxc_VehicleMessage vehicle_message = manager.decode_pdu(pdu);
+		push_diagnostic_message(worker, vehicle_message, pdu.timestamp, table);
+	}
+}
+
+/// @brief Queue a decoded diagnostic response to the diagnostic subscription.
+///
+/// @param[in] worker - the first decoder.
+/// @param[in] vehicle_message - the decoded response, ignored if it is empty.
+/// @param[in] timestamp - reception time of the response, 0 if unknown.
+/// @param[in] table - subscriptions index holding the diagnostic subscription.
+void can_bus_t::push_diagnostic_message(decoder_worker_t& worker, openxc_VehicleMessage& vehicle_message, uint64_t timestamp, const utils::dispatch_table_t& table)
+{
+	std::shared_ptr<low_can_subscription_t> sub = table.get_diagnostic_subscription();
+
+	if (timestamp)
+		{vehicle_message.timestamp = timestamp;}
 	if( (vehicle_message.has_simple_message && vehicle_message.simple_message.has_name) &&
-		s.find(subscription_id) != s.end() && afb_event_is_valid(s[subscription_id]->get_event()))
+		sub && afb_event_is_valid(sub->get_event()))
 	{
-		if (apply_filter(vehicle_message, s[subscription_id]))
+		if (apply_filter(vehicle_message, sub))
 		{
-			std::lock_guard<std::mutex> decoded_can_message_lock(decoded_can_message_mutex_);
-			push_new_vehicle_message(subscription_id, vehicle_message);
-			AFB_DEBUG("%s CAN signals processed.",  s[subscription_id]->get_name().c_str());
+			push_new_vehicle_message(worker, sub->get_index(), vehicle_message);
+			sub->get_metrics().decoded.add();
 		}
 	}
 }
@@ -138,167 +242,447 @@ void can_bus_t::process_diagnostic_signals(diagnostic_manager_t& manager, const
 ///  Depending on the nature of message, if arbitration ID matches ID for a diagnostic response
 ///  then decoding a diagnostic message else use classic CAN signals decoding functions.
 ///
-/// It will take from the can_message_q_ queue the next can message to process then it search
+///  There is one such thread by decoder worker. It sleeps until the event loop notifies new CAN
+///  messages of its shard, then drains its can_message_q ring and wakes up the pushing thread
+///  once for the whole batch.
+///
+///  Subscriptions are looked up in the dispatch table snapshot published by the signals manager,
+///  reloaded only when its version changes, so the subscribed signals mutex is never taken here.
+///
+/// It will take from the can_message_q queue the next can message to process then it search
 ///  about signal subscribed if there is a valid afb_event for it. We only decode signal for which a
 ///  subscription has been made. Can message will be decoded using translate_signal that will pass it to the
 ///  corresponding decoding function if there is one assigned for that signal. If not, it will be the default
 ///  noopDecoder function that will operate on it.
 ///
+///  Time spent on each CAN message is recorded in the decoder latency histogram.
+///
 ///  TODO: make diagnostic messages parsing optionnal.
-void can_bus_t::can_decode_message()
+void can_bus_t::can_decode_message(decoder_worker_t& worker)
 {
 	utils::signals_manager_t& sm = utils::signals_manager_t::instance();
 
+	can_message_t can_message;
+	utils::snapshot_reader_t<utils::dispatch_table_t> table(sm.get_dispatch_table());
+
 	while(is_decoding_)
 	{
-		std::unique_lock<std::mutex> can_message_lock(can_message_mutex_);
-		new_can_message_cv_.wait(can_message_lock);
-		while(!can_message_q_.empty())
+		worker.can_message_q.wait();
+		while(next_can_message(worker, can_message))
 		{
-			const can_message_t can_message = next_can_message();
-			can_message_lock.unlock();
-
-			{
-				std::lock_guard<std::mutex> subscribed_signals_lock(sm.get_subscribed_signals_mutex());
-				std::map<int, std::shared_ptr<low_can_subscription_t> >& s = sm.get_subscribed_signals();
-				if(application_t::instance().get_diagnostic_manager().is_diagnostic_response(can_message))
-					{process_diagnostic_signals(application_t::instance().get_diagnostic_manager(), can_message, s);}
-				else
-					{process_can_signals(can_message, s);}
-			}
-			can_message_lock.lock();
+			utils::scoped_latency_t latency(worker.decode_latency);
+			if(application_t::instance().get_diagnostic_manager().is_diagnostic_response(can_message))
+				{process_diagnostic_signals(worker, application_t::instance().get_diagnostic_manager(), can_message, table.get());}
+			else
+				{process_can_signals(worker, can_message, table.get());}
 		}
-		new_decoded_can_message_.notify_one();
-		can_message_lock.unlock();
+		if(&worker == decoders_[0].get())
+			{process_diagnostic_pdus(worker, application_t::instance().get_diagnostic_manager(), table.get());}
+		worker.vehicle_message_q.notify();
 	}
 }
 
-/// @brief thread to push events to suscribers. It will read subscribed_signals map to look
+/// @brief thread to push events to suscribers. It will read the dispatch table snapshot to look
 /// which are events that has to be pushed.
+///
+/// It is the single consumer of all decoders vehicle message rings, sleeping until any of them
+/// is notified. Values of a subscription all come from the same decoder, so they stay in order.
+///
+/// The subscribed signals mutex is only tried when an event has no more clients, to remove its
+/// subscription. If a writer holds it, the removal is retried at the next push for that subscription.
+///
+/// Values of binary format subscriptions are serialized into a batch per subscription, pushed
+/// when it reaches the subscription batch size or once the ring is drained.
+///
+/// Time spent building and pushing each event is recorded in the push latency histogram.
 void can_bus_t::can_event_push()
 {
 	json_object* jo;
 	utils::signals_manager_t& sm = utils::signals_manager_t::instance();
+	utils::snapshot_reader_t<utils::dispatch_table_t> table(sm.get_dispatch_table());
+	std::pair<int, openxc_VehicleMessage> v_message;
+	std::map<int, event_batch_t> batches;
+
+	utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage> >* rings[DECODER_THREADS_MAX];
+	size_t ring_count = decoders_.size();
+	for(size_t i = 0; i < ring_count; i++)
+		{rings[i] = &decoders_[i]->vehicle_message_q;}
 
 	while(is_pushing_)
 	{
-		std::unique_lock<std::mutex> decoded_can_message_lock(decoded_can_message_mutex_);
-		new_decoded_can_message_.wait(decoded_can_message_lock);
-		while(!vehicle_message_q_.empty())
+		utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage> >::wait_any(rings, ring_count);
+		for(auto& worker: decoders_)
 		{
-			std::pair<int, openxc_VehicleMessage> v_message = next_vehicle_message();
-			decoded_can_message_lock.unlock();
+			while(next_vehicle_message(*worker, v_message))
 			{
-				std::lock_guard<std::mutex> subscribed_signals_lock(sm.get_subscribed_signals_mutex());
-				std::map<int, std::shared_ptr<low_can_subscription_t> >& s = sm.get_subscribed_signals();
-				if(s.find(v_message.first) != s.end() && afb_event_is_valid(s[v_message.first]->get_event()))
+				std::shared_ptr<low_can_subscription_t> sub = table.get().find_subscription(v_message.first);
+				if(! sub || ! afb_event_is_valid(sub->get_event()))
+					continue;
+
+				if(sub->get_format() == event_format_t::BINARY)
+				{
+					event_batch_t& batch = batches[v_message.first];
+					if(! serialize_vehicle(v_message.second, batch.frames))
+						continue;
+					batch.subscription = sub;
+					batch.count++;
+					if(v_message.second.has_diagnostic_response)
+						{batch.pids.push_back(v_message.second.diagnostic_response.pid);}
+					if(batch.count >= sub->get_batch())
+						{push_event_batch(batch);}
+					continue;
+				}
+
+				utils::scoped_latency_t latency(push_latency_);
+				jo = json_object_new_object();
+				jsonify_vehicle(v_message.second, jo);
+				int clients = afb_event_push(sub->get_event(), jo);
+				if(clients > 0)
+					{sub->get_metrics().pushed.add();}
+				else
+				{
+					push_failures_.add();
+					sub->get_metrics().failures.add();
+				}
+				if(clients == 0)
 				{
-					jo = json_object_new_object();
-					jsonify_vehicle(v_message.second, jo);
-					if(afb_event_push(s[v_message.first]->get_event(), jo) == 0)
-					{
-						if(v_message.second.has_diagnostic_response)
-							{on_no_clients(s[v_message.first], v_message.second.diagnostic_response.pid, s);}
-						else
-							{on_no_clients(s[v_message.first], s);}
-					}
+					uint32_t pid = v_message.second.diagnostic_response.pid;
+					release_subscription(sub, &pid, v_message.second.has_diagnostic_response ? 1 : 0);
 				}
 			}
-			decoded_can_message_lock.lock();
 		}
-		decoded_can_message_lock.unlock();
+
+		// Rings drained, incomplete batches aren't held until the next values.
+		for(auto it = batches.begin(); it != batches.end();)
+		{
+			if(it->second.count)
+				{push_event_batch(it->second);}
+			if(! table.get().find_subscription(it->first))
+				it = batches.erase(it);
+			else
+				++it;
+		}
+	}
+}
+
+/// @brief Push values serialized for a binary subscription as one event, then
+/// empty the batch keeping its buffers for the next values.
+///
+/// @param[in] batch - the batch to push.
+void can_bus_t::push_event_batch(event_batch_t& batch)
+{
+	utils::scoped_latency_t latency(push_latency_);
+	subscription_metrics_t& metrics = batch.subscription->get_metrics();
+	int clients = afb_event_push(batch.subscription->get_event(), jsonify_frames(batch.frames));
+	if(clients > 0)
+		{metrics.pushed.add(batch.count);}
+	else
+	{
+		push_failures_.add();
+		metrics.failures.add();
 	}
+	if(clients == 0)
+		{release_subscription(batch.subscription, batch.pids.data(), batch.pids.size());}
+
+	batch.subscription.reset();
+	batch.frames.clear();
+	batch.count = 0;
+	batch.pids.clear();
+}
+
+/// @brief Remove a subscription which doesn't have any client anymore. It is
+/// skipped if the subscribed signals mutex is busy, it will be done on a next push.
+///
+/// @param[in] sub - the subscription pushed.
+/// @param[in] pids - PIDs of the diagnostic responses pushed, their recurring requests are cleaned.
+/// @param[in] pid_count - number of PIDs.
+void can_bus_t::release_subscription(const std::shared_ptr<low_can_subscription_t>& sub, const uint32_t* pids, size_t pid_count)
+{
+	utils::signals_manager_t& sm = utils::signals_manager_t::instance();
+	std::unique_lock<std::mutex> subscribed_signals_lock(sm.get_subscribed_signals_mutex(), std::try_to_lock);
+	if(! subscribed_signals_lock.owns_lock())
+		return;
+
+	std::map<int, std::shared_ptr<low_can_subscription_t> >& s = sm.get_subscribed_signals();
+	if(pid_count == 0)
+		{on_no_clients(sub, s);}
+	for(size_t i = 0; i < pid_count; i++)
+		{on_no_clients(sub, pids[i], s);}
+}
+
+/// @brief Pin a thread on a CPU and name it, to find it in system tools.
+///
+/// @param[in] thread - the thread.
+/// @param[in] cpu - the CPU index, -1 to leave the thread on any CPU.
+/// @param[in] name - the thread name, at most 15 characters.
+void can_bus_t::set_thread_cpu(std::thread& thread, int cpu, const char* name)
+{
+	pthread_setname_np(thread.native_handle(), name);
+	if(cpu < 0)
+		return;
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	int err = pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+	if(err)
+		{AFB_WARNING("Can't pin thread %s on CPU %d: %s", name, cpu, strerror(err));}
 }
 
 /// @brief Will initialize threads that will decode
-///  and push subscribed events.
+///  and push subscribed events. Threads are joined by stop_threads.
 void can_bus_t::start_threads()
 {
+	if(is_decoding_ || is_pushing_)
+		return;
+
 	is_decoding_ = true;
-	th_decoding_ = std::thread(&can_bus_t::can_decode_message, this);
-	th_decoding_.detach();
+	for(size_t i = 0; i < decoders_.size(); i++)
+	{
+		decoder_worker_t& worker = *decoders_[i];
+		worker.thread = std::thread(&can_bus_t::can_decode_message, this, std::ref(worker));
+		set_thread_cpu(worker.thread, worker.cpu, ("low-can-dec" + std::to_string(i)).c_str());
+	}
 
 	is_pushing_ = true;
 	th_pushing_ = std::thread(&can_bus_t::can_event_push, this);
-	th_pushing_.detach();
+	set_thread_cpu(th_pushing_, pushing_cpu_, "low-can-push");
 }
 
 /// @brief Will stop all threads holded by can_bus_t object
-///  which are decoding and pushing then will wait that's
-/// they'll finish their job.
+///  which are decoding and pushing, waking them up so they
+/// finish their job even without any activity on the CAN bus,
+/// then wait for them to end.
 void can_bus_t::stop_threads()
 {
 	is_decoding_ = false;
 	is_pushing_ = false;
+	for(auto& worker: decoders_)
+	{
+		worker->can_message_q.wake();
+		worker->vehicle_message_q.wake();
+	}
+
+	for(auto& worker: decoders_)
+	{
+		if(worker->thread.joinable())
+			{worker->thread.join();}
+	}
+	if(th_pushing_.joinable())
+		{th_pushing_.join();}
 }
 
-/// @brief return new_can_message_cv_ member
-///
-/// @return  return new_can_message_cv_ member
-std::condition_variable& can_bus_t::get_new_can_message_cv()
+/// @brief Return the number of decoding threads.
+size_t can_bus_t::get_decoder_count() const
 {
-	return new_can_message_cv_;
+	return decoders_.size();
 }
 
-/// @brief return can_message_mutex_ member
+/// @brief Return the decoder of a CAN message shard. Diagnostic responses all go
+/// to the first decoder, the diagnostic manager isn't shared between threads.
+/// Other messages are distributed by CAN device and arbitration ID.
 ///
-/// @return  return can_message_mutex_ member
-std::mutex& can_bus_t::get_can_message_mutex()
+/// @param[in] can_msg - the CAN message to decode.
+decoder_worker_t& can_bus_t::get_decoder(const can_message_t& can_msg)
 {
-	return can_message_mutex_;
+	if(decoders_.size() == 1 || application_t::instance().get_diagnostic_manager().is_diagnostic_response(can_msg))
+		return *decoders_[0];
+
+	uint64_t key = ((uint64_t)(uint32_t)can_msg.get_ifindex() << 32) | can_msg.get_id();
+	return *decoders_[((key * 0x9E3779B97F4A7C15ULL) >> 32) % decoders_.size()];
 }
 
-/// @brief Return first can_message_t on the queue
+/// @brief Take the first can_message_t out of a decoder queue. Only called
+/// by that decoding thread.
+///
+/// @param[in] worker - the decoder.
+/// @param[out] can_msg - the can_message_t read.
 ///
-/// @return a can_message_t
-const can_message_t can_bus_t::next_can_message()
+/// @return false if the queue is empty.
+bool can_bus_t::next_can_message(decoder_worker_t& worker, can_message_t& can_msg)
 {
-	can_message_t can_msg;
-
-	if(!can_message_q_.empty())
+	if(worker.can_message_q.pop(can_msg))
 	{
-		can_msg = can_message_q_.front();
-		can_message_q_.pop();
-		AFB_DEBUG("Here is the next can message : id %X, length %X, data %02X%02X%02X%02X%02X%02X%02X%02X", can_msg.get_id(), can_msg.get_length(),
-			can_msg.get_data()[0], can_msg.get_data()[1], can_msg.get_data()[2], can_msg.get_data()[3], can_msg.get_data()[4], can_msg.get_data()[5], can_msg.get_data()[6], can_msg.get_data()[7]);
-		return can_msg;
+		LOW_CAN_TRACE(utils::trace_level_t::FRAMES,
+			utils::tracer_t::instance().frame(utils::trace_point_t::NEXT_CAN_MESSAGE, can_msg.get_ifindex(), can_msg.get_id(), can_msg.get_data(), can_msg.get_length()));
+		return true;
 	}
-
-	return can_msg;
+	return false;
 }
 
-/// @brief Push a can_message_t into the queue
+/// @brief Push a can_message_t into the queue of its decoder. Only called from the
+/// event loop. Decoding threads aren't woken up, call notify_new_can_message
+/// once the batch of messages read is pushed.
 ///
 /// @param[in] can_msg - the const reference can_message_t object to push into the queue
-void can_bus_t::push_new_can_message(const can_message_t& can_msg)
+///
+/// @return false if the message has been dropped because the queue is full.
+bool can_bus_t::push_new_can_message(const can_message_t& can_msg)
 {
-	can_message_q_.push(can_msg);
+	decoder_worker_t& worker = get_decoder(can_msg);
+	bus_metrics_t* bus = get_bus_metrics(can_msg.get_ifindex());
+	worker.pending = true;
+
+	// The event loop is the only producer, so any drop during the push is due to this message.
+	uint64_t dropped = worker.can_message_q.get_dropped();
+	bool pushed = worker.can_message_q.push(can_msg);
+	if(bus)
+	{
+		if(pushed)
+			{bus->frames.add();}
+		if(worker.can_message_q.get_dropped() != dropped)
+			{bus->dropped.add();}
+	}
+	if(pushed)
+		return true;
+	AFB_DEBUG("CAN message queue full, message id %X dropped", can_msg.get_id());
+	return false;
 }
 
-/// @brief Return first openxc_VehicleMessage on the queue
+/// @brief Find the counters of a CAN device, taking a free slot the first time
+/// a message of that device is read. Only called from the event loop.
+///
+/// @param[in] ifindex - interface index of the CAN device.
 ///
-/// @return a openxc_VehicleMessage containing a decoded can message
-std::pair<int, openxc_VehicleMessage> can_bus_t::next_vehicle_message()
+/// @return the counters, nullptr if all slots are taken by other devices.
+bus_metrics_t* can_bus_t::get_bus_metrics(int ifindex)
 {
-	std::pair<int, openxc_VehicleMessage> v_msg;
+	for(auto& bus: bus_metrics_)
+	{
+		int slot_ifindex = bus.ifindex.load(std::memory_order_relaxed);
+		if(slot_ifindex == ifindex)
+			return &bus;
+		if(slot_ifindex == 0)
+		{
+			bus.ifindex.store(ifindex, std::memory_order_release);
+			return &bus;
+		}
+	}
+	return nullptr;
+}
 
-	if(! vehicle_message_q_.empty())
+/// @brief Wake up the decoding threads which got new CAN messages, if they wait for them.
+void can_bus_t::notify_new_can_message()
+{
+	for(auto& worker: decoders_)
 	{
-		v_msg = vehicle_message_q_.front();
-		vehicle_message_q_.pop();
-		AFB_DEBUG("next vehicle message poped");
-		return v_msg;
+		if(worker->pending)
+		{
+			worker->pending = false;
+			worker->can_message_q.notify();
+		}
 	}
+}
+
+/// @brief Wake up the first decoder for diagnostic responses read on kernel
+/// ISO-TP sockets. Only called from the event loop. They aren't in its CAN
+/// messages queue, so it is woken up even if it isn't waiting on it yet.
+void can_bus_t::wake_diagnostic_decoder()
+{
+	decoders_[0]->can_message_q.wake();
+}
 
-	return v_msg;
+/// @brief Return a decoder CAN message queue to read its counters.
+const utils::spsc_ring_t<can_message_t>& can_bus_t::get_can_message_queue(size_t decoder) const
+{
+	return decoders_[decoder]->can_message_q;
+}
+
+/// @brief Take the first openxc_VehicleMessage out of a decoder queue. Only called
+/// by the pushing thread.
+///
+/// @param[in] worker - the decoder.
+/// @param[out] v_msg - subscription index and decoded can message read.
+///
+/// @return false if the queue is empty.
+bool can_bus_t::next_vehicle_message(decoder_worker_t& worker, std::pair<int, openxc_VehicleMessage>& v_msg)
+{
+	return worker.vehicle_message_q.pop(v_msg);
 }
 
-/// @brief Push a openxc_VehicleMessage into the queue
+/// @brief Push a openxc_VehicleMessage into a decoder queue. Only called by
+/// that decoding thread.
 ///
+/// @param[in] worker - the decoder.
 /// @param[in] v_msg - const reference openxc_VehicleMessage object to push into the queue
-void can_bus_t::push_new_vehicle_message(int subscription_id, const openxc_VehicleMessage& v_msg)
+///
+/// @return false if the message has been dropped because the queue is full.
+bool can_bus_t::push_new_vehicle_message(decoder_worker_t& worker, int subscription_id, const openxc_VehicleMessage& v_msg)
+{
+	if(worker.vehicle_message_q.push(std::make_pair(subscription_id, v_msg)))
+		return true;
+	AFB_DEBUG("Vehicle message queue full, message for subscription %d dropped", subscription_id);
+	return false;
+}
+
+/// @brief Return a decoder vehicle message queue to read its counters.
+const utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage> >& can_bus_t::get_vehicle_message_queue(size_t decoder) const
 {
-	vehicle_message_q_.push(std::make_pair(subscription_id, v_msg));
+	return decoders_[decoder]->vehicle_message_q;
+}
+
+/// @brief Return the histogram of the event loop read callbacks, only recorded by them.
+utils::latency_histogram_t& can_bus_t::get_read_latency()
+{
+	return read_latency_;
+}
+
+/// @brief Build the counters and queue depth of a ring.
+template <typename T>
+static json_object* jsonify_queue(const utils::spsc_ring_t<T>& ring)
+{
+	json_object* jo = json_object_new_object();
+	json_object_object_add(jo, "depth", json_object_new_int64(ring.size()));
+	json_object_object_add(jo, "capacity", json_object_new_int64(ring.capacity()));
+	json_object_object_add(jo, "pushed", json_object_new_int64(ring.get_pushed()));
+	json_object_object_add(jo, "dropped", json_object_new_int64(ring.get_dropped()));
+	return jo;
+}
+
+/// @brief Gather the counters of the reading, decoding and pushing threads.
+/// Each one is read without lock, so they may be a few messages apart.
+///
+/// @return a JSON object with "buses", "read", "decoders" and "push" members,
+///  latencies are in nanoseconds.
+json_object* can_bus_t::jsonify_stats() const
+{
+	json_object* buses = json_object_new_array();
+	for(const auto& bus: bus_metrics_)
+	{
+		int ifindex = bus.ifindex.load(std::memory_order_acquire);
+		if(ifindex == 0)
+			break;
+
+		char ifname[IF_NAMESIZE];
+		json_object* jbus = json_object_new_object();
+		json_object_object_add(jbus, "device", json_object_new_string(::if_indextoname(ifindex, ifname) ? ifname : ""));
+		json_object_object_add(jbus, "ifindex", json_object_new_int(ifindex));
+		json_object_object_add(jbus, "frames", json_object_new_int64(bus.frames.get()));
+		json_object_object_add(jbus, "dropped", json_object_new_int64(bus.dropped.get()));
+		json_object_array_add(buses, jbus);
+	}
+
+	json_object* decoders = json_object_new_array();
+	for(const auto& worker: decoders_)
+	{
+		json_object* jdecoder = json_object_new_object();
+		json_object_object_add(jdecoder, "cpu", json_object_new_int(worker->cpu));
+		json_object_object_add(jdecoder, "can_queue", jsonify_queue(worker->can_message_q));
+		json_object_object_add(jdecoder, "vehicle_queue", jsonify_queue(worker->vehicle_message_q));
+		json_object_object_add(jdecoder, "latency", worker->decode_latency.jsonify());
+		json_object_array_add(decoders, jdecoder);
+	}
+
+	json_object* push = json_object_new_object();
+	json_object_object_add(push, "failures", json_object_new_int64(push_failures_.get()));
+	json_object_object_add(push, "latency", push_latency_.jsonify());
+
+	json_object* jo = json_object_new_object();
+	json_object_object_add(jo, "buses", buses);
+	json_object_object_add(jo, "read", read_latency_.jsonify());
+	json_object_object_add(jo, "decoders", decoders);
+	json_object_object_add(jo, "push", push);
+	return jo;
 }
 
 /// @brief Fills the CAN device map member with value from device
@@ -314,9 +698,88 @@ void can_bus_t::set_can_devices()
 			AFB_ERROR("No mapping found in config file: '%s'. Check it that it have a CANbus-mapping section.",
 				conf_file_.filepath().c_str());
 		}
+
+		bus_reader_ = conf_file_.get_option("reader") == "bus";
+		if(bus_reader_)
+			{AFB_NOTICE("CAN frames will be read using one socket by CAN device");}
+
+		// Threads aren't started yet, decoders and their queues can be reallocated.
+		std::string decoders = conf_file_.get_option("decoders");
+		if(! decoders.empty())
+		{
+			size_t count = ::strtoul(decoders.c_str(), nullptr, 0);
+			if(count < 1 || count > DECODER_THREADS_MAX)
+			{
+				AFB_WARNING("decoders must be between 1 and %d, %s ignored", DECODER_THREADS_MAX, decoders.c_str());
+				count = 1;
+			}
+			while(decoders_.size() < count)
+				{decoders_.emplace_back(new decoder_worker_t());}
+		}
+
+		// Comma separated CPU indexes, used in turn by decoders then the pushing thread.
+		std::string cpus = conf_file_.get_option("cpus");
+		if(! cpus.empty())
+		{
+			std::vector<int> cpu_list;
+			const char* p = cpus.c_str();
+			char* end;
+			for(long cpu = ::strtol(p, &end, 0); end != p; cpu = ::strtol(p, &end, 0))
+			{
+				cpu_list.push_back((int)cpu);
+				p = *end == ',' ? end + 1 : end;
+			}
+			if(! cpu_list.empty())
+			{
+				for(size_t i = 0; i < decoders_.size(); i++)
+					{decoders_[i]->cpu = cpu_list[i % cpu_list.size()];}
+				pushing_cpu_ = cpu_list[decoders_.size() % cpu_list.size()];
+			}
+		}
+
+		std::string queue_size = conf_file_.get_option("queue-size");
+		size_t size = queue_size.empty() ? 0 : ::strtoul(queue_size.c_str(), nullptr, 0);
+		utils::overflow_policy_t policy = utils::overflow_policy_from_string(conf_file_.get_option("overflow-policy"), utils::overflow_policy_t::DROP_OLDEST);
+		for(auto& worker: decoders_)
+		{
+			if(size > 0)
+			{
+				worker->can_message_q.resize(size);
+				worker->vehicle_message_q.resize(size);
+			}
+			worker->can_message_q.set_overflow_policy(policy);
+			worker->vehicle_message_q.set_overflow_policy(policy);
+		}
+		AFB_NOTICE("%zu CAN decoding threads, their queues can hold %zu messages, dropping %s ones when full", decoders_.size(),
+			decoders_[0]->can_message_q.capacity(), policy == utils::overflow_policy_t::DROP_OLDEST ? "oldest" : "newest");
 	}
 }
 
+/// @brief Tell if the CAN bus devices are read using one reader by device
+/// rather than one socket by subscription.
+bool can_bus_t::get_bus_reader() const
+{
+	return bus_reader_;
+}
+
+/// @brief Return the reader of a linux CAN device, creating it at the first
+/// call for that device.
+///
+/// @param[in] device_name - linux CAN device name to read.
+///
+/// @return the reader or nullptr if the device name is empty.
+std::shared_ptr<low_can_reader_t> can_bus_t::get_reader(const std::string& device_name)
+{
+	if(device_name.empty())
+		return nullptr;
+
+	std::lock_guard<std::mutex> readers_lock(readers_mutex_);
+	std::shared_ptr<low_can_reader_t>& reader = readers_[device_name];
+	if(! reader)
+		reader = std::make_shared<low_can_reader_t>(device_name);
+	return reader;
+}
+
 
 /// @brief Return the CAN device index from the map
 /// map are sorted so index depend upon alphabetical sorting.
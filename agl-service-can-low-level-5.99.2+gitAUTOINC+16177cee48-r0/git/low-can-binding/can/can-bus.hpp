@@ -19,71 +19,137 @@
 #pragma once
 
 #include <utility>
+#include <atomic>
+#include <vector>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <linux/can.h>
-#include <condition_variable>
 
 #include "openxc.pb.h"
 #include "can-message.hpp"
 #include "../utils/config-parser.hpp"
+#include "../utils/spsc-ring.hpp"
+#include "../utils/metrics.hpp"
 #include "../binding/low-can-subscription.hpp"
 
 #define CAN_ACTIVE_TIMEOUT_S 30
+#define CAN_MESSAGE_QUEUE_SIZE 4096
+#define VEHICLE_MESSAGE_QUEUE_SIZE 4096
+#define DECODER_THREADS_MAX SPSC_RING_WAIT_MAX
+#define BUS_METRICS_MAX 16
 
 class diagnostic_manager_t;
+namespace utils { class dispatch_table_t; }
+
+/// @brief A decoding thread and its rings. CAN messages are sharded between
+/// decoders by CAN device and arbitration ID, so messages of a signal are
+/// always decoded in order by the same thread.
+struct decoder_worker_t
+{
+	utils::spsc_ring_t<can_message_t> can_message_q{CAN_MESSAGE_QUEUE_SIZE}; ///< can_message_q - CAN messages of the shard, filled by the event loop.
+	utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage> > vehicle_message_q{VEHICLE_MESSAGE_QUEUE_SIZE}; ///< vehicle_message_q - decoded messages, read by the pushing thread.
+	std::thread thread; ///< thread - the decoding thread.
+	int cpu = -1; ///< cpu - CPU the thread is pinned to, -1 if none.
+	bool pending = false; ///< pending - CAN messages pushed since the last notification, only used by the event loop.
+	utils::latency_histogram_t decode_latency; ///< decode_latency - time spent decoding each CAN message, written by the decoding thread.
+
+	// Rings indexes are cache line aligned, which plain new ignores before C++17.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+};
+
+/// @brief Counters of the CAN messages read on a CAN device, only written by the event loop.
+struct bus_metrics_t
+{
+	std::atomic<int> ifindex{0}; ///< ifindex - interface index of the CAN device, 0 if the slot is free.
+	utils::counter_t frames; ///< frames - CAN messages queued to decoders.
+	utils::counter_t dropped; ///< dropped - CAN messages lost because a decoder queue was full.
+};
+
+/// @brief Values serialized for a binary format subscription, waiting to be pushed at once.
+struct event_batch_t
+{
+	std::shared_ptr<low_can_subscription_t> subscription; ///< subscription - the subscription to push to.
+	std::string frames; ///< frames - length delimited VehicleMessage frames, see serialize_vehicle.
+	unsigned int count = 0; ///< count - number of frames.
+	std::vector<uint32_t> pids; ///< pids - PIDs of diagnostic responses in frames, to clean their requests if nobody listens.
+};
 
 /// @brief Object used to handle decoding and manage event queue to be pushed.
 ///
 /// This object is also used to initialize can_bus_dev_t object after reading
 /// json conf file describing the CAN devices to use. Thus, those object will read
-/// on the device the CAN frame and push them into the can_bus_t can_message_q_ queue.
+/// on the device the CAN frame and push them into the can_bus_t decoders queues.
 ///
-/// That queue will later be decoded and pushed to subscribers.
+/// That queue will later be decoded and pushed to subscribers. Each decoding thread
+/// has two bounded single producer single consumer rings: its can_message_q is
+/// filled by the event loop with the CAN messages of its shard, its vehicle_message_q
+/// is filled by the decoding thread and read by the single pushing thread.
 class can_bus_t
 {
 private:
 	utils::config_parser_t conf_file_; ///< configuration file handle used to initialize can_bus_dev_t objects.
 
-	bool apply_filter(const openxc_VehicleMessage& vehicle_message, std::shared_ptr<low_can_subscription_t> can_subscription);
-	void process_can_signals(const can_message_t& can_message, std::map<int, std::shared_ptr<low_can_subscription_t> >& s);
-	void process_diagnostic_signals(diagnostic_manager_t& manager, const can_message_t& can_message, std::map<int, std::shared_ptr<low_can_subscription_t> >& s);
+	bool apply_filter(const openxc_VehicleMessage& vehicle_message, std::shared_ptr<low_can_subscription_t> can_subscription, bool shared_filter = false);
+	void process_can_signals(decoder_worker_t& worker, const can_message_t& can_message, const utils::dispatch_table_t& table);
+	void process_diagnostic_signals(decoder_worker_t& worker, diagnostic_manager_t& manager, const can_message_t& can_message, const utils::dispatch_table_t& table);
+	void process_diagnostic_pdus(decoder_worker_t& worker, diagnostic_manager_t& manager, const utils::dispatch_table_t& table);
+	void push_diagnostic_message(decoder_worker_t& worker, openxc_VehicleMessage& vehicle_message, uint64_t timestamp, const utils::dispatch_table_t& table);
 
-	void can_decode_message();
-	std::thread th_decoding_; ///< thread that will handle decoding a can frame
-	bool is_decoding_ = false; ///< boolean member controling thread while loop
+	void can_decode_message(decoder_worker_t& worker);
+	std::vector<std::unique_ptr<decoder_worker_t> > decoders_; ///< decoders_ - decoding threads, the first one also decodes all diagnostic responses.
+	std::atomic<bool> is_decoding_{false}; ///< boolean member controling thread while loop
 
 	void can_event_push();
+	void push_event_batch(event_batch_t& batch);
+	void release_subscription(const std::shared_ptr<low_can_subscription_t>& sub, const uint32_t* pids, size_t pid_count);
 	std::thread th_pushing_; ///< thread that will handle pushing decoded can frame to subscribers
-	bool is_pushing_ = false; ///< boolean member controling thread while loop
+	int pushing_cpu_ = -1; ///< pushing_cpu_ - CPU the pushing thread is pinned to, -1 if none.
+	std::atomic<bool> is_pushing_{false}; ///< boolean member controling thread while loop
 
-	std::condition_variable new_can_message_cv_; ///< condition_variable use to wait until there is a new CAN message to read
-	std::mutex can_message_mutex_; ///< mutex protecting the can_message_q_ queue.
-	std::queue <can_message_t> can_message_q_; ///< queue that will store can_message_t to be decoded
+	utils::latency_histogram_t read_latency_; ///< read_latency_ - time spent in event loop read callbacks, written by the event loop.
+	utils::latency_histogram_t push_latency_; ///< push_latency_ - time spent pushing each event, written by the pushing thread.
+	utils::counter_t push_failures_; ///< push_failures_ - events pushed without any client or with an error, written by the pushing thread.
+	bus_metrics_t bus_metrics_[BUS_METRICS_MAX]; ///< bus_metrics_ - counters by CAN device, slots are taken by the event loop.
+	bus_metrics_t* get_bus_metrics(int ifindex);
 
-	std::condition_variable new_decoded_can_message_; ///< condition_variable use to wait until there is a new vehicle message to read from the queue vehicle_message_q_
-	std::mutex decoded_can_message_mutex_;  ///< mutex protecting the vehicle_message_q_ queue.
-	std::queue <std::pair<int, openxc_VehicleMessage> > vehicle_message_q_; ///< queue that will store openxc_VehicleMessage to be pushed
+	decoder_worker_t& get_decoder(const can_message_t& can_msg);
+	static void set_thread_cpu(std::thread& thread, int cpu, const char* name);
 
 	std::vector<std::pair<std::string, std::string> > can_devices_mapping_; ///< can_devices_mapping_ - holds a mapping between logical CAN devices names and linux CAN devices names.
+
+	bool bus_reader_ = false; ///< bus_reader_ - if true, use one reader socket by CAN device instead of one socket by subscription.
+	std::mutex readers_mutex_; ///< readers_mutex_ - mutex protecting the readers_ map.
+	std::map<std::string, std::shared_ptr<low_can_reader_t> > readers_; ///< readers_ - per CAN device readers, key is the linux CAN device name.
 public:
 	explicit can_bus_t(utils::config_parser_t conf_file);
 	can_bus_t(can_bus_t&&);
 	~can_bus_t();
 
 	void set_can_devices();
+	utils::config_parser_t& get_conf_file();
 	int get_can_device_index(const std::string& bus_name) const;
 	const std::string get_can_device_name(const std::string& id_name) const;
 
+	bool get_bus_reader() const;
+	std::shared_ptr<low_can_reader_t> get_reader(const std::string& device_name);
+
 	void start_threads();
 	void stop_threads();
 
-	const can_message_t next_can_message();
-	void push_new_can_message(const can_message_t& can_msg);
-	std::mutex& get_can_message_mutex();
-	std::condition_variable& get_new_can_message_cv();
+	size_t get_decoder_count() const;
+
+	bool next_can_message(decoder_worker_t& worker, can_message_t& can_msg);
+	bool push_new_can_message(const can_message_t& can_msg);
+	void notify_new_can_message();
+	void wake_diagnostic_decoder();
+	const utils::spsc_ring_t<can_message_t>& get_can_message_queue(size_t decoder) const;
+
+	bool next_vehicle_message(decoder_worker_t& worker, std::pair<int, openxc_VehicleMessage>& v_msg);
+	bool push_new_vehicle_message(decoder_worker_t& worker, int subscription_id, const openxc_VehicleMessage& v_msg);
+	const utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage> >& get_vehicle_message_queue(size_t decoder) const;
 
-	std::pair<int, openxc_VehicleMessage> next_vehicle_message();
-	void push_new_vehicle_message(int subscription_id, const openxc_VehicleMessage& v_msg);
+	utils::latency_histogram_t& get_read_latency();
+	json_object* jsonify_stats() const;
 };
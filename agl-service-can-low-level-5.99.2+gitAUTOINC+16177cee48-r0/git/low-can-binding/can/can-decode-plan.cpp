@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "can-decode-plan.hpp"
+
+#include <endian.h>
+#include <string.h>
+
+#include "bitfield/bitfield.h"
+
+/// @brief Build an empty plan, signals are added at message definition construction.
+decode_plan_t::decode_plan_t()
+{}
+
+/// @brief Compile a signal extraction at the end of the plan.
+///
+/// @param[in] signal - the signal, used as key by find().
+/// @param[in] bit_position - starting bit, the most significant bit of the first byte being 0.
+/// @param[in] bit_size - width of the bit field.
+/// @param[in] factor - the raw value is multiplied by it.
+/// @param[in] offset - then added to it.
+///
+/// @return false if the plan is full, the signal has then to be decoded by itself.
+bool decode_plan_t::add(const can_signal_t* signal, uint16_t bit_position, uint8_t bit_size, float factor, float offset)
+{
+	if(signals_.size() >= DECODE_PLAN_MAX_SIGNALS)
+		return false;
+
+	signals_.push_back(signal);
+	bit_positions_.push_back(bit_position);
+	bit_sizes_.push_back(bit_size);
+	factors_.push_back(factor);
+	offsets_.push_back(offset);
+	if(bit_size < 1 || bit_size > 64 || (unsigned int)bit_position + bit_size > 64)
+	{
+		fallbacks_.push_back(shifts_.size());
+		shifts_.push_back(0);
+		masks_.push_back(0);
+		return true;
+	}
+	shifts_.push_back((uint8_t)(64 - bit_position - bit_size));
+	masks_.push_back(bit_size == 64 ? ~(uint64_t)0 : ((uint64_t)1 << bit_size) - 1);
+	return true;
+}
+
+/// @brief Number of values written by decode().
+size_t decode_plan_t::size() const
+{
+	return signals_.size();
+}
+
+/// @brief Get the index of a signal value in the array filled by decode().
+///
+/// @return The index, -1 if the signal isn't part of the plan.
+int decode_plan_t::find(const can_signal_t* signal) const
+{
+	for(size_t i = 0; i < signals_.size(); i++)
+	{
+		if(signals_[i] == signal)
+			return (int)i;
+	}
+	return -1;
+}
+
+/// @brief Extract all the signals of the plan from a CAN message.
+///
+/// Values are the same as those of bitfield_parse_float: the raw value
+/// multiplied by the factor then added to the offset. Signals beyond the
+/// 8 first bytes are read within the message payload size, 64 bytes for
+/// a CAN FD frame.
+///
+/// @param[in] message - CAN message to decode.
+/// @param[out] values - array of at least size() floats, receiving signal values by plan index.
+void decode_plan_t::decode(const can_message_t& message, float* values) const
+{
+	uint64_t word;
+	::memcpy(&word, message.get_data(), sizeof(word));
+	word = be64toh(word);
+
+	const size_t count = shifts_.size();
+	const uint8_t* shifts = shifts_.data();
+	const uint64_t* masks = masks_.data();
+	const float* factors = factors_.data();
+	const float* offsets = offsets_.data();
+	for(size_t i = 0; i < count; i++)
+		{values[i] = (float)((word >> shifts[i]) & masks[i]) * factors[i] + offsets[i];}
+
+	for(size_t i : fallbacks_)
+	{
+		uint64_t raw = get_bitfield(message.get_data(), message.get_maxdlen(),
+			bit_positions_[i], bit_sizes_[i]);
+		values[i] = (float)raw * factors_[i] + offsets_[i];
+	}
+}
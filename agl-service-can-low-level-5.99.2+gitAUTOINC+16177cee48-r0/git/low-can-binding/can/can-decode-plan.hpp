@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "can-message.hpp"
+
+class can_signal_t;
+
+/// @brief Maximum number of signals a decode plan extracts in one pass, signals
+/// beyond it in a message definition are decoded one by one.
+#define DECODE_PLAN_MAX_SIGNALS 64
+
+/// @brief Precompiled extraction of all the signals of a CAN message definition.
+///
+/// Bit position and size of each signal are turned once, at load time, into a
+/// shift and a mask applied to the 8 first payload bytes read as one big endian
+/// 64 bits word. Decoding a message then loads the payload once and extracts
+/// every signal with a single loop over flat arrays, instead of walking the
+/// payload bytes with bitfield_parse_float for each signal.
+///
+/// Signals not held in the 8 first bytes, as those in the rest of a CAN FD
+/// payload, keep the bitfield-c path.
+class decode_plan_t
+{
+private:
+	std::vector<const can_signal_t*> signals_; ///< signals_ - compiled signals, in the message definition order.
+	std::vector<uint16_t> bit_positions_; ///< bit_positions_ - signals bit position, for the fallback path.
+	std::vector<uint8_t> bit_sizes_; ///< bit_sizes_ - signals bit size, for the fallback path.
+	std::vector<uint8_t> shifts_; ///< shifts_ - right shift bringing a signal to the word lowest bits.
+	std::vector<uint64_t> masks_; ///< masks_ - mask of a signal bit size.
+	std::vector<float> factors_; ///< factors_ - signals factor.
+	std::vector<float> offsets_; ///< offsets_ - signals offset.
+	std::vector<size_t> fallbacks_; ///< fallbacks_ - indexes of signals that don't fit in the 64 bits word.
+
+public:
+	decode_plan_t();
+
+	bool add(const can_signal_t* signal, uint16_t bit_position, uint8_t bit_size, float factor, float offset);
+
+	size_t size() const;
+	int find(const can_signal_t* signal) const;
+
+	void decode(const can_message_t& message, float* values) const;
+};
@@ -18,9 +18,11 @@
 #include "can-decoder.hpp"
 
 #include "canutil/read.h"
+#include "bitfield/bitfield.h"
 #include "../utils/openxc-utils.hpp"
 #include "can-message-definition.hpp"
 #include "../binding/low-can-hat.hpp"
+#include "../utils/trace.hpp"
 
 /// @brief Parses the signal's bitfield from the given data and returns the raw
 /// value.
@@ -29,13 +31,13 @@
 /// @param[in] message - can_message_t to parse
 ///
 /// @return Returns the raw value of the signal parsed as a bitfield from the given byte
-/// array.
+/// array. The whole payload is considered, 64 bytes for a CAN FD frame.
 ///
 float decoder_t::parse_signal_bitfield(can_signal_t& signal, const can_message_t& message)
 {
-	 return bitfield_parse_float(message.get_data(), CAN_MESSAGE_SIZE,
-			signal.get_bit_position(), signal.get_bit_size(), signal.get_factor(),
-			signal.get_offset());
+	uint64_t raw = get_bitfield(message.get_data(), message.get_maxdlen(),
+			signal.get_bit_position(), signal.get_bit_size());
+	return (float)raw * signal.get_factor() + signal.get_offset();
 }
 
 /// @brief Wraps a raw CAN signal value in a DynamicField without modification.
@@ -147,7 +149,22 @@ openxc_DynamicField decoder_t::decode_state(can_signal_t& signal, float value, b
 openxc_DynamicField decoder_t::translate_signal(can_signal_t& signal, const can_message_t& message, bool* send)
 {
 	float value = decoder_t::parse_signal_bitfield(signal, message);
-	AFB_DEBUG("Decoded message from parse_signal_bitfield: %f", value);
+	return translate_signal(signal, message, value, send);
+}
+
+/// @brief Same as above but with the signal value already extracted from the
+/// CAN message, by its message definition decode plan.
+///
+/// @param[in] signal - The details of the signal to decode and forward.
+/// @param[in] message - The received CAN message that contains this signal.
+/// @param[in] value - The signal value parsed from the message.
+/// @param[out] send - An output parameter that will be flipped to false if the value could
+///      not be decoded.
+///
+openxc_DynamicField decoder_t::translate_signal(can_signal_t& signal, const can_message_t& message, float value, bool* send)
+{
+	LOW_CAN_TRACE(utils::trace_level_t::SIGNALS,
+		utils::tracer_t::instance().value(utils::trace_point_t::SIGNAL_DECODED, message.get_id(), signal.get_bit_position(), value, signal.get_name()));
 
 	// Must call the decoders every time, regardless of if we are going to
 	// decide to send the signal or not.
@@ -32,6 +32,7 @@ public:
 	static openxc_DynamicField decode_noop(can_signal_t& signal, float value, bool* send);
 
 	static openxc_DynamicField translate_signal(can_signal_t& signal, const can_message_t& messag, bool* send);
+	static openxc_DynamicField translate_signal(can_signal_t& signal, const can_message_t& message, float value, bool* send);
 
 	static openxc_DynamicField decode_signal(can_signal_t& signal, const can_message_t& message, bool* send);
 
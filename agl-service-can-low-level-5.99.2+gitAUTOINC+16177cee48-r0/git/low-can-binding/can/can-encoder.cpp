@@ -17,7 +17,10 @@
 
 #include "can-encoder.hpp"
 
+#include <algorithm>
+
 #include "canutil/write.h"
+#include "bitfield/bitfield.h"
 #include "../utils/openxc-utils.hpp"
 #include "can-message-definition.hpp"
 
@@ -25,35 +28,75 @@
 ///
 /// @param[in] signal - The CAN signal to write, including the bit position and bit size.
 /// @param[in] value - The encoded integer value to write in the CAN signal.
-/// @param[out] data - The destination buffer.
-/// @param[in] length - The length of the destination buffer.
 ///
-/// @return Returns a can_frame struct initialized and ready to be send.
-const can_frame encoder_t::build_frame(const std::shared_ptr<can_signal_t>& signal, uint64_t value)
+/// @return Returns a canfd_frame struct initialized and ready to be send. Its length is
+/// the one of the signal message, 8 bytes or 64 for a CAN FD message which also has
+/// the bit rate switch flag if its definition asks for it.
+const canfd_frame encoder_t::build_frame(const std::shared_ptr<can_signal_t>& signal, uint64_t value)
 {
-	struct can_frame cf;
+	struct canfd_frame cf;
 	::memset(&cf, 0, sizeof(cf));
 
-	cf.can_id = signal->get_message()->get_id();
-	cf.can_dlc = CAN_MAX_DLEN;
+	can_message_definition_t* message = signal->get_message();
+	cf.can_id = message->get_id();
+	cf.len = message->get_length();
+	if(message->get_bit_rate_switch())
+		cf.flags = CANFD_BRS;
 
 	signal->set_last_value((float)value);
 
-	for(const auto& sig: signal->get_message()->get_can_signals())
+	for(const auto& sig: message->get_can_signals())
 	{
 		float last_value = sig->get_last_value();
-		bitfield_encode_float(last_value,
+		set_bitfield(float_to_fixed_point(last_value, sig->get_factor(), sig->get_offset()),
 							sig->get_bit_position(),
 							sig->get_bit_size(),
-							sig->get_factor(),
-							sig->get_offset(),
 							cf.data,
-							CAN_MAX_DLEN);
+							cf.len);
 	}
 
 	return cf;
 }
 
+/// @brief Build a frame of a CAN message from its last known payload, for
+/// signals to be written over it with encode_signal.
+///
+/// @param[in] message - The CAN message definition.
+///
+/// @return Returns a canfd_frame struct holding the last payload received or
+/// written for this message, zeroed if there was none.
+const canfd_frame encoder_t::build_frame(const can_message_definition_t& message)
+{
+	struct canfd_frame cf;
+	::memset(&cf, 0, sizeof(cf));
+
+	cf.can_id = message.get_id();
+	cf.len = message.get_length();
+	if(message.get_bit_rate_switch())
+		cf.flags = CANFD_BRS;
+
+	message.get_last_value(cf.data, cf.len);
+
+	return cf;
+}
+
+/// @brief Write a value in a CAN signal of a frame, other bits are untouched.
+///
+/// @param[in] signal - The CAN signal to write, including the bit position and bit size.
+/// @param[in] value - The value to write in the CAN signal.
+/// @param[in,out] cf - The frame of the signal message, built by build_frame.
+///
+/// @return false if the value doesn't fit in the signal bit field, the frame is then unchanged.
+/// The signal last value isn't updated, it is up to the caller once the frame is sent.
+bool encoder_t::encode_signal(const std::shared_ptr<can_signal_t>& signal, uint64_t value, canfd_frame& cf)
+{
+	return set_bitfield(float_to_fixed_point((float)value, signal->get_factor(), signal->get_offset()),
+			signal->get_bit_position(),
+			signal->get_bit_size(),
+			cf.data,
+			cf.len);
+}
+
 /// @brief Encode a boolean into an integer, fit for a CAN signal bitfield.
 ///
 /// This is a shortcut for encodeDynamicField(CanSignal*, openxc_DynamicField*,
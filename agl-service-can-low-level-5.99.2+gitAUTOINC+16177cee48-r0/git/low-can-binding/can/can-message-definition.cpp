@@ -17,10 +17,50 @@
 
 #include "can-message-definition.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include "../binding/application.hpp"
 
+last_payload_t::last_payload_t(size_t size)
+	: data_(size)
+{}
+
+last_payload_t::last_payload_t(const last_payload_t& other)
+{
+	std::lock_guard<std::mutex> lock(other.mutex_);
+	data_ = other.data_;
+}
+
+/// @brief Record a payload. It is copied in place, without allocation, and
+/// truncated or zero padded to the payload size.
+///
+/// @param[in] data - payload bytes.
+/// @param[in] length - number of bytes of data.
+void last_payload_t::set(const uint8_t* data, size_t length)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t n = std::min(length, data_.size());
+	::memcpy(data_.data(), data, n);
+	::memset(data_.data() + n, 0, data_.size() - n);
+}
+
+/// @brief Copy the payload.
+///
+/// @param[out] data - buffer receiving the payload.
+/// @param[in] length - size of data.
+///
+/// @return number of bytes copied.
+size_t last_payload_t::get(uint8_t* data, size_t length) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t n = std::min(length, data_.size());
+	::memcpy(data, data_.data(), n);
+	return n;
+}
+
 can_message_definition_t::can_message_definition_t(const std::string bus)
-	: parent_{nullptr}, bus_{bus}, last_value_{CAN_MESSAGE_SIZE}
+	: parent_{nullptr}, bus_{bus}, is_fd_{false}, bit_rate_switch_{false}, last_value_(CAN_MESSAGE_SIZE)
 {}
 
 can_message_definition_t::can_message_definition_t(
@@ -31,9 +71,11 @@ can_message_definition_t::can_message_definition_t(
 	: parent_{nullptr},
 	  bus_{bus},
 	  id_{id},
+	  is_fd_{false},
+	  bit_rate_switch_{false},
 	  frequency_clock_{frequency_clock},
 	  force_send_changed_{force_send_changed},
-	  last_value_{CAN_MESSAGE_SIZE}
+	  last_value_(CAN_MESSAGE_SIZE)
 {}
 
 can_message_definition_t::can_message_definition_t(
@@ -46,15 +88,33 @@ can_message_definition_t::can_message_definition_t(
 	bus_{bus},
 	id_{id},
 	format_{format},
+	is_fd_{false},
+	bit_rate_switch_{false},
 	frequency_clock_{frequency_clock},
 	force_send_changed_{force_send_changed},
-	last_value_{CAN_MESSAGE_SIZE}
+	last_value_(CAN_MESSAGE_SIZE)
+{}
+
+can_message_definition_t::can_message_definition_t(
+	const std::string bus,
+	uint32_t id,
+	can_message_format_t format,
+	frequency_clock_t frequency_clock,
+	bool force_send_changed,
+	const std::vector<std::shared_ptr<can_signal_t> >& can_signals)
+	: can_message_definition_t{bus, id, format, false, false, frequency_clock, force_send_changed, can_signals}
 {}
 
+/// @brief Constructor of a CAN FD capable message definition.
+///
+/// @param[in] is_fd - true if the message is a CAN FD frame, signals can then be laid out on 64 bytes.
+/// @param[in] bit_rate_switch - true to write the CAN FD frame with its data phase at the higher bit rate.
 can_message_definition_t::can_message_definition_t(
 	const std::string bus,
 	uint32_t id,
 	can_message_format_t format,
+	bool is_fd,
+	bool bit_rate_switch,
 	frequency_clock_t frequency_clock,
 	bool force_send_changed,
 	const std::vector<std::shared_ptr<can_signal_t> >& can_signals)
@@ -62,11 +122,19 @@ can_message_definition_t::can_message_definition_t(
 	bus_{bus},
 	id_{id},
 	format_{format},
+	is_fd_{is_fd},
+	bit_rate_switch_{is_fd && bit_rate_switch},
 	frequency_clock_{frequency_clock},
 	force_send_changed_{force_send_changed},
-	last_value_{CAN_MESSAGE_SIZE},
+	last_value_(is_fd ? CAN_MESSAGE_FD_SIZE : CAN_MESSAGE_SIZE),
 	can_signals_{can_signals}
-{}
+{
+	for(const auto& sig: can_signals_)
+	{
+		if(! decode_plan_.add(sig.get(), sig->get_bit_position(), sig->get_bit_size(), sig->get_factor(), sig->get_offset()))
+			break;
+	}
+}
 
 const std::string can_message_definition_t::get_bus_name() const
 {
@@ -84,17 +152,62 @@ uint32_t can_message_definition_t::get_id() const
 	return id_;
 }
 
+bool can_message_definition_t::is_fd() const
+{
+	return is_fd_;
+}
+
+bool can_message_definition_t::get_bit_rate_switch() const
+{
+	return bit_rate_switch_;
+}
+
+/// @brief Get the payload size the signals of the message are laid out on.
+///
+/// @return CAN_MESSAGE_FD_SIZE for a CAN FD message, else CAN_MESSAGE_SIZE.
+uint8_t can_message_definition_t::get_length() const
+{
+	return is_fd_ ? CAN_MESSAGE_FD_SIZE : CAN_MESSAGE_SIZE;
+}
+
 std::vector<std::shared_ptr<can_signal_t> >& can_message_definition_t::get_can_signals()
 {
 	return can_signals_;
 }
 
+const decode_plan_t& can_message_definition_t::get_decode_plan() const
+{
+	return decode_plan_;
+}
+
 void can_message_definition_t::set_parent(can_message_set_t* parent)
 {
 	parent_= parent;
 }
 
+/// @brief Copy the last payload of the message, received or written. It is
+/// zeroed until a frame has been seen.
+///
+/// @param[out] data - buffer receiving the payload.
+/// @param[in] length - size of data.
+///
+/// @return number of bytes copied, at most get_length().
+size_t can_message_definition_t::get_last_value(uint8_t* data, size_t length) const
+{
+	return last_value_.get(data, length);
+}
+
 void can_message_definition_t::set_last_value(const can_message_t& cm)
 {
-	last_value_= cm.get_data_vector();
+	set_last_value(cm.get_data(), cm.get_maxdlen());
+}
+
+/// @brief Record the last payload of the message, truncated or zero padded
+/// to the message length.
+///
+/// @param[in] data - payload bytes.
+/// @param[in] length - number of bytes of data.
+void can_message_definition_t::set_last_value(const uint8_t* data, size_t length)
+{
+	last_value_.set(data, length);
 }
\ No newline at end of file
@@ -27,14 +27,33 @@
 
 #include <vector>
 #include <memory>
+#include <mutex>
 
 #include "can-signals.hpp"
 #include "can-message.hpp"
 #include "can-message-set.hpp"
+#include "can-decode-plan.hpp"
 #include "../utils/timer.hpp"
 
 class can_message_set_t;
 
+/// @brief Last payload of a message. Decoder threads record received frames
+///  in it while writers build frames over it, accesses are serialized. A copy
+///  gets its own mutex.
+class last_payload_t
+{
+private:
+	mutable std::mutex mutex_; ///< mutex_ - serializes accesses to data_.
+	std::vector<uint8_t> data_; ///< data_ - payload, sized at construction then only overwritten.
+
+public:
+	explicit last_payload_t(size_t size);
+	last_payload_t(const last_payload_t& other);
+
+	void set(const uint8_t* data, size_t length);
+	size_t get(uint8_t* data, size_t length) const;
+};
+
 /// @brief The definition of a CAN message. This includes a lot of metadata, so
 ///  to save memory this class gets the can_signal_t object related to a CAN message.
 class can_message_definition_t
@@ -44,15 +63,19 @@ private:
 	std::string bus_; ///< bus_ - Address of CAN bus device. */
 	uint32_t id_; ///< id_ - The ID of the message.*/
 	can_message_format_t format_; ///< format_ - the format of the message's ID.*/
+	bool is_fd_; ///< is_fd_ - True if the message is a CAN FD frame, its signals are then laid out on 64 bytes.*/
+	bool bit_rate_switch_; ///< bit_rate_switch_ - True if the CAN FD frame is written with its data phase at the higher bit rate (BRS).*/
 	frequency_clock_t frequency_clock_; ///<  clock_ - an optional frequency clock to control the output of this
 							///      message, if sent raw, or simply to mark the max frequency for custom
 							///      handlers to retrieve.*/
 	bool force_send_changed_; ///< force_send_changed_ - If true, regardless of the frequency, it will send CAN
 							///	message if it has changed when using raw passthrough.*/
-	std::vector<uint8_t> last_value_; ///< last_value_ - The last received value of the message. Defaults to undefined.
+	last_payload_t last_value_; ///< last_value_ - The last received value of the message. Defaults to undefined.
 										///	This is required for the forceSendChanged functionality, as the stack
-										///	needs to compare an incoming CAN message with the previous frame.*/
+										///	needs to compare an incoming CAN message with the previous frame.
+										///	Sized at construction to the message length, then only overwritten.*/
 	std::vector<std::shared_ptr<can_signal_t> > can_signals_; ///< can_signals_ - Vector holding can_signal_t object which share the same arbitration ID */
+	decode_plan_t decode_plan_; ///< decode_plan_ - can_signals_ extraction compiled at construction.
 
 public:
 	//can_message_definition_t(const can_message_definition_t& b);
@@ -60,12 +83,19 @@ public:
 	can_message_definition_t(const std::string bus, uint32_t id, frequency_clock_t frequency_clock, bool force_send_changed);
 	can_message_definition_t(const std::string bus, uint32_t id, can_message_format_t format, frequency_clock_t frequency_clock, bool force_send_changed);
 	can_message_definition_t(const std::string bus, uint32_t id, can_message_format_t format, frequency_clock_t frequency_clock, bool force_send_changed, const std::vector<std::shared_ptr<can_signal_t> >& can_signals);
+	can_message_definition_t(const std::string bus, uint32_t id, can_message_format_t format, bool is_fd, bool bit_rate_switch, frequency_clock_t frequency_clock, bool force_send_changed, const std::vector<std::shared_ptr<can_signal_t> >& can_signals);
 
 	const std::string get_bus_name() const;
 	const std::string get_bus_device_name() const;
 	uint32_t get_id() const;
+	bool is_fd() const;
+	bool get_bit_rate_switch() const;
+	uint8_t get_length() const;
 	std::vector<std::shared_ptr<can_signal_t> >& get_can_signals();
+	const decode_plan_t& get_decode_plan() const;
+	size_t get_last_value(uint8_t* data, size_t length) const;
 
 	void set_parent(can_message_set_t* parent);
 	void set_last_value(const can_message_t& cm);
+	void set_last_value(const uint8_t* data, size_t length);
 };
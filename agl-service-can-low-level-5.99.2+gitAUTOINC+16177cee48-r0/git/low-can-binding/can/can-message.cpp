@@ -34,8 +34,11 @@ can_message_t::can_message_t()
 	 rtr_flag_{false},
 	 flags_{0},
 	 timestamp_{0},
-	 sub_id_{-1}
-{}
+	 sub_id_{-1},
+	 ifindex_{0}
+{
+	::memset(data_, 0, sizeof(data_));
+}
 
 can_message_t::can_message_t(uint8_t maxdlen,
 	uint32_t id,
@@ -43,7 +46,7 @@ can_message_t::can_message_t(uint8_t maxdlen,
 	can_message_format_t format,
 	bool rtr_flag,
 	uint8_t flags,
-	std::vector<uint8_t>& data,
+	const uint8_t* data,
 	uint64_t timestamp)
 	:  maxdlen_{maxdlen},
 	id_{id},
@@ -51,10 +54,15 @@ can_message_t::can_message_t(uint8_t maxdlen,
 	format_{format},
 	rtr_flag_{rtr_flag},
 	flags_{flags},
-	data_{data},
 	timestamp_{timestamp},
-	sub_id_{-1}
-{}
+	sub_id_{-1},
+	ifindex_{0}
+{
+	if(maxdlen_ > sizeof(data_))
+		maxdlen_ = sizeof(data_);
+	::memcpy(data_, data, maxdlen_);
+	::memset(data_ + maxdlen_, 0, sizeof(data_) - maxdlen_);
+}
 
 ///
 /// @brief Retrieve id_ member value.
@@ -111,17 +119,18 @@ uint8_t can_message_t::get_flags() const
 ///
 const uint8_t* can_message_t::get_data() const
 {
-	return data_.data();
+	return data_;
 }
 
 ///
-/// @brief Retrieve data_ member whole vector
+/// @brief Retrieve data_ member as a vector. It allocates,
+/// prefer get_data on hot paths.
 ///
-/// @return the vector as is
+/// @return a vector of the maxdlen_ meaningful bytes
 ///
 const std::vector<uint8_t> can_message_t::get_data_vector() const
 {
-	return data_;
+	return std::vector<uint8_t>(data_, data_ + maxdlen_);
 }
 
 ///
@@ -134,6 +143,17 @@ uint8_t can_message_t::get_length() const
 	return length_;
 }
 
+///
+/// @brief Retrieve maxdlen_ member value, the size of the payload
+/// signals are extracted from.
+///
+/// @return CAN_MESSAGE_SIZE for a CAN frame, CAN_MESSAGE_FD_SIZE for a CAN FD frame.
+///
+uint8_t can_message_t::get_maxdlen() const
+{
+	return maxdlen_;
+}
+
 void can_message_t::set_sub_id(int sub_id)
 {
 	sub_id_ = sub_id;
@@ -149,6 +169,16 @@ void can_message_t::set_timestamp(uint64_t timestamp)
 	timestamp_ = timestamp;
 }
 
+int can_message_t::get_ifindex() const
+{
+	return ifindex_;
+}
+
+void can_message_t::set_ifindex(int ifindex)
+{
+	ifindex_ = ifindex;
+}
+
 /// @brief Control whether the object is correctly initialized
 ///  to be sent over the CAN bus
 ///
@@ -158,7 +188,7 @@ bool can_message_t::is_correct_to_send()
 	if (id_ != 0 && length_ != 0 && format_ != can_message_format_t::INVALID)
 	{
 		int i;
-		for(i=0;i<CAN_MESSAGE_SIZE;i++)
+		for(i=0;i<length_;i++)
 			if(data_[i] != 0)
 				return true;
 	}
@@ -192,17 +222,14 @@ can_message_t can_message_t::convert_from_frame(const struct canfd_frame& frame,
 	uint8_t maxdlen = 0, length = 0, flags = 0;
 	uint32_t id;
 	can_message_format_t format;
-	bool rtr_flag;
-	std::vector<uint8_t> data;
+	bool rtr_flag = false;
 
 	switch(nbytes)
 	{
 		case CANFD_MTU:
-			AFB_DEBUG("Got an CAN FD frame");
 			maxdlen = CANFD_MAX_DLEN;
 			break;
 		case CAN_MTU:
-			AFB_DEBUG("Got a legacy CAN frame");
 			maxdlen = CAN_MAX_DLEN;
 			break;
 		default:
@@ -248,23 +275,10 @@ can_message_t can_message_t::convert_from_frame(const struct canfd_frame& frame,
 		/* Flags field only present for CAN FD frames*/
 		if(maxdlen == CANFD_MAX_DLEN)
 				flags = frame.flags & 0xF;
-
-		if (data.capacity() < maxdlen)
-			data.reserve(maxdlen);
-				int i;
-
-			data.clear();
-			/* maxdlen_ is now set at CAN_MAX_DLEN or CANFD_MAX_DLEN, respectively 8 and 64 bytes*/
-			for(i=0;i<maxdlen;i++)
-			{
-				data.push_back(frame.data[i]);
-			};
-
-		AFB_DEBUG("Found id: %X, format: %X, length: %X, data %02X%02X%02X%02X%02X%02X%02X%02X",
-								id, (uint8_t)format, length, data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7]);
 	}
 
-	return can_message_t(maxdlen, id, length, format, rtr_flag, flags, data, timestamp);
+	/* maxdlen is set at CAN_MAX_DLEN or CANFD_MAX_DLEN, respectively 8 and 64 bytes*/
+	return can_message_t(maxdlen, id, length, format, rtr_flag, flags, frame.data, timestamp);
 }
 
 /// @brief Take a can_frame struct to initialize class members
@@ -280,8 +294,7 @@ can_message_t can_message_t::convert_from_frame(const struct can_frame& frame, s
 	uint8_t maxdlen = 0, length = 0, flags = 0;
 	uint32_t id;
 	can_message_format_t format;
-	bool rtr_flag;
-	std::vector<uint8_t> data;
+	bool rtr_flag = false;
 
 	if(nbytes <= CAN_MTU)
 	{
@@ -328,22 +341,12 @@ can_message_t can_message_t::convert_from_frame(const struct can_frame& frame, s
 	{
 		length = (frame.can_dlc > maxdlen) ? maxdlen : frame.can_dlc;
 
-		if (data.capacity() < maxdlen)
-			data.reserve(maxdlen);
-				int i;
-
-			data.clear();
-			/* maxdlen_ is now set at CAN_MAX_DLEN or CANFD_MAX_DLEN, respectively 8 and 64 bytes*/
-			for(i=0;i<maxdlen;i++)
-			{
-				data.push_back(frame.data[i]);
-			};
-
 //		AFB_DEBUG("Found id: %X, format: %X, length: %X, data %02X%02X%02X%02X%02X%02X%02X%02X",
-//								id, (uint8_t)format, length, data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7]);
+//								id, (uint8_t)format, length, frame.data[0], frame.data[1], frame.data[2], frame.data[3], frame.data[4], frame.data[5], frame.data[6], frame.data[7]);
 	}
 
-	return can_message_t(maxdlen, id, length, format, rtr_flag, flags, data, timestamp);
+	/* maxdlen is set at CAN_MAX_DLEN, 8 bytes*/
+	return can_message_t(maxdlen, id, length, format, rtr_flag, flags, frame.data, timestamp);
 }
 
 /// @brief Take all initialized class members and build a
@@ -354,11 +357,13 @@ can_message_t can_message_t::convert_from_frame(const struct can_frame& frame, s
 struct canfd_frame can_message_t::convert_to_canfd_frame()
 {
 	canfd_frame frame;
+	::memset(&frame, 0, sizeof(frame));
 
 	if(is_correct_to_send())
 	{
 		frame.can_id = get_id();
 		frame.len = get_length();
+		frame.flags = get_flags();
 		::memcpy(frame.data, get_data(), length_);
 	}
 	else
@@ -20,11 +20,13 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <type_traits>
 #include <linux/can.h>
 
 #include "../utils/timer.hpp"
 
 #define CAN_MESSAGE_SIZE 8
+#define CAN_MESSAGE_FD_SIZE 64
 
 /**
  * @enum can_message_format_t
@@ -40,21 +42,25 @@ enum class can_message_format_t {
 ///
 /// @brief A compact representation of a single CAN message, meant to be used in in/out
 /// buffers. It is a wrapper of a can_frame struct with some sugar around it for binding purposes.
+///
+/// Data are stored inline, sized for a CAN FD frame, so that the object is trivially
+/// copyable and never allocates: it can be stored by value in preallocated rings and arrays.
 class can_message_t {
 private:
 	uint8_t maxdlen_; ///< maxdlen_ - Max data length deduce from number of bytes read from the socket.*/
 	uint32_t id_; ///< id_ - The ID of the message. */
-	uint8_t length_; ///< length_ - the length of the data array (max 8). */
+	uint8_t length_; ///< length_ - the length of the data array (max 8, 64 for a CAN FD frame). */
 	can_message_format_t format_; ///< format_ - the format of the message's ID.*/
 	bool rtr_flag_; ///< rtr_flag_ - Telling if the frame has RTR flag positionned. Then frame hasn't data field*/
 	uint8_t flags_; ///< flags_ - flags of a CAN FD frame. Needed if we catch FD frames.*/
-	std::vector<uint8_t> data_; ///< data_ - The message's data field with a size of 8 which is the standard about CAN bus messages.*/
+	uint8_t data_[CANFD_MAX_DLEN]; ///< data_ - The message's data field, maxdlen_ bytes are meaningful: 8 for a CAN frame, 64 for a CAN FD frame.*/
 	uint64_t timestamp_; ///< timestamp_ - timestamp of the received message*/
 	int sub_id_; ///< sub_id_ - Subscription index. */
+	int ifindex_; ///< ifindex_ - Kernel interface index of the CAN device the message has been read on, 0 if unknown. */
 
 public:
 	can_message_t();
-	can_message_t(uint8_t maxdlen, uint32_t id, uint8_t length, can_message_format_t format, bool rtr_flag_, uint8_t flags, std::vector<uint8_t>& data, uint64_t timestamp);
+	can_message_t(uint8_t maxdlen, uint32_t id, uint8_t length, can_message_format_t format, bool rtr_flag_, uint8_t flags, const uint8_t* data, uint64_t timestamp);
 
 	uint32_t get_id() const;
 	int get_sub_id() const;
@@ -64,9 +70,12 @@ public:
 	const uint8_t* get_data() const;
 	const std::vector<uint8_t> get_data_vector() const;
 	uint8_t get_length() const;
+	uint8_t get_maxdlen() const;
 	uint64_t get_timestamp() const;
+	int get_ifindex() const;
 
 	void set_sub_id(int sub_id);
+	void set_ifindex(int ifindex);
 	void set_timestamp(uint64_t timestamp);
 	void set_format(const can_message_format_t new_format);
 
@@ -78,3 +87,5 @@ public:
 	struct canfd_frame convert_to_canfd_frame();
 	struct can_frame convert_to_can_frame();
 };
+
+static_assert(std::is_trivially_copyable<can_message_t>::value, "can_message_t must stay trivially copyable to be used in preallocated buffers");
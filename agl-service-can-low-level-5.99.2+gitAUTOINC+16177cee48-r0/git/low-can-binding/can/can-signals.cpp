@@ -16,6 +16,7 @@
  */
 
 #include <fnmatch.h>
+#include <algorithm>
 
 #include "can-signals.hpp"
 
@@ -30,8 +31,8 @@
 std::string can_signal_t::prefix_ = "messages";
 
 can_signal_t::can_signal_t(
-	std::string generic_name,
-	uint8_t bit_position,
+	const char* generic_name,
+	uint16_t bit_position,
 	uint8_t bit_size,
 	float factor,
 	float offset,
@@ -40,7 +41,7 @@ can_signal_t::can_signal_t(
 	frequency_clock_t frequency,
 	bool send_same,
 	bool force_send_changed,
-	std::map<uint8_t, std::string> states,
+	std::vector<can_signal_state_t> states,
 	bool writable,
 	signal_decoder decoder,
 	signal_encoder encoder,
@@ -62,7 +63,10 @@ can_signal_t::can_signal_t(
 	, encoder_{encoder}
 	, received_{received}
 	, last_value_{.0f}
-{}
+{
+	std::sort(states_.begin(), states_.end(), [](const can_signal_state_t& a, const can_signal_state_t& b)
+		{return a.value < b.value;});
+}
 
 can_message_definition_t* can_signal_t::get_message() const
 {
@@ -84,7 +88,7 @@ const std::string can_signal_t::get_prefix() const
 	return prefix_;
 }
 
-uint8_t can_signal_t::get_bit_position() const
+uint16_t can_signal_t::get_bit_position() const
 {
 	return bit_position_;
 }
@@ -129,15 +133,17 @@ bool can_signal_t::get_force_send_changed() const
 	return force_send_changed_;
 }
 
-const std::map<uint8_t, std::string>& can_signal_t::get_states() const
+const std::vector<can_signal_state_t>& can_signal_t::get_states() const
 {
 	return states_;
 }
 
 const std::string can_signal_t::get_states(uint8_t value)
 {
-	if (value < states_.size())
-		return states_[value];
+	auto it = std::lower_bound(states_.begin(), states_.end(), value, [](const can_signal_state_t& state, uint8_t v)
+		{return state.value < v;});
+	if (it != states_.end() && it->value == value)
+		return it->name;
 	return std::string();
 }
 
@@ -146,9 +152,9 @@ uint64_t can_signal_t::get_states(const std::string& value) const
 	uint64_t ret = -1;
 	for( const auto& state: states_)
 	{
-		if(state.second == value)
+		if(value == state.name)
 		{
-			ret = (uint64_t)state.first;
+			ret = (uint64_t)state.value;
 			break;
 		}
 	}
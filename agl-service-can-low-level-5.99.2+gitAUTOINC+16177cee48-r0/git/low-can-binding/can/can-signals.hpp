@@ -64,16 +64,25 @@ typedef openxc_DynamicField (*signal_decoder)(can_signal_t& signal, float value,
 typedef uint64_t (*signal_encoder)(can_signal_t* signal,
 		openxc_DynamicField* value, bool* send);
 
+/// @brief A valid state of a CAN signal, mapping its numerical value to a
+/// string. The name isn't owned, it points to a string literal of the generated
+/// code or into the mapped signals database.
+struct can_signal_state_t
+{
+	uint8_t value;
+	const char* name;
+};
+
 class can_signal_t
 {
 private:
 	can_message_definition_t* parent_; /*!< parent_ - pointer to the parent message definition holding this signal*/
-	std::string generic_name_; /*!< generic_name_ - The name of the signal to be output.*/
+	const char* generic_name_; /*!< generic_name_ - The name of the signal to be output, not owned as states names.*/
 	static std::string prefix_; /*!< prefix_ - generic_name_ will be prefixed with it. It has to reflect the used protocol.
 						  * which make easier to sort message when the come in.*/
-	uint8_t bit_position_; /*!< bitPosition_ - The starting bit of the signal in its CAN message (assuming
+	uint16_t bit_position_; /*!< bitPosition_ - The starting bit of the signal in its CAN message (assuming
 										*	non-inverted bit numbering, i.e. the most significant bit of
-										*	each byte is 0) */
+										*	each byte is 0), up to 511 in a CAN FD message */
 	uint8_t bit_size_; /*!< bit_size_ - The width of the bit field in the CAN message. */
 	float factor_; /*!< factor_ - The final value will be multiplied by this factor. Use 1 if you
 							*	don't need a factor. */
@@ -87,7 +96,7 @@ private:
 	bool send_same_; /*!< send_same_ - If true, will re-send even if the value hasn't changed.*/
 	bool force_send_changed_; /*!< force_send_changed_ - If true, regardless of the frequency, it will send the
 							   * value if it has changed. */
-	std::map<uint8_t, std::string> states_; /*!< states_ - A map of CAN signal state describing the mapping
+	std::vector<can_signal_state_t> states_; /*!< states_ - CAN signal states sorted by value, describing the mapping
 										 * between numerical and string values for valid states. */
 	bool writable_; /*!< writable - True if the signal is allowed to be written from the USB host
 					 *	back to CAN. Defaults to false.*/
@@ -102,8 +111,8 @@ private:
 
 public:
 	can_signal_t(
-		std::string generic_name,
-		uint8_t bit_position,
+		const char* generic_name,
+		uint16_t bit_position,
 		uint8_t bit_size,
 		float factor,
 		float offset,
@@ -112,7 +121,7 @@ public:
 		frequency_clock_t frequency,
 		bool send_same,
 		bool force_send_changed,
-		std::map<uint8_t, std::string> states,
+		std::vector<can_signal_state_t> states,
 		bool writable,
 		signal_decoder decoder,
 		signal_encoder encoder,
@@ -122,7 +131,7 @@ public:
 	const std::string get_generic_name() const;
 	const std::string get_name() const;
 	const std::string get_prefix() const;
-	uint8_t get_bit_position() const;
+	uint16_t get_bit_position() const;
 	uint8_t get_bit_size() const;
 	float get_factor() const;
 	float get_offset() const;
@@ -131,7 +140,7 @@ public:
 	frequency_clock_t& get_frequency();
 	bool get_send_same() const;
 	bool get_force_send_changed() const;
-	const std::map<uint8_t, std::string>& get_states() const;
+	const std::vector<can_signal_state_t>& get_states() const;
 	const std::string get_states(uint8_t value);
 	uint64_t get_states(const std::string& value) const;
 	size_t get_state_count() const;
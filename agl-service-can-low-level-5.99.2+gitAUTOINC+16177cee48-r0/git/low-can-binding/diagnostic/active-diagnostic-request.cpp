@@ -47,6 +47,9 @@ active_diagnostic_request_t& active_diagnostic_request_t::operator=(const active
 		frequency_clock_ = adr.frequency_clock_;
 		timeout_clock_ = adr.timeout_clock_;
 		socket_ = adr.socket_;
+		state_ = adr.state_;
+		sequence_ = adr.sequence_;
+		deadline_ = adr.deadline_;
 	}
 
 	return *this;
@@ -64,7 +67,10 @@ active_diagnostic_request_t::active_diagnostic_request_t()
 	  wait_for_multiple_responses_{false},
 	  frequency_clock_{frequency_clock_t()},
 	  timeout_clock_{frequency_clock_t()},
-	  socket_{}
+	  socket_{},
+	  state_{diagnostic_request_state_t::IDLE},
+	  sequence_{0},
+	  deadline_{0}
 {}
 
 active_diagnostic_request_t::active_diagnostic_request_t(const std::string& bus, uint32_t id,
@@ -85,7 +91,10 @@ active_diagnostic_request_t::active_diagnostic_request_t(const std::string& bus,
 	  wait_for_multiple_responses_{wait_for_multiple_responses},
 	  frequency_clock_{frequency_clock_t(frequencyHz)},
 	  timeout_clock_{frequency_clock_t(10)},
-	  socket_{}
+	  socket_{},
+	  state_{diagnostic_request_state_t::IDLE},
+	  sequence_{0},
+	  deadline_{0}
 {}
 
 active_diagnostic_request_t::~active_diagnostic_request_t()
@@ -157,6 +166,39 @@ utils::socketcan_bcm_t& active_diagnostic_request_t::get_socket()
 	return socket_;
 }
 
+diagnostic_request_state_t active_diagnostic_request_t::get_state() const
+{
+	return state_;
+}
+
+uint32_t active_diagnostic_request_t::get_sequence() const
+{
+	return sequence_;
+}
+
+uint64_t active_diagnostic_request_t::get_deadline() const
+{
+	return deadline_;
+}
+
+void active_diagnostic_request_t::set_state(diagnostic_request_state_t state)
+{
+	state_ = state;
+}
+
+/// @brief Start a new send of the request.
+///
+/// @return the sequence number of this send.
+uint32_t active_diagnostic_request_t::next_sequence()
+{
+	return ++sequence_;
+}
+
+void active_diagnostic_request_t::set_deadline(uint64_t deadline)
+{
+	deadline_ = deadline;
+}
+
 void active_diagnostic_request_t::set_handle(DiagnosticShims& shims, DiagnosticRequest* request)
 {
 	handle_ = new DiagnosticRequestHandle(generate_diagnostic_request(&shims, request, nullptr));
@@ -28,6 +28,13 @@
 class active_diagnostic_request_t;
 class diagnostic_manager_t;
 
+/// @brief Where a request is in its polling cycle, set by the diagnostic manager.
+enum class diagnostic_request_state_t {
+	IDLE, ///< IDLE - Waiting for its next poll.
+	QUEUED, ///< QUEUED - Due, waiting for a free in-flight slot of its ECU.
+	IN_FLIGHT ///< IN_FLIGHT - Sent, waiting for its response or its timeout.
+};
+
 /// @brief The signature for an optional function that can apply the neccessary
 /// formula to translate the binary payload into meaningful data.
 ///
@@ -85,6 +92,9 @@ private:
 	frequency_clock_t timeout_clock_; ///< timeout_clock_ - A frequency_clock_t object to monitor how long it's been since
 									  ///< this request was sent.
 	utils::socketcan_bcm_t socket_; ///< socket_ - A BCM socket setup to send cyclic message to CAN ID 7DF.
+	diagnostic_request_state_t state_; ///< state_ - Polling state, protected by the diagnostic manager mutex.
+	uint32_t sequence_; ///< sequence_ - Incremented at each send, to tell the timeout of the current send from older ones.
+	uint64_t deadline_; ///< deadline_ - Time of the next poll of a recurring request, in microseconds.
 public:
 	bool operator==(const active_diagnostic_request_t& b);
 	active_diagnostic_request_t& operator=(const active_diagnostic_request_t& adr);
@@ -109,6 +119,13 @@ public:
 	frequency_clock_t& get_frequency_clock();
 	frequency_clock_t& get_timeout_clock();
 	utils::socketcan_bcm_t& get_socket();
+	diagnostic_request_state_t get_state() const;
+	uint32_t get_sequence() const;
+	uint64_t get_deadline() const;
+
+	void set_state(diagnostic_request_state_t state);
+	uint32_t next_sequence();
+	void set_deadline(uint64_t deadline);
 
 	void set_handle(DiagnosticShims& shims, DiagnosticRequest* request);
 
@@ -18,6 +18,9 @@
 #include <systemd/sd-event.h>
 #include <algorithm>
 #include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/time.h>
 
 #include "diagnostic-manager.hpp"
 
@@ -26,19 +29,31 @@
 #include "../binding/application.hpp"
 
 #define MAX_RECURRING_DIAGNOSTIC_FREQUENCY_HZ 10
-#define MAX_SIMULTANEOUS_DIAG_REQUESTS 50
+#define MAX_SIMULTANEOUS_DIAG_REQUESTS 256
 // There are only 8 slots of in flight diagnostic requests
 #define MAX_SIMULTANEOUS_IN_FLIGHT_REQUESTS 8
-#define TIMERFD_ACCURACY 0
+// Most ECUs answer one request at a time, more can be configured.
+#define DEFAULT_IN_FLIGHT_REQUESTS 1
+#define DIAGNOSTIC_WHEEL_TICK_US 1000
+#define DIAGNOSTIC_TIMER_ACCURACY_US 1000
+#define DIAGNOSTIC_RESPONSE_MODE_OFFSET 0x40
+#define DIAGNOSTIC_NEGATIVE_RESPONSE_MODE 0x7f
 #define MICRO 1000000
 
 diagnostic_manager_t::diagnostic_manager_t()
-	: initialized_{false}
+	: initialized_{false},
+	send_failed_{false},
+	timer_{nullptr},
+	in_flight_max_{DEFAULT_IN_FLIGHT_REQUESTS},
+	pdu_q_{DIAGNOSTIC_PDU_QUEUE_SIZE}
 {}
 
 
 diagnostic_manager_t::~diagnostic_manager_t()
 {
+	if(timer_)
+		{sd_event_source_unref(timer_);}
+	close_isotp_channels();
 	for(auto r: recurring_requests_)
 	{
 		delete(r);
@@ -54,21 +69,144 @@ diagnostic_manager_t::~diagnostic_manager_t()
 ///  to have 1 diagnostic bus which are the first bus declared in the JSON
 ///  description file. Configuration instance will return it.
 ///
-/// this will initialize DiagnosticShims and cancel all active requests
-///  if there are any.
+/// this will initialize DiagnosticShims, cancel all active requests
+///  if there are any and create the timer polling recurring requests.
 bool diagnostic_manager_t::initialize()
 {
 	// Mandatory to set the bus before intialize shims.
 	bus_ = application_t::instance().get_diagnostic_bus();
 
+	std::string in_flight = application_t::instance().get_can_bus_manager().get_conf_file().get_option("diagnostic-in-flight");
+	if(! in_flight.empty())
+	{
+		int count = (int)::strtol(in_flight.c_str(), nullptr, 0);
+		if(count < 1 || count > MAX_SIMULTANEOUS_IN_FLIGHT_REQUESTS)
+			{AFB_WARNING("diagnostic-in-flight must be between 1 and %d, %s ignored", MAX_SIMULTANEOUS_IN_FLIGHT_REQUESTS, in_flight.c_str());}
+		else
+			{in_flight_max_ = count;}
+	}
+
 	init_diagnostic_shims();
 	reset();
 
+	if(application_t::instance().get_can_bus_manager().get_conf_file().get_option("diagnostic-isotp") == "kernel" &&
+	   isotp_channels_.empty() && open_isotp_channels() < 0)
+		{AFB_WARNING("Kernel ISO-TP isn't available, diagnostic responses are reassembled by isotp-c");}
+
+	// Armed when requests are scheduled.
+	if(! timer_ && sd_event_add_time(afb_daemon_get_event_loop(), &timer_, CLOCK_MONOTONIC, UINT64_MAX,
+		DIAGNOSTIC_TIMER_ACCURACY_US, on_timer, this) < 0)
+	{
+		AFB_ERROR("Can't create the diagnostic requests timer");
+		timer_ = nullptr;
+		return false;
+	}
+	sd_event_source_set_enabled(timer_, SD_EVENT_OFF);
+
 	initialized_ = true;
 	AFB_DEBUG("Diagnostic Manager initialized");
 	return initialized_;
 }
 
+/// @brief Open a kernel ISO-TP socket for each OBD-II ECU, 0x7E0 to 0x7E7
+/// answering from 0x7E8 to 0x7EF, and read them from the event loop. Requests
+/// to these ECUs are then sent on their socket, functional broadcast requests
+/// are still sent as a single frame by isotp-c and answered on these sockets.
+///
+/// @return 0 if all sockets are opened, -1 otherwise and none is kept.
+int diagnostic_manager_t::open_isotp_channels()
+{
+	std::string device = get_bus_device_name();
+	for(uint32_t id = 0x7e0; id <= 0x7e7; id++)
+	{
+		std::unique_ptr<diagnostic_isotp_channel_t> channel(new diagnostic_isotp_channel_t(id, id + DIAGNOSTIC_RESPONSE_ARBITRATION_ID_OFFSET));
+		if(channel->socket.open(device) < 0 ||
+		   sd_event_add_io(afb_daemon_get_event_loop(), &channel->source, channel->socket.socket(), EPOLLIN, on_isotp_readable, &channel->socket) < 0)
+		{
+			channel->source = nullptr;
+			close_isotp_channels();
+			return -1;
+		}
+		isotp_channels_[id] = std::move(channel);
+	}
+	AFB_NOTICE("Diagnostic responses on %s are reassembled by kernel ISO-TP sockets", device.c_str());
+	return 0;
+}
+
+void diagnostic_manager_t::close_isotp_channels()
+{
+	for(auto& channel : isotp_channels_)
+	{
+		if(channel.second->source)
+			{sd_event_source_unref(channel.second->source);}
+	}
+	isotp_channels_.clear();
+}
+
+/// @brief Tell if the responses to a request are read on kernel ISO-TP sockets.
+bool diagnostic_manager_t::uses_kernel_isotp(active_diagnostic_request_t* entry) const
+{
+	return entry->get_id() == OBD2_FUNCTIONAL_BROADCAST_ID ?
+		! isotp_channels_.empty() :
+		isotp_channels_.count(entry->get_id()) > 0;
+}
+
+/// @brief Event loop callback reading the complete responses of an ISO-TP
+/// socket and handing them to the first decoding thread.
+int diagnostic_manager_t::on_isotp_readable(sd_event_source* s, int fd, uint32_t revents, void* userdata)
+{
+	utils::socketcan_isotp_t* socket = (utils::socketcan_isotp_t*)userdata;
+	diagnostic_manager_t& dm = application_t::instance().get_diagnostic_manager();
+	uint8_t buffer[MAX_ISO_TP_MESSAGE_SIZE];
+	bool received = false;
+
+	ssize_t nbytes;
+	while((nbytes = socket->read_pdu(buffer, sizeof(buffer))) > 0)
+	{
+		diagnostic_pdu_t pdu;
+		struct timeval tv;
+		::gettimeofday(&tv, nullptr);
+		pdu.id = socket->get_rx_id();
+		pdu.timestamp = 1000000 * (uint64_t)tv.tv_sec + tv.tv_usec;
+		pdu.size = std::min<size_t>(nbytes, DIAGNOSTIC_PDU_MAX_LENGTH);
+		::memcpy(pdu.data, buffer, pdu.size);
+		if(! dm.pdu_q_.push(pdu))
+			{AFB_DEBUG("Diagnostic response queue full, response from %X dropped", pdu.id);}
+		received = true;
+	}
+
+	// The decoder may be going to sleep on its CAN messages queue, wake it up anyway.
+	if(received)
+		{application_t::instance().get_can_bus_manager().wake_diagnostic_decoder();}
+	return 0;
+}
+
+/// @brief Send a request on the ISO-TP socket of its ECU, the kernel segments it.
+/// Called with the requests mutex held.
+///
+/// @return false if it couldn't be sent.
+bool diagnostic_manager_t::send_isotp_request(active_diagnostic_request_t* entry)
+{
+	DiagnosticRequestHandle* handle = entry->get_handle();
+	const DiagnosticRequest& request = handle->request;
+	uint8_t pdu[1 + sizeof(uint16_t) + MAX_UDS_REQUEST_PAYLOAD_LENGTH];
+	size_t size = 0;
+
+	pdu[size++] = request.mode;
+	if(request.has_pid)
+	{
+		if(pid_length(request) == 2)
+			{pdu[size++] = request.pid >> 8;}
+		pdu[size++] = request.pid & 0xff;
+	}
+	::memcpy(pdu + size, request.payload, request.payload_length);
+	size += request.payload_length;
+
+	handle->completed = false;
+	handle->success = false;
+	return isotp_channels_[entry->get_id()]->socket.write_pdu(pdu, size) == (ssize_t)size;
+}
+
 /// @brief initialize shims used by UDS lib and set initialized_ to true.
 ///  It is needed before used the diagnostic manager fully because shims are
 ///  required by most member functions.
@@ -85,8 +223,9 @@ void diagnostic_manager_t::reset()
 	cleanup_active_requests(true);
 }
 
-/// @brief send function use by diagnostic library. It will open a BCM CAN socket TX_SETUP type.
-/// That socket will send cyclic messages configured from a diagnostic request.
+/// @brief send function use by diagnostic library. It sends a single frame with
+/// a BCM TX_SEND, requests are repeated by the diagnostic manager scheduler.
+/// Called with the requests mutex held.
 ///
 /// @param[in] arbitration_id - CAN arbitration ID to use when send message. OBD2 broadcast ID
 ///  is 0x7DF by example.
@@ -97,8 +236,7 @@ void diagnostic_manager_t::reset()
 bool diagnostic_manager_t::shims_send(const uint32_t arbitration_id, const uint8_t* data, const uint8_t size)
 {
 	diagnostic_manager_t& dm = application_t::instance().get_diagnostic_manager();
-	active_diagnostic_request_t* current_adr = dm.get_last_recurring_requests();
-	utils::socketcan_bcm_t& tx_socket = current_adr->get_socket();
+	utils::socketcan_bcm_t& tx_socket = dm.tx_socket_;
 
 	// Make sure that socket has been opened.
 	if(! tx_socket)
@@ -106,28 +244,27 @@ bool diagnostic_manager_t::shims_send(const uint32_t arbitration_id, const uint8
 			dm.get_bus_device_name());
 
 	struct utils::simple_bcm_msg bcm_msg;
-	struct can_frame cfd;
+	struct canfd_frame cfd;
 
 	memset(&cfd, 0, sizeof(cfd));
 	memset(&bcm_msg.msg_head, 0, sizeof(bcm_msg.msg_head));
 
-	struct timeval freq = current_adr->get_frequency_clock().get_timeval_from_period();
-
-	bcm_msg.msg_head.opcode  = TX_SETUP;
+	bcm_msg.msg_head.opcode  = TX_SEND;
 	bcm_msg.msg_head.can_id  = arbitration_id;
-	bcm_msg.msg_head.flags = SETTIMER|STARTTIMER|TX_CP_CAN_ID;
-	bcm_msg.msg_head.ival2.tv_sec = freq.tv_sec;
-	bcm_msg.msg_head.ival2.tv_usec = freq.tv_usec;
 	bcm_msg.msg_head.nframes = 1;
-	cfd.can_dlc = size;
+	cfd.can_id = arbitration_id;
+	cfd.len = size;
 	::memcpy(cfd.data, data, size);
 
 	bcm_msg.frames = cfd;
 
-	tx_socket << bcm_msg;
-	if(tx_socket)
-		return true;
-	return false;
+	if(tx_socket.write(bcm_msg) < 0)
+	{
+		AFB_ERROR("Can't send diagnostic request 0x%X on %s. %s", arbitration_id, dm.get_bus_device_name().c_str(), strerror(errno));
+		dm.send_failed_ = true;
+		return false;
+	}
+	return true;
 }
 
 /// @brief The type signature for an optional logging function, if the user
@@ -160,11 +297,6 @@ const std::string diagnostic_manager_t::get_bus_device_name() const
 		.get_can_device_name(bus_);
 }
 
-active_diagnostic_request_t* diagnostic_manager_t::get_last_recurring_requests() const
-{
-	return recurring_requests_.back();
-}
-
 /// @brief Return diagnostic manager shims member.
 DiagnosticShims& diagnostic_manager_t::get_shims()
 {
@@ -185,6 +317,279 @@ void diagnostic_manager_t::find_and_erase(active_diagnostic_request_t* entry, st
 		requests_list.erase(i);
 }
 
+/// @brief Key of the responses to a request: response arbitration ID, mode and
+/// PID, 0 if the request has no PID. Responses to a functional broadcast request
+/// come from any ID between 0x7E8 and 0x7EF, they are keyed with the broadcast
+/// ID, responses to a request sent to ID 0x7E0 to 0x7E7 come from ID + 8.
+uint64_t diagnostic_manager_t::response_key(uint32_t id, uint8_t mode, uint16_t pid)
+{
+	return ((uint64_t)id << 32) | ((uint64_t)mode << 16) | pid;
+}
+
+uint64_t diagnostic_manager_t::response_key(active_diagnostic_request_t* entry)
+{
+	const DiagnosticRequest& request = entry->get_handle()->request;
+	uint32_t id = entry->get_id() == OBD2_FUNCTIONAL_BROADCAST_ID ?
+		OBD2_FUNCTIONAL_BROADCAST_ID :
+		entry->get_id() + DIAGNOSTIC_RESPONSE_ARBITRATION_ID_OFFSET;
+	return response_key(id, request.mode, request.has_pid ? request.pid : 0);
+}
+
+/// @brief Length of the PID of a request, as sent by uds-c when it isn't set.
+uint8_t diagnostic_manager_t::pid_length(const DiagnosticRequest& request)
+{
+	if(request.pid_length)
+		return request.pid_length;
+	return request.mode <= 0xa || request.mode == 0x3e || request.pid <= 0xff ? 1 : 2;
+}
+
+/// @brief Find the request in flight a response answers, from its mode and PID.
+/// Negative responses don't have a PID, they go to the first request in flight
+/// with the same mode. Called with the requests mutex held.
+///
+/// @param[in] id - arbitration ID of the response.
+/// @param[in] payload - response mode, PID and data.
+/// @param[in] size - number of bytes in payload.
+///
+/// @return the request or nullptr if no request in flight expects that response.
+active_diagnostic_request_t* diagnostic_manager_t::match_payload(uint32_t id, const uint8_t* payload, uint8_t size)
+{
+	if(size < 1)
+		return nullptr;
+
+	const uint32_t ids[] = {id, OBD2_FUNCTIONAL_BROADCAST_ID};
+	if(payload[0] == DIAGNOSTIC_NEGATIVE_RESPONSE_MODE)
+	{
+		if(size < 2)
+			return nullptr;
+		for(const auto& in_flight : in_flight_)
+		{
+			uint32_t in_flight_id = in_flight.first >> 32;
+			if((in_flight_id == ids[0] || in_flight_id == ids[1]) && ((in_flight.first >> 16) & 0xff) == payload[1])
+				return in_flight.second;
+		}
+		return nullptr;
+	}
+
+	// The PID length depends on the mode, both lengths are tried.
+	uint8_t mode = payload[0] - DIAGNOSTIC_RESPONSE_MODE_OFFSET;
+	for(uint32_t key_id : ids)
+	{
+		uint64_t keys[3] = {response_key(key_id, mode, 0), 0, 0};
+		if(size > 1)
+			keys[1] = response_key(key_id, mode, payload[1]);
+		if(size > 2)
+			keys[2] = response_key(key_id, mode, (payload[1] << 8) | payload[2]);
+		for(uint64_t key : keys)
+		{
+			auto it = in_flight_.find(key);
+			if(key && it != in_flight_.end())
+				return it->second;
+		}
+	}
+	return nullptr;
+}
+
+/// @brief Find the request in flight a CAN frame answers, from the mode and PID
+/// of single and first frames. Consecutive frames go to the request whose
+/// multi-frame response is being received from the same ID. Called with the
+/// requests mutex held.
+///
+/// @param[in] cm - A diagnostic response CAN frame.
+///
+/// @return the request or nullptr if no request in flight expects that frame.
+active_diagnostic_request_t* diagnostic_manager_t::match_response(const can_message_t& cm)
+{
+	const uint8_t* data = cm.get_data();
+	uint8_t length = cm.get_length();
+	if(length < 2)
+		return nullptr;
+
+	// ISO-TP frame type in the high nibble of the first byte.
+	switch(data[0] >> 4)
+	{
+		case 0:
+			return match_payload(cm.get_id(), data + 1, std::min<uint8_t>(data[0] & 0x0f, length - 1));
+		case 1:
+			return match_payload(cm.get_id(), data + 2, length - 2);
+		case 2:
+		{
+			auto it = receiving_.find(cm.get_id());
+			return it != receiving_.end() ? it->second : nullptr;
+		}
+		default:
+			return nullptr;
+	}
+}
+
+/// @brief Plan the next poll of a recurring request. Called with the requests
+/// mutex held.
+///
+/// @param[in] entry - the request.
+/// @param[in] deadline - time of the poll, in microseconds.
+void diagnostic_manager_t::schedule(active_diagnostic_request_t* entry, uint64_t deadline)
+{
+	entry->set_deadline(deadline);
+	wheel_.add((deadline + DIAGNOSTIC_WHEEL_TICK_US - 1) / DIAGNOSTIC_WHEEL_TICK_US, diagnostic_timer_t{entry, false, 0});
+}
+
+/// @brief Set the event loop timer to the next expiration of the wheel, or
+/// disable it when there is nothing left to do. Called with the requests mutex
+/// held, from the event loop or a verb. Responses only add timers after the
+/// timeout of the request they answer, so the decoding thread never has to.
+void diagnostic_manager_t::arm_timer()
+{
+	if(! timer_)
+		return;
+
+	uint64_t next = wheel_.next_expiry();
+	if(next == UINT64_MAX)
+	{
+		sd_event_source_set_enabled(timer_, SD_EVENT_OFF);
+		return;
+	}
+	sd_event_source_set_time(timer_, next * DIAGNOSTIC_WHEEL_TICK_US);
+	sd_event_source_set_enabled(timer_, SD_EVENT_ONESHOT);
+}
+
+/// @brief Send a request and start its response timeout. Called with the
+/// requests mutex held, after checking the window of its ECU.
+///
+/// A request the kernel refuses releases its slot at once instead of holding
+/// it until its timeout. It is sent again at its next poll, or after its
+/// timeout for a one-time request.
+///
+/// @return false if the request couldn't be sent.
+bool diagnostic_manager_t::send_request(active_diagnostic_request_t* entry, uint64_t now)
+{
+	uint32_t sequence = entry->next_sequence();
+	entry->set_state(diagnostic_request_state_t::IN_FLIGHT);
+	diagnostic_window_t& window = windows_[entry->get_id()];
+	window.in_flight++;
+	in_flight_[response_key(entry)] = entry;
+
+	// Functional broadcast requests are single frames, sent by isotp-c.
+	bool sent;
+	if(entry->get_id() != OBD2_FUNCTIONAL_BROADCAST_ID && uses_kernel_isotp(entry))
+		{sent = send_isotp_request(entry);}
+	else
+	{
+		send_failed_ = false;
+		start_diagnostic_request(&shims_, entry->get_handle());
+		sent = ! send_failed_;
+	}
+
+	uint64_t timeout = (uint64_t)(entry->get_timeout_clock().frequency_to_period() * MICRO);
+	if(! sent)
+	{
+		in_flight_.erase(response_key(entry));
+		window.in_flight--;
+		entry->set_state(diagnostic_request_state_t::IDLE);
+		if(! entry->get_recurring())
+			{schedule(entry, now + timeout);}
+		return false;
+	}
+
+	entry->get_timeout_clock().tick(now);
+	wheel_.add((now + timeout) / DIAGNOSTIC_WHEEL_TICK_US, diagnostic_timer_t{entry, true, sequence});
+	return true;
+}
+
+/// @brief End the send of a request, on its response or its timeout, and send
+/// the requests waiting for a slot of the same ECU. Called with the requests
+/// mutex held.
+void diagnostic_manager_t::complete_request(active_diagnostic_request_t* entry, uint64_t now)
+{
+	if(entry->get_state() != diagnostic_request_state_t::IN_FLIGHT)
+		return;
+
+	in_flight_.erase(response_key(entry));
+	for(auto it = receiving_.begin(); it != receiving_.end();)
+		{it = it->second == entry ? receiving_.erase(it) : std::next(it);}
+	entry->set_state(diagnostic_request_state_t::IDLE);
+
+	diagnostic_window_t& window = windows_[entry->get_id()];
+	window.in_flight--;
+	while(window.in_flight < in_flight_max_ && ! window.queued.empty())
+	{
+		active_diagnostic_request_t* next = window.queued.front();
+		window.queued.pop_front();
+		send_request(next, now);
+	}
+}
+
+/// @brief Handle an expired timer of the wheel. Called from the event loop
+/// with the requests mutex held.
+///
+/// @param[in] timer - the expired timer.
+/// @param[in] now - current time, in microseconds.
+void diagnostic_manager_t::expire(const diagnostic_timer_t& timer, uint64_t now)
+{
+	active_diagnostic_request_t* entry = timer.entry;
+
+	if(timer.timeout)
+	{
+		// Timeouts of previous sends are ignored.
+		if(entry->get_state() != diagnostic_request_state_t::IN_FLIGHT || entry->get_sequence() != timer.sequence)
+			return;
+
+		// The timeout clock is restarted at each frame of a multi-frame response.
+		uint64_t end = entry->get_timeout_clock().get_last_tick() +
+			(uint64_t)(entry->get_timeout_clock().frequency_to_period() * MICRO);
+		if(end > now)
+		{
+			wheel_.add(end / DIAGNOSTIC_WHEEL_TICK_US, timer);
+			return;
+		}
+
+		AFB_DEBUG("Diagnostic request %s timed out", entry->get_name().c_str());
+		complete_request(entry, now);
+		if(! entry->get_recurring())
+			{remove_request(entry, true);}
+		return;
+	}
+
+	// Next poll from the previous deadline so the rate doesn't drift, or from
+	// now after a stall of the event loop. A one-time request only gets here to
+	// be sent again after a failed send.
+	if(entry->get_recurring())
+	{
+		uint64_t period = (uint64_t)(entry->get_frequency_clock().frequency_to_period() * MICRO);
+		uint64_t deadline = entry->get_deadline() + period;
+		if(deadline <= now)
+			{deadline = now + period;}
+		schedule(entry, deadline);
+	}
+
+	if(entry->get_state() != diagnostic_request_state_t::IDLE)
+	{
+		AFB_DEBUG("Diagnostic request %s not answered yet, poll skipped", entry->get_name().c_str());
+		return;
+	}
+
+	diagnostic_window_t& window = windows_[entry->get_id()];
+	if(window.in_flight < in_flight_max_)
+		{send_request(entry, now);}
+	else
+	{
+		entry->set_state(diagnostic_request_state_t::QUEUED);
+		window.queued.push_back(entry);
+	}
+}
+
+/// @brief Event loop timer callback, expiring the wheel timers up to now then
+/// re-arming the timer.
+int diagnostic_manager_t::on_timer(sd_event_source* s, uint64_t usec, void* userdata)
+{
+	diagnostic_manager_t* dm = (diagnostic_manager_t*)userdata;
+	std::lock_guard<std::mutex> requests_lock(dm->requests_mutex_);
+
+	uint64_t now = system_time_us();
+	dm->wheel_.advance(now / DIAGNOSTIC_WHEEL_TICK_US, [dm, now](const diagnostic_timer_t& timer){ dm->expire(timer, now); });
+	dm->arm_timer();
+	return 0;
+}
+
 /// @brief Free memory allocated on active_diagnostic_request_t object and close the socket.
 void diagnostic_manager_t::cancel_request(active_diagnostic_request_t* entry)
 {
@@ -193,13 +598,12 @@ void diagnostic_manager_t::cancel_request(active_diagnostic_request_t* entry)
 	entry = nullptr;
 }
 
-/// @brief Cleanup a specific request if it isn't running and get complete. As it is almost
-/// impossible to get that state for a recurring request without waiting for that, you can
-/// force the cleaning operation.
+/// @brief Remove a request from the lists and the scheduler, then free it.
+/// Called with the requests mutex held.
 ///
 /// @param[in] entry - the request to clean
 /// @param[in] force - Force the cleaning or not ?
-void diagnostic_manager_t::cleanup_request(active_diagnostic_request_t* entry, bool force)
+void diagnostic_manager_t::remove_request(active_diagnostic_request_t* entry, bool force)
 {
 	if(entry != nullptr && (force || entry->response_received()))
 	{
@@ -208,44 +612,86 @@ void diagnostic_manager_t::cleanup_request(active_diagnostic_request_t* entry, b
 			request_string, sizeof(request_string));
 		if(force && entry->get_recurring())
 		{
-			cancel_request(entry);
-			find_and_erase(entry, recurring_requests_);
 			AFB_DEBUG("Cancelling completed, recurring request: %s", request_string);
+			find_and_erase(entry, recurring_requests_);
 		}
 		else if (!entry->get_recurring())
 		{
 			AFB_DEBUG("Cancelling completed, non-recurring request: %s", request_string);
-			cancel_request(entry);
 			find_and_erase(entry, non_recurring_requests_);
 		}
+		else
+			{return;}
+
+		wheel_.remove_if([entry](const diagnostic_timer_t& timer){ return timer.entry == entry; });
+		if(entry->get_state() == diagnostic_request_state_t::QUEUED)
+		{
+			std::deque<active_diagnostic_request_t*>& queued = windows_[entry->get_id()].queued;
+			queued.erase(std::find(queued.begin(), queued.end(), entry));
+		}
+		else
+			{complete_request(entry, system_time_us());}
+		cancel_request(entry);
 	}
 }
 
+/// @brief Cleanup a specific request if it isn't running and get complete. As it is almost
+/// impossible to get that state for a recurring request without waiting for that, you can
+/// force the cleaning operation.
+///
+/// @param[in] entry - the request to clean
+/// @param[in] force - Force the cleaning or not ?
+void diagnostic_manager_t::cleanup_request(active_diagnostic_request_t* entry, bool force)
+{
+	std::lock_guard<std::mutex> requests_lock(requests_mutex_);
+	remove_request(entry, force);
+}
+
 /// @brief Clean up all requests lists, recurring and not recurring.
 ///
 /// @param[in] force - Force the cleaning or not ? If true, that will do
 /// the same effect as a call to reset().
 void diagnostic_manager_t::cleanup_active_requests(bool force)
 {
-	for(auto& entry : non_recurring_requests_)
+	std::lock_guard<std::mutex> requests_lock(requests_mutex_);
+
+	// Copies, removed requests are erased from the lists.
+	for(auto entry : std::vector<active_diagnostic_request_t*>(non_recurring_requests_))
 	{
 		if (entry != nullptr)
-			cleanup_request(entry, force);
+			remove_request(entry, force);
 	}
 
-	for(auto& entry : recurring_requests_)
-	 {
+	for(auto entry : std::vector<active_diagnostic_request_t*>(recurring_requests_))
+	{
 		if (entry != nullptr)
-			cleanup_request(entry, force);
-	 }
+			remove_request(entry, force);
+	}
 }
 
-/// @brief Will return the active_diagnostic_request_t pointer for theDiagnosticRequest or nullptr if
-/// not found.
+/// @brief Find the recurring request for a DiagnosticRequest and remove it, in
+/// a single critical section: a request pointer can't be used once the requests
+/// mutex is released, a decoding thread may have removed it meanwhile.
 ///
 /// @param[in] request - Search key, method will go through recurring list to see if it find that request
 ///  holded by the DiagnosticHandle member.
-active_diagnostic_request_t* diagnostic_manager_t::find_recurring_request(DiagnosticRequest& request)
+/// @param[in] keep_permanent - Don't remove the request if it is permanent.
+///
+/// @return True if a permanent request has been kept.
+bool diagnostic_manager_t::cleanup_recurring_request(DiagnosticRequest& request, bool keep_permanent)
+{
+	std::lock_guard<std::mutex> requests_lock(requests_mutex_);
+	active_diagnostic_request_t* entry = lookup_recurring_request(request);
+	if(entry == nullptr)
+		{return false;}
+	if(keep_permanent && entry->get_permanent())
+		{return true;}
+	remove_request(entry, true);
+	return false;
+}
+
+/// @brief Find a recurring request, called with the requests mutex held.
+active_diagnostic_request_t* diagnostic_manager_t::lookup_recurring_request(DiagnosticRequest& request)
 {
 	for (auto& entry : recurring_requests_)
 	{
@@ -264,7 +710,8 @@ active_diagnostic_request_t* diagnostic_manager_t::find_recurring_request(Diagno
 /// recurring request for the same PID or mode, that's not a problem.
 ///
 /// For an example, see the docs for addRecurringRequest. This function is very
-/// similar but leaves out the frequencyHz parameter.
+/// similar but leaves out the frequencyHz parameter. The request is sent at once
+/// if its ECU has a free in-flight slot, else when one is released.
 ///
 /// @param[in] request - The parameters for the request.
 /// @param[in] name - Human readable name this response, to be used when
@@ -286,13 +733,13 @@ active_diagnostic_request_t* diagnostic_manager_t::add_request(DiagnosticRequest
 	bool wait_for_multiple_responses, const DiagnosticResponseDecoder decoder,
 	const DiagnosticResponseCallback callback)
 {
-	cleanup_active_requests(false);
+	std::lock_guard<std::mutex> requests_lock(requests_mutex_);
 
 	active_diagnostic_request_t* entry = nullptr;
 
-	if (non_recurring_requests_.size() <= MAX_SIMULTANEOUS_DIAG_REQUESTS)
+	if (non_recurring_requests_.size() < MAX_SIMULTANEOUS_DIAG_REQUESTS)
 	{
-		active_diagnostic_request_t* entry = new active_diagnostic_request_t(bus_, request->arbitration_id, name,
+		entry = new active_diagnostic_request_t(bus_, request->arbitration_id, name,
 				wait_for_multiple_responses, decoder, callback, 0, false);
 		entry->set_handle(shims_, request);
 
@@ -300,17 +747,27 @@ active_diagnostic_request_t* diagnostic_manager_t::add_request(DiagnosticRequest
 		diagnostic_request_to_string(&entry->get_handle()->request, request_string,
 				sizeof(request_string));
 
-		// Erase any existing request not already cleaned.
-		cleanup_request(entry, true);
 		AFB_DEBUG("Added one-time diagnostic request on bus %s: %s",
 				bus_.c_str(), request_string);
 
 		non_recurring_requests_.push_back(entry);
+
+		uint64_t now = system_time_us();
+		if(wheel_.empty())
+			{wheel_.advance(now / DIAGNOSTIC_WHEEL_TICK_US, [](const diagnostic_timer_t&){});}
+		diagnostic_window_t& window = windows_[entry->get_id()];
+		if(window.in_flight < in_flight_max_)
+			{send_request(entry, now);}
+		else
+		{
+			entry->set_state(diagnostic_request_state_t::QUEUED);
+			window.queued.push_back(entry);
+		}
+		arm_timer();
 	}
 	else
 	{
 		AFB_WARNING("There isn't enough request entry. Vector exhausted %d/%d", (int)non_recurring_requests_.size(), MAX_SIMULTANEOUS_DIAG_REQUESTS);
-		non_recurring_requests_.resize(MAX_SIMULTANEOUS_DIAG_REQUESTS);
 	}
 	return entry;
 }
@@ -331,12 +788,15 @@ bool diagnostic_manager_t::validate_optional_request_attributes(float frequencyH
 	return true;
 }
 
-/// @brief Add and send a new recurring diagnostic request.
+/// @brief Add a new recurring diagnostic request, polled by the scheduler.
 ///
 /// At most one recurring request can be active for the same arbitration ID, mode
 /// and (if set) PID on the same bus at one time. If you try and call
 /// add_recurring_request with the same key, it will return an error.
 ///
+/// The first poll is at a random time within the first period so that requests
+/// added together are spread over the period instead of going out in bursts.
+///
 /// @param[in] request - The parameters for the request.
 /// @param[in] name - An optional human readable name this response, to be used when
 ///      publishing received responses. If the name is NULL, the published output
@@ -366,23 +826,28 @@ active_diagnostic_request_t* diagnostic_manager_t::add_recurring_request(Diagnos
 	if(!validate_optional_request_attributes(frequencyHz))
 		return entry;
 
-	cleanup_active_requests(false);
+	std::lock_guard<std::mutex> requests_lock(requests_mutex_);
 
-	if(find_recurring_request(*request) == nullptr)
+	if(lookup_recurring_request(*request) == nullptr)
 	{
-		if(recurring_requests_.size() <= MAX_SIMULTANEOUS_DIAG_REQUESTS)
+		if(recurring_requests_.size() < MAX_SIMULTANEOUS_DIAG_REQUESTS)
 		{
 			entry = new active_diagnostic_request_t(bus_, request->arbitration_id, name,
 					wait_for_multiple_responses, decoder, callback, frequencyHz, permanent);
 			recurring_requests_.push_back(entry);
 
 			entry->set_handle(shims_, request);
-			start_diagnostic_request(&shims_, entry->get_handle());
+
+			uint64_t now = system_time_us();
+			uint64_t period = (uint64_t)(entry->get_frequency_clock().frequency_to_period() * MICRO);
+			if(wheel_.empty())
+				{wheel_.advance(now / DIAGNOSTIC_WHEEL_TICK_US, [](const diagnostic_timer_t&){});}
+			schedule(entry, now + (period ? (uint64_t)::rand() % period : 0));
+			arm_timer();
 		}
 		else
 		{
 			AFB_WARNING("There isn't enough request entry. Vector exhausted %d/%d", (int)recurring_requests_.size(), MAX_SIMULTANEOUS_DIAG_REQUESTS);
-			recurring_requests_.resize(MAX_SIMULTANEOUS_DIAG_REQUESTS);
 		}
 	}
 	else
@@ -395,7 +860,8 @@ active_diagnostic_request_t* diagnostic_manager_t::add_recurring_request(Diagnos
 /// @param[in] adr - A pointer to an active diagnostic request holding a valid diagnostic handle
 /// @param[in] response - The response to decode from which the Vehicle message will be built and returned
 ///
-/// @return A filled openxc_VehicleMessage or a zeroed struct if there is an error.
+/// @return A filled openxc_VehicleMessage or a zeroed struct if there is an error. When the PID
+/// isn't supported, the caller removes the request.
 openxc_VehicleMessage diagnostic_manager_t::relay_diagnostic_response(active_diagnostic_request_t* adr, const DiagnosticResponse& response, const uint64_t timestamp)
 {
 	openxc_VehicleMessage message = build_VehicleMessage();
@@ -429,8 +895,8 @@ openxc_VehicleMessage diagnostic_manager_t::relay_diagnostic_response(active_dia
 	// If not success but completed then the pid isn't supported
 	if(!response.success)
 	{
-		found_signals.diagnostic_messages.front()->set_supported(false);
-		cleanup_request(adr, true);
+		if(!found_signals.diagnostic_messages.empty())
+			found_signals.diagnostic_messages.front()->set_supported(false);
 		AFB_NOTICE("PID not supported or ill formed. Please unsubscribe from it. Error code : %d", response.negative_response_code);
 		message = build_VehicleMessage(build_SimpleMessage(adr->get_name(), build_DynamicField("This PID isn't supported by your vehicle.")));
 	}
@@ -460,8 +926,9 @@ openxc_VehicleMessage diagnostic_manager_t::relay_diagnostic_response(active_dia
 }
 
 /// @brief Will take the CAN message and pass it to the receive functions that will process
-/// diagnostic handle for each active diagnostic request then depending on the result we will
-/// return pass the diagnostic response to decode it.
+/// diagnostic handle for the active diagnostic request then depending on the result we will
+/// return pass the diagnostic response to decode it. A complete response releases the
+/// in-flight slot of the request. Called with the requests mutex held.
 ///
 /// @param[in] entry - A pointer to an active diagnostic request holding a valid diagnostic handle
 /// @param[in] cm - A raw CAN message.
@@ -472,11 +939,13 @@ openxc_VehicleMessage diagnostic_manager_t::relay_diagnostic_handle(active_diagn
 	DiagnosticResponse response = diagnostic_receive_can_frame(&shims_, entry->get_handle(), cm.get_id(), cm.get_data(), cm.get_length());
 	if(response.completed && entry->get_handle()->completed)
 	{
+		receiving_.erase(cm.get_id());
 		if(entry->get_handle()->success)
-			return relay_diagnostic_response(entry, response, cm.get_timestamp());
+			return relay_completed_response(entry, response, cm.get_timestamp());
 	}
 	else if(!response.completed && response.multi_frame)
 	{
+		receiving_[cm.get_id()] = entry;
 		// Reset the timeout clock while completing the multi-frame receive
 		entry->get_timeout_clock().tick(
 			entry->get_timeout_clock().get_time_function()());
@@ -485,32 +954,103 @@ openxc_VehicleMessage diagnostic_manager_t::relay_diagnostic_handle(active_diagn
 	return build_VehicleMessage();
 }
 
-/// @brief Find the active diagnostic request with the correct DiagnosticRequestHandle
-/// member that will understand the CAN message using diagnostic_receive_can_frame function
-/// from UDS-C library. Then decode it with an ad-hoc method.
+/// @brief Decode a complete response and release the in-flight slot of its
+/// request. Called with the requests mutex held.
+///
+/// @param[in] entry - the request answered, with its handle completed.
+/// @param[in] response - the response.
+/// @param[in] timestamp - reception time of the response.
+///
+/// @return VehicleMessage with decoded value.
+openxc_VehicleMessage diagnostic_manager_t::relay_completed_response(active_diagnostic_request_t* entry, const DiagnosticResponse& response, uint64_t timestamp)
+{
+	// Requests waiting for multiple responses keep their slot until their timeout.
+	if(entry->response_received())
+		{complete_request(entry, system_time_us());}
+	openxc_VehicleMessage message = relay_diagnostic_response(entry, response, timestamp);
+	if(!response.success || (!entry->get_recurring() && entry->get_state() == diagnostic_request_state_t::IDLE))
+		{remove_request(entry, true);}
+	return message;
+}
+
+/// @brief Find the active diagnostic request in flight the CAN message answers,
+/// by response arbitration ID, mode and PID, and let the UDS-C library
+/// understand it with diagnostic_receive_can_frame. Then decode it with an
+/// ad-hoc method.
 ///
 /// @param[in] cm - Raw CAN message received
 ///
 /// @return VehicleMessage with decoded value.
 openxc_VehicleMessage diagnostic_manager_t::find_and_decode_adr(const can_message_t& cm)
 {
-	openxc_VehicleMessage vehicle_message = build_VehicleMessage();
+	std::lock_guard<std::mutex> requests_lock(requests_mutex_);
+
+	// Responses read on kernel ISO-TP sockets come complete through decode_pdu.
+	active_diagnostic_request_t* entry = match_response(cm);
+	if(entry == nullptr || uses_kernel_isotp(entry))
+		return build_VehicleMessage();
+
+	return relay_diagnostic_handle(entry, cm);
+}
+
+/// @brief Take the next response read on a kernel ISO-TP socket. Only called
+/// by the first decoding thread.
+///
+/// @return false if there isn't any.
+bool diagnostic_manager_t::next_pdu(diagnostic_pdu_t& pdu)
+{
+	return pdu_q_.pop(pdu);
+}
 
-	for ( auto entry : non_recurring_requests_)
+/// @brief Decode a complete response read on a kernel ISO-TP socket, as uds-c
+/// does for the responses it reassembles.
+///
+/// @param[in] pdu - the response.
+///
+/// @return VehicleMessage with decoded value, empty if no request in flight expects it.
+openxc_VehicleMessage diagnostic_manager_t::decode_pdu(const diagnostic_pdu_t& pdu)
+{
+	std::lock_guard<std::mutex> requests_lock(requests_mutex_);
+
+	active_diagnostic_request_t* entry = match_payload(pdu.id, pdu.data, pdu.size);
+	if(entry == nullptr)
+		return build_VehicleMessage();
+
+	DiagnosticRequestHandle* handle = entry->get_handle();
+	DiagnosticResponse response;
+	::memset(&response, 0, sizeof(response));
+	response.arbitration_id = pdu.id;
+	response.multi_frame = pdu.size > 7;
+	response.completed = true;
+
+	if(pdu.data[0] == DIAGNOSTIC_NEGATIVE_RESPONSE_MODE)
 	{
-		vehicle_message = relay_diagnostic_handle(entry, cm);
-		if (is_valid(vehicle_message))
-			return vehicle_message;
+		response.mode = pdu.data[1];
+		if(pdu.size > 2)
+			{response.negative_response_code = (DiagnosticNegativeResponseCode)pdu.data[2];}
 	}
-
-	for ( auto entry : recurring_requests_)
+	else
 	{
-		vehicle_message = relay_diagnostic_handle(entry, cm);
-		if (is_valid(vehicle_message))
-			return vehicle_message;
+		size_t offset = 1;
+		response.mode = handle->request.mode;
+		if(handle->request.has_pid)
+		{
+			offset += pid_length(handle->request);
+			response.has_pid = pdu.size >= offset;
+			if(response.has_pid)
+				{response.pid = offset == 3 ? (pdu.data[1] << 8) | pdu.data[2] : pdu.data[1];}
+		}
+		response.success = ! handle->request.has_pid || (response.has_pid && response.pid == handle->request.pid);
+		if(pdu.size > offset)
+		{
+			response.payload_length = std::min<size_t>(pdu.size - offset, MAX_UDS_RESPONSE_PAYLOAD_LENGTH);
+			::memcpy(response.payload, pdu.data + offset, response.payload_length);
+		}
 	}
 
-	return vehicle_message;
+	handle->completed = true;
+	handle->success = true;
+	return relay_completed_response(entry, response, pdu.timestamp);
 }
 
 /// @brief Tell if the CAN message received is a diagnostic response.
@@ -19,9 +19,16 @@
 
 #include <systemd/sd-event.h>
 #include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
 #include <vector>
+#include <unordered_map>
 
 #include "../utils/socketcan-bcm.hpp"
+#include "../utils/socketcan-isotp.hpp"
+#include "../utils/spsc-ring.hpp"
+#include "../utils/timer-wheel.hpp"
 #include "uds/uds.h"
 #include "openxc.pb.h"
 #include "../can/can-bus.hpp"
@@ -31,9 +38,49 @@
 /// match the maximum CAN controller count.
 ///
 #define DIAGNOSTIC_RESPONSE_ARBITRATION_ID_OFFSET 0x8
+/// Longest diagnostic response PDU kept, mode and PID then the payload a
+/// DiagnosticResponse can hold, the rest is truncated.
+#define DIAGNOSTIC_PDU_MAX_LENGTH (MAX_UDS_RESPONSE_PAYLOAD_LENGTH + 3)
+#define DIAGNOSTIC_PDU_QUEUE_SIZE 64
 
 class active_diagnostic_request_t;
 
+/// @brief A timer of the diagnostic scheduler, the next poll of a recurring
+/// request or the response timeout of a send.
+struct diagnostic_timer_t
+{
+	active_diagnostic_request_t* entry; ///< entry - The request.
+	bool timeout; ///< timeout - True for a response timeout, false for a poll.
+	uint32_t sequence; ///< sequence - Send a timeout is for, it is ignored if the request has been sent again since.
+};
+
+/// @brief A complete diagnostic response read on a kernel ISO-TP socket.
+struct diagnostic_pdu_t
+{
+	uint32_t id; ///< id - Arbitration ID of the response.
+	uint64_t timestamp; ///< timestamp - Reception time, in microseconds.
+	uint16_t size; ///< size - Number of bytes in data.
+	uint8_t data[DIAGNOSTIC_PDU_MAX_LENGTH]; ///< data - Response mode, PID and payload.
+};
+
+/// @brief A kernel ISO-TP socket bound to an ECU and its event loop source.
+struct diagnostic_isotp_channel_t
+{
+	utils::socketcan_isotp_t socket; ///< socket - Sends requests to the ECU and reads its responses.
+	sd_event_source* source; ///< source - Event loop source reading the socket.
+
+	diagnostic_isotp_channel_t(uint32_t tx_id, uint32_t rx_id)
+		: socket{tx_id, rx_id}, source{nullptr}
+	{}
+};
+
+/// @brief In-flight window of an ECU, by request arbitration ID.
+struct diagnostic_window_t
+{
+	int in_flight = 0; ///< in_flight - Requests sent and not answered nor timed out.
+	std::deque<active_diagnostic_request_t*> queued; ///< queued - Requests due, waiting for a slot, in order.
+};
+
 ///
 /// @brief The core structure for running the diagnostics module of the binding.
 ///
@@ -51,9 +98,46 @@ private:
 																	   * response is received for a non-recurring request or it times out, it is removed*/
 	bool initialized_; /*!< * initialized - True if the DiagnosticsManager has been initialized with shims. It will interface with the uds-c lib*/
 
+	std::mutex requests_mutex_; /*!< requests_mutex_ - Protects requests, their scheduling and the TX socket between the event loop,
+								 * the verbs and the decoding thread receiving responses.*/
+	utils::socketcan_bcm_t tx_socket_; /*!< tx_socket_ - BCM socket sending requests frames one at a time.*/
+	bool send_failed_; /*!< send_failed_ - Set by shims_send when the kernel refuses a frame, uds-c doesn't report it.*/
+	sd_event_source* timer_; /*!< timer_ - Event loop timer set to the next expiration of the wheel.*/
+	utils::timer_wheel_t<diagnostic_timer_t> wheel_; /*!< wheel_ - Polls and response timeouts, in milliseconds ticks.*/
+	int in_flight_max_; /*!< in_flight_max_ - Requests in flight at the same time for an ECU.*/
+	std::unordered_map<uint32_t, diagnostic_window_t> windows_; /*!< windows_ - In-flight windows by request arbitration ID.*/
+	std::unordered_map<uint64_t, active_diagnostic_request_t*> in_flight_; /*!< in_flight_ - Requests in flight by response key, see response_key().*/
+	std::unordered_map<uint32_t, active_diagnostic_request_t*> receiving_; /*!< receiving_ - Requests receiving a multi-frame response,
+																		   * by response arbitration ID, for consecutive frames without key.*/
+	std::map<uint32_t, std::unique_ptr<diagnostic_isotp_channel_t> > isotp_channels_; /*!< isotp_channels_ - Kernel ISO-TP sockets by request arbitration ID,
+																					  * empty when responses are reassembled by isotp-c.*/
+	utils::spsc_ring_t<diagnostic_pdu_t> pdu_q_; /*!< pdu_q_ - Responses read on ISO-TP sockets by the event loop, decoded by the first decoding thread.*/
+
 	void init_diagnostic_shims();
 	void reset();
 
+	static uint64_t response_key(uint32_t id, uint8_t mode, uint16_t pid);
+	static uint64_t response_key(active_diagnostic_request_t* entry);
+	static uint8_t pid_length(const DiagnosticRequest& request);
+	active_diagnostic_request_t* match_payload(uint32_t id, const uint8_t* payload, uint8_t size);
+	active_diagnostic_request_t* match_response(const can_message_t& cm);
+	openxc_VehicleMessage relay_completed_response(active_diagnostic_request_t* entry, const DiagnosticResponse& response, uint64_t timestamp);
+	void schedule(active_diagnostic_request_t* entry, uint64_t deadline);
+	void arm_timer();
+	void expire(const diagnostic_timer_t& timer, uint64_t now);
+	bool send_request(active_diagnostic_request_t* entry, uint64_t now);
+	void complete_request(active_diagnostic_request_t* entry, uint64_t now);
+	void remove_request(active_diagnostic_request_t* entry, bool force);
+	active_diagnostic_request_t* lookup_recurring_request(DiagnosticRequest& request);
+
+	static int on_timer(sd_event_source* s, uint64_t usec, void* userdata);
+
+	int open_isotp_channels();
+	void close_isotp_channels();
+	bool uses_kernel_isotp(active_diagnostic_request_t* entry) const;
+	bool send_isotp_request(active_diagnostic_request_t* entry);
+	static int on_isotp_readable(sd_event_source* s, int fd, uint32_t revents, void* userdata);
+
 	static bool shims_send(const uint32_t arbitration_id, const uint8_t* data, const uint8_t size);
 	static void shims_logger(const char* m, ...);
 public:
@@ -64,14 +148,13 @@ public:
 
 	const std::string get_bus_name() const;
 	const std::string get_bus_device_name() const;
-	active_diagnostic_request_t* get_last_recurring_requests() const;
 	DiagnosticShims& get_shims();
 
 	void find_and_erase(active_diagnostic_request_t* entry, std::vector<active_diagnostic_request_t*>& requests_list);
 	void cancel_request(active_diagnostic_request_t* entry);
 	void cleanup_request(active_diagnostic_request_t* entry, bool force);
 	void cleanup_active_requests(bool force);
-	active_diagnostic_request_t* find_recurring_request(DiagnosticRequest& request);
+	bool cleanup_recurring_request(DiagnosticRequest& request, bool keep_permanent);
 
 	// Subscription parts
 	active_diagnostic_request_t* add_request(DiagnosticRequest* request, const std::string& name,
@@ -86,5 +169,7 @@ public:
 	openxc_VehicleMessage relay_diagnostic_response(active_diagnostic_request_t* adr, const DiagnosticResponse& response, const uint64_t timestamp);
 	openxc_VehicleMessage relay_diagnostic_handle(active_diagnostic_request_t* entry, const can_message_t& cm);
 	openxc_VehicleMessage find_and_decode_adr(const can_message_t& cm);
+	bool next_pdu(diagnostic_pdu_t& pdu);
+	openxc_VehicleMessage decode_pdu(const diagnostic_pdu_t& pdu);
 	bool is_diagnostic_response(const can_message_t& cm);
 };
@@ -64,4 +64,16 @@ namespace utils
 
 		return devices_name;
 	}
+
+	/// @brief Read a key in the "CANbus-options" section of the configuration file.
+	///
+	/// @param[in] key - option name.
+	///
+	/// @return The option value or an empty string if it isn't set.
+	const std::string config_parser_t::get_option(const std::string& key)
+	{
+		std::map<std::string, std::string> options = config_content_.get_keys("CANbus-options");
+		auto it = options.find(key);
+		return it != options.end() ? it->second : "";
+	}
 }
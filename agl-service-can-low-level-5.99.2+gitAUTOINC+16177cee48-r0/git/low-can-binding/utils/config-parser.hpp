@@ -40,5 +40,6 @@ namespace utils
 		const std::string& filepath() const;
 		bool check_conf();
 		const std::vector<std::pair<std::string, std::string> > get_devices_name();
+		const std::string get_option(const std::string& key);
 	};
 }
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dispatch-table.hpp"
+
+#include <net/if.h>
+
+#include "../can/can-message-definition.hpp"
+#include "../binding/low-can-hat.hpp"
+
+namespace utils
+{
+	/// @brief Build an empty table.
+	dispatch_table_t::dispatch_table_t()
+	{}
+
+	/// @brief Index the subscriptions by the bus and arbitration ID of their
+	/// CAN signal. Subscriptions are kept in the map order for a same key.
+	///
+	/// @param[in] subscriptions - the subscribed signals map, its mutex must be held.
+	dispatch_table_t::dispatch_table_t(const std::map<int, std::shared_ptr<low_can_subscription_t> >& subscriptions)
+	{
+		for(const auto& sub: subscriptions)
+		{
+			subscriptions_[sub.first] = sub.second;
+
+			std::shared_ptr<can_signal_t> sig = sub.second->get_can_signal();
+			if(sig)
+			{
+				const std::string device_name = sig->get_message()->get_bus_device_name();
+				int ifindex = (int)::if_nametoindex(device_name.c_str());
+				if(ifindex == 0)
+				{
+					AFB_WARNING("Can't get interface index of CAN device '%s', %s won't be decoded", device_name.c_str(), sig->get_name().c_str());
+					continue;
+				}
+				int plan_index = sig->get_message()->get_decode_plan().find(sig.get());
+				can_entries_[make_key(ifindex, sig->get_message()->get_id())].push_back({sub.second, sig, plan_index});
+			}
+			else if(! sub.second->get_diagnostic_message().empty() && ! diagnostic_subscription_)
+				{diagnostic_subscription_ = sub.second;}
+		}
+	}
+
+	uint64_t dispatch_table_t::make_key(int ifindex, uint32_t can_id)
+	{
+		return ((uint64_t)(uint32_t)ifindex << 32) | can_id;
+	}
+
+	/// @brief Find entries to process for a CAN message.
+	///
+	/// @param[in] ifindex - interface index of the CAN device the message has been read on.
+	/// @param[in] can_id - the message arbitration ID.
+	///
+	/// @return entries for that CAN message, nullptr if none.
+	const std::vector<dispatch_entry_t>* dispatch_table_t::find(int ifindex, uint32_t can_id) const
+	{
+		auto it = can_entries_.find(make_key(ifindex, can_id));
+		return it != can_entries_.end() ? &it->second : nullptr;
+	}
+
+	/// @brief Find a subscription by its index.
+	///
+	/// @return the subscription, nullptr if it doesn't exist anymore.
+	std::shared_ptr<low_can_subscription_t> dispatch_table_t::find_subscription(int index) const
+	{
+		auto it = subscriptions_.find(index);
+		return it != subscriptions_.end() ? it->second : nullptr;
+	}
+
+	std::shared_ptr<low_can_subscription_t> dispatch_table_t::get_diagnostic_subscription() const
+	{
+		return diagnostic_subscription_;
+	}
+}
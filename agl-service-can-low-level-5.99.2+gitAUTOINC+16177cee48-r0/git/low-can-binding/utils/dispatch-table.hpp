@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+#include "../can/can-signals.hpp"
+#include "../binding/low-can-subscription.hpp"
+
+namespace utils
+{
+	/// @brief A subscription to notify for a CAN arbitration ID and the signal to decode for it.
+	struct dispatch_entry_t
+	{
+		std::shared_ptr<low_can_subscription_t> subscription; ///< subscription - the subscription to notify.
+		std::shared_ptr<can_signal_t> can_signal; ///< can_signal - the CAN signal to decode from the message.
+		int plan_index; ///< plan_index - index of the signal value in its message decode plan, -1 if not in it.
+	};
+
+	/// @brief Immutable index of the subscriptions, used by the decoding thread.
+	///
+	/// It is built from the subscribed signals map each time it changes, then
+	/// published as a new snapshot by the signals manager. That way the decoding
+	/// thread finds the subscriptions of a CAN message with one lookup by bus and
+	/// arbitration ID, and the pushing thread a subscription by its index, without
+	/// locking the subscribed signals map.
+	class dispatch_table_t
+	{
+	private:
+		std::unordered_map<uint64_t, std::vector<dispatch_entry_t> > can_entries_; ///< can_entries_ - entries by CAN device interface index and arbitration ID.
+		std::shared_ptr<low_can_subscription_t> diagnostic_subscription_; ///< diagnostic_subscription_ - the subscription receiving diagnostic responses, if any.
+		std::unordered_map<int, std::shared_ptr<low_can_subscription_t> > subscriptions_; ///< subscriptions_ - all subscriptions by index.
+
+		static uint64_t make_key(int ifindex, uint32_t can_id);
+
+	public:
+		dispatch_table_t();
+		explicit dispatch_table_t(const std::map<int, std::shared_ptr<low_can_subscription_t> >& subscriptions);
+
+		const std::vector<dispatch_entry_t>* find(int ifindex, uint32_t can_id) const;
+		std::shared_ptr<low_can_subscription_t> find_subscription(int index) const;
+		std::shared_ptr<low_can_subscription_t> get_diagnostic_subscription() const;
+	};
+}
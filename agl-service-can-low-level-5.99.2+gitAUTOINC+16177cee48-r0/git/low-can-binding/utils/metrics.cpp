@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "metrics.hpp"
+
+namespace utils
+{
+	latency_histogram_t::latency_histogram_t()
+		: max_{0}
+	{
+		for(auto& bucket: buckets_)
+			{bucket.store(0, std::memory_order_relaxed);}
+	}
+
+	/// @brief Lowest value counted in a bucket.
+	uint64_t latency_histogram_t::bucket_lowest(unsigned int index)
+	{
+		if(index < LATENCY_HISTOGRAM_SUB_BUCKETS)
+			return index;
+		unsigned int shift = index / LATENCY_HISTOGRAM_SUB_BUCKETS - 1;
+		return (uint64_t)(LATENCY_HISTOGRAM_SUB_BUCKETS + index % LATENCY_HISTOGRAM_SUB_BUCKETS) << shift;
+	}
+
+	/// @brief Value under which a ratio of recorded values are, the highest of
+	/// its bucket, not above the maximum recorded.
+	///
+	/// @param[in] counts - buckets counts, read once so percentiles are consistent.
+	/// @param[in] total - sum of counts.
+	/// @param[in] ratio - ratio, between 0 and 1.
+	uint64_t latency_histogram_t::percentile(const uint64_t* counts, uint64_t total, double ratio) const
+	{
+		uint64_t max = max_.load(std::memory_order_relaxed);
+		uint64_t rank = (uint64_t)(ratio * total + 0.5);
+		if(rank == 0)
+			{rank = 1;}
+
+		uint64_t seen = 0;
+		for(unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; i++)
+		{
+			seen += counts[i];
+			if(seen >= rank)
+				return std::min(bucket_lowest(i + 1) - 1, max);
+		}
+		return max;
+	}
+
+	uint64_t latency_histogram_t::get_count() const
+	{
+		return count_.get();
+	}
+
+	/// @brief Summarize the histogram: count, mean, max and usual percentiles,
+	/// all in nanoseconds.
+	json_object* latency_histogram_t::jsonify() const
+	{
+		uint64_t counts[LATENCY_HISTOGRAM_BUCKETS];
+		uint64_t total = 0;
+		for(unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+		{
+			counts[i] = buckets_[i].load(std::memory_order_relaxed);
+			total += counts[i];
+		}
+
+		json_object* jo = json_object_new_object();
+		json_object_object_add(jo, "count", json_object_new_int64(total));
+		if(total == 0)
+			return jo;
+
+		json_object_object_add(jo, "mean", json_object_new_int64(sum_.get() / std::max(count_.get(), (uint64_t)1)));
+		json_object_object_add(jo, "p50", json_object_new_int64(percentile(counts, total, 0.5)));
+		json_object_object_add(jo, "p90", json_object_new_int64(percentile(counts, total, 0.9)));
+		json_object_object_add(jo, "p99", json_object_new_int64(percentile(counts, total, 0.99)));
+		json_object_object_add(jo, "p999", json_object_new_int64(percentile(counts, total, 0.999)));
+		json_object_object_add(jo, "max", json_object_new_int64(max_.load(std::memory_order_relaxed)));
+		return jo;
+	}
+}
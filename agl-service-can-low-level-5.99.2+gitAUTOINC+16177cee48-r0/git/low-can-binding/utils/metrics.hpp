@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <time.h>
+#include <json-c/json.h>
+
+/// @brief Linear sub-buckets per power of two of a latency histogram, giving a
+/// relative error under 1/8.
+#define LATENCY_HISTOGRAM_SUB_BITS 3
+#define LATENCY_HISTOGRAM_SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_BUCKETS ((64 - LATENCY_HISTOGRAM_SUB_BITS + 1) * LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+namespace utils
+{
+	/// @brief Current CLOCK_MONOTONIC time in nanoseconds, read through the vDSO.
+	inline uint64_t monotonic_ns()
+	{
+		struct timespec ts;
+		::clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	}
+
+	/// @brief Counter written by a single thread and read by any.
+	///
+	/// The writer increments it with a relaxed load and store instead of a
+	/// locked read-modify-write, readers may see a value a few increments late.
+	class counter_t
+	{
+	private:
+		std::atomic<uint64_t> value_; ///< value_ - current count.
+
+	public:
+		counter_t()
+			: value_{0}
+		{}
+
+		counter_t(const counter_t& other)
+			: value_{other.get()}
+		{}
+
+		void add(uint64_t n = 1)
+		{
+			value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+		uint64_t get() const
+		{
+			return value_.load(std::memory_order_relaxed);
+		}
+	};
+
+	/// @brief Counter written by several threads and read by any, each
+	/// increment is an atomic read-modify-write.
+	class shared_counter_t
+	{
+	private:
+		std::atomic<uint64_t> value_; ///< value_ - current count.
+
+	public:
+		shared_counter_t()
+			: value_{0}
+		{}
+
+		shared_counter_t(const shared_counter_t& other)
+			: value_{other.get()}
+		{}
+
+		void add(uint64_t n = 1)
+		{
+			value_.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		uint64_t get() const
+		{
+			return value_.load(std::memory_order_relaxed);
+		}
+	};
+
+	/// @brief Latency histogram in nanoseconds, written by a single thread and
+	/// read by any.
+	///
+	/// Like an HDR histogram, values are counted in buckets which are linear
+	/// inside a power of two: values under 8 have their own bucket, then each
+	/// power of two is split in 8 buckets. Recording a value is a few relaxed
+	/// loads and stores, percentiles are only computed when reading it.
+	class latency_histogram_t
+	{
+	private:
+		std::atomic<uint64_t> buckets_[LATENCY_HISTOGRAM_BUCKETS]; ///< buckets_ - values count by bucket.
+		counter_t count_; ///< count_ - number of values recorded.
+		counter_t sum_; ///< sum_ - sum of values recorded.
+		std::atomic<uint64_t> max_; ///< max_ - highest value recorded.
+
+		static unsigned int bucket_index(uint64_t value)
+		{
+			if(value < LATENCY_HISTOGRAM_SUB_BUCKETS)
+				return (unsigned int)value;
+			unsigned int shift = 63 - __builtin_clzll(value) - LATENCY_HISTOGRAM_SUB_BITS;
+			return (shift + 1) * LATENCY_HISTOGRAM_SUB_BUCKETS + ((value >> shift) & (LATENCY_HISTOGRAM_SUB_BUCKETS - 1));
+		}
+
+		static uint64_t bucket_lowest(unsigned int index);
+		uint64_t percentile(const uint64_t* counts, uint64_t total, double ratio) const;
+
+	public:
+		latency_histogram_t();
+		latency_histogram_t(const latency_histogram_t&) = delete;
+
+		/// @brief Record a value, only called by the owning thread.
+		void record(uint64_t value)
+		{
+			std::atomic<uint64_t>& bucket = buckets_[bucket_index(value)];
+			bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			count_.add();
+			sum_.add(value);
+			if(value > max_.load(std::memory_order_relaxed))
+				{max_.store(value, std::memory_order_relaxed);}
+		}
+
+		uint64_t get_count() const;
+		json_object* jsonify() const;
+	};
+
+	/// @brief Record in a histogram the time spent in a scope.
+	class scoped_latency_t
+	{
+	private:
+		latency_histogram_t& histogram_; ///< histogram_ - where the latency is recorded.
+		uint64_t start_; ///< start_ - monotonic time the scope has been entered.
+
+	public:
+		explicit scoped_latency_t(latency_histogram_t& histogram)
+			: histogram_{histogram}, start_{monotonic_ns()}
+		{}
+
+		scoped_latency_t(const scoped_latency_t&) = delete;
+
+		~scoped_latency_t()
+		{
+			histogram_.record(monotonic_ns() - start_);
+		}
+	};
+}
@@ -18,6 +18,9 @@
 
 #include "openxc-utils.hpp"
 
+#include <cstdint>
+#include "pb_encode.h"
+
 #include "../binding/application.hpp"
 
 ///
@@ -374,3 +377,72 @@ bool jsonify_vehicle(const openxc_VehicleMessage& v_msg, json_object* json)
 	json_object_object_add(json, "error", json_object_new_string("openxc_SimpleMessage doesn't have name'"));
 	return false;
 }
+
+/// @brief nanopb output stream callback appending the encoded bytes to a string.
+static bool append_to_string(pb_ostream_t* stream, const pb_byte_t* buf, size_t count)
+{
+	static_cast<std::string*>(stream->state)->append((const char*)buf, count);
+	return true;
+}
+
+///
+/// @brief Serialize a VehicleMessage in the openxc protobuf binary format, prefixed
+/// by its varint encoded length as in openxc binary streams. Serialized
+/// messages can be appended one after the other to push them at once.
+///
+/// @param[in] v_msg - const reference to an openxc_VehicleMessage to serialize.
+/// @param[out] frames - string the length delimited message is appended to.
+///
+/// @return True if the message has been serialized, false if not. In such case
+///  frames is left as it was.
+///
+bool serialize_vehicle(const openxc_VehicleMessage& v_msg, std::string& frames)
+{
+	size_t length = frames.size();
+	pb_ostream_t stream = {&append_to_string, &frames, SIZE_MAX, 0};
+	if(! pb_encode_delimited(&stream, openxc_VehicleMessage_fields, &v_msg))
+	{
+		AFB_ERROR("Can't serialize VehicleMessage: %s", PB_GET_ERROR(&stream));
+		frames.resize(length);
+		return false;
+	}
+	return true;
+}
+
+///
+/// @brief Make a JSON string from serialized VehicleMessages, the only way to push
+/// binary data through an application framework event.
+///
+/// @param[in] frames - length delimited messages made by serialize_vehicle.
+///
+/// @return A json string object holding frames encoded in base64.
+///
+json_object* jsonify_frames(const std::string& frames)
+{
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string encoded;
+	encoded.reserve((frames.size() + 2) / 3 * 4);
+
+	const unsigned char* data = (const unsigned char*)frames.data();
+	size_t i = 0;
+	for(; i + 2 < frames.size(); i += 3)
+	{
+		uint32_t n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+		encoded += alphabet[(n >> 18) & 0x3F];
+		encoded += alphabet[(n >> 12) & 0x3F];
+		encoded += alphabet[(n >> 6) & 0x3F];
+		encoded += alphabet[n & 0x3F];
+	}
+	if(i < frames.size())
+	{
+		uint32_t n = data[i] << 16;
+		if(i + 1 < frames.size())
+			n |= data[i + 1] << 8;
+		encoded += alphabet[(n >> 18) & 0x3F];
+		encoded += alphabet[(n >> 12) & 0x3F];
+		encoded += i + 1 < frames.size() ? alphabet[(n >> 6) & 0x3F] : '=';
+		encoded += '=';
+	}
+
+	return json_object_new_string_len(encoded.c_str(), (int)encoded.size());
+}
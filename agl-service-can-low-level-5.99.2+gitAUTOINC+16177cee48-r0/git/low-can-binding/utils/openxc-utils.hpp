@@ -47,3 +47,7 @@ void jsonify_DynamicField(const openxc_DynamicField& field, json_object* value);
 bool jsonify_simple(const openxc_SimpleMessage& s_msg, json_object* json);
 
 bool jsonify_vehicle(const openxc_VehicleMessage& v_msg, json_object* json);
+
+bool serialize_vehicle(const openxc_VehicleMessage& v_msg, std::string& frames);
+
+json_object* jsonify_frames(const std::string& frames);
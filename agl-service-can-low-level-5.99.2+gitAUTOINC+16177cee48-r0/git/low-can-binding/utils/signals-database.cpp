@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "signals-database.hpp"
+
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../can/can-message-set.hpp"
+#include "../can/can-message-definition.hpp"
+#include "../can/can-decoder.hpp"
+#include "../diagnostic/diagnostic-message.hpp"
+#include "../binding/low-can-hat.hpp"
+
+namespace utils
+{
+	signals_database_t::signals_database_t()
+		: data_{nullptr}, size_{0}, header_{nullptr}
+	{}
+
+	signals_database_t::~signals_database_t()
+	{
+		close();
+	}
+
+	/// @brief Take the mapping of another database, the previous mapping goes
+	/// to other and is released with it.
+	signals_database_t& signals_database_t::operator=(signals_database_t&& other)
+	{
+		std::swap(path_, other.path_);
+		std::swap(data_, other.data_);
+		std::swap(size_, other.size_);
+		std::swap(header_, other.header_);
+		return *this;
+	}
+
+	/// @brief Check that a table of the database lies in the mapping.
+	template <typename T>
+	bool signals_database_t::check_table(uint32_t offset, uint32_t count, const char* name) const
+	{
+		if(offset % 4 || offset > size_ || count > (size_ - offset) / sizeof(T))
+		{
+			AFB_ERROR("Signals database %s: %s table out of file", path_.c_str(), name);
+			return false;
+		}
+		return true;
+	}
+
+	/// @brief Return a string of the pool, nullptr if the offset is out of it.
+	const char* signals_database_t::get_string(uint32_t offset) const
+	{
+		if(offset >= header_->strings_size)
+		{
+			AFB_ERROR("Signals database %s: string offset %u out of pool", path_.c_str(), offset);
+			return nullptr;
+		}
+		return (const char*)data_ + header_->strings_offset + offset;
+	}
+
+	/// @brief Map a signals database file and check its header and tables bounds.
+	///
+	/// @param[in] path - database file written by signals-compiler.
+	///
+	/// @return 0 if the database is usable, -1 otherwise.
+	int signals_database_t::open(const std::string& path)
+	{
+		close();
+		path_ = path;
+
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if(fd < 0)
+		{
+			AFB_ERROR("Can't open signals database %s: %s", path.c_str(), strerror(errno));
+			return -1;
+		}
+
+		struct stat st;
+		if(::fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(sdb_header_t))
+		{
+			AFB_ERROR("Signals database %s is too short", path.c_str());
+			::close(fd);
+			return -1;
+		}
+
+		void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if(data == MAP_FAILED)
+		{
+			AFB_ERROR("Can't map signals database %s: %s", path.c_str(), strerror(errno));
+			return -1;
+		}
+		data_ = (const uint8_t*)data;
+		size_ = st.st_size;
+		header_ = (const sdb_header_t*)data_;
+
+		if(header_->magic != SIGNALS_DATABASE_MAGIC || header_->version != SIGNALS_DATABASE_VERSION ||
+		   header_->header_size != sizeof(sdb_header_t) || header_->file_size != size_)
+		{
+			AFB_ERROR("Signals database %s: bad header, version %u expected", path.c_str(), SIGNALS_DATABASE_VERSION);
+			close();
+			return -1;
+		}
+
+		if(! check_table<sdb_message_set_t>(header_->message_sets_offset, header_->message_set_count, "message sets") ||
+		   ! check_table<sdb_message_t>(header_->messages_offset, header_->message_count, "messages") ||
+		   ! check_table<sdb_signal_t>(header_->signals_offset, header_->signal_count, "signals") ||
+		   ! check_table<sdb_state_t>(header_->states_offset, header_->state_count, "states") ||
+		   ! check_table<sdb_diagnostic_t>(header_->diagnostics_offset, header_->diagnostic_count, "diagnostic messages") ||
+		   ! check_table<char>(header_->strings_offset, header_->strings_size, "strings") ||
+		   header_->strings_size == 0 || data_[header_->strings_offset + header_->strings_size - 1] != '\0')
+		{
+			AFB_ERROR("Signals database %s is corrupted", path.c_str());
+			close();
+			return -1;
+		}
+
+		// Tables are read once at load, names are read on each event.
+		::madvise(data, size_, MADV_WILLNEED);
+		return 0;
+	}
+
+	void signals_database_t::close()
+	{
+		if(data_)
+			::munmap((void*)data_, size_);
+		data_ = nullptr;
+		size_ = 0;
+		header_ = nullptr;
+	}
+
+	bool signals_database_t::is_open() const
+	{
+		return data_ != nullptr;
+	}
+
+	/// @brief Build message sets from the database. Objects are allocated as
+	/// the generated code does, their names point into the mapping.
+	///
+	/// @param[out] message_sets - message sets built, parents are not set.
+	///
+	/// @return 0 on success, -1 if a table reference is out of bounds.
+	int signals_database_t::load(std::vector<std::shared_ptr<can_message_set_t> >& message_sets) const
+	{
+		if(! header_)
+			return -1;
+
+		const sdb_message_set_t* sets = (const sdb_message_set_t*)(data_ + header_->message_sets_offset);
+		const sdb_message_t* messages = (const sdb_message_t*)(data_ + header_->messages_offset);
+		const sdb_signal_t* signals = (const sdb_signal_t*)(data_ + header_->signals_offset);
+		const sdb_state_t* states = (const sdb_state_t*)(data_ + header_->states_offset);
+		const sdb_diagnostic_t* diagnostics = (const sdb_diagnostic_t*)(data_ + header_->diagnostics_offset);
+
+		static const signal_decoder signal_decoders[SDB_DECODER_MAX] = {
+			nullptr,
+			decoder_t::decode_state,
+			decoder_t::decode_boolean,
+			decoder_t::decode_ignore,
+			decoder_t::decode_noop,
+			nullptr
+		};
+
+		std::vector<std::shared_ptr<can_message_set_t> > loaded;
+		for(uint32_t s = 0; s < header_->message_set_count; s++)
+		{
+			const sdb_message_set_t& set = sets[s];
+			const char* set_name = get_string(set.name);
+			if(! set_name || set.first_message > header_->message_count || set.message_count > header_->message_count - set.first_message ||
+			   set.first_diagnostic > header_->diagnostic_count || set.diagnostic_count > header_->diagnostic_count - set.first_diagnostic)
+				return -1;
+
+			std::vector<std::shared_ptr<can_message_definition_t> > can_messages_definition;
+			for(uint32_t m = set.first_message; m < set.first_message + set.message_count; m++)
+			{
+				const sdb_message_t& msg = messages[m];
+				const char* bus = get_string(msg.bus);
+				if(! bus || msg.first_signal > header_->signal_count || msg.signal_count > header_->signal_count - msg.first_signal)
+					return -1;
+
+				std::vector<std::shared_ptr<can_signal_t> > can_signals;
+				can_signals.reserve(msg.signal_count);
+				for(uint32_t i = msg.first_signal; i < msg.first_signal + msg.signal_count; i++)
+				{
+					const sdb_signal_t& sig = signals[i];
+					const char* name = get_string(sig.name);
+					if(! name || sig.decoder >= SDB_DECODER_MAX || sig.first_state > header_->state_count ||
+					   sig.state_count > header_->state_count - sig.first_state)
+						return -1;
+
+					std::vector<can_signal_state_t> signal_states;
+					signal_states.reserve(sig.state_count);
+					for(uint32_t st = sig.first_state; st < sig.first_state + sig.state_count; st++)
+					{
+						const char* state_name = get_string(states[st].name);
+						if(! state_name)
+							return -1;
+						signal_states.push_back(can_signal_state_t{(uint8_t)states[st].value, state_name});
+					}
+
+					can_signals.push_back(std::make_shared<can_signal_t>(can_signal_t{
+						name,
+						sig.bit_position,
+						sig.bit_size,
+						sig.factor,
+						sig.offset,
+						sig.min_value,
+						sig.max_value,
+						frequency_clock_t(sig.frequency),
+						(sig.flags & SDB_SIGNAL_SEND_SAME) != 0,
+						(sig.flags & SDB_SIGNAL_FORCE_SEND_CHANGED) != 0,
+						std::move(signal_states),
+						(sig.flags & SDB_SIGNAL_WRITABLE) != 0,
+						signal_decoders[sig.decoder],
+						nullptr,
+						false
+					}));
+				}
+
+				can_messages_definition.push_back(std::make_shared<can_message_definition_t>(can_message_definition_t{
+					bus,
+					msg.id,
+					msg.flags & SDB_MESSAGE_EXTENDED ? can_message_format_t::EXTENDED : can_message_format_t::STANDARD,
+					(msg.flags & SDB_MESSAGE_FD) != 0,
+					(msg.flags & SDB_MESSAGE_BIT_RATE_SWITCH) != 0,
+					frequency_clock_t(msg.frequency),
+					(msg.flags & SDB_MESSAGE_FORCE_SEND_CHANGED) != 0,
+					can_signals
+				}));
+			}
+
+			std::vector<std::shared_ptr<diagnostic_message_t> > diagnostic_messages;
+			for(uint32_t d = set.first_diagnostic; d < set.first_diagnostic + set.diagnostic_count; d++)
+			{
+				const sdb_diagnostic_t& diag = diagnostics[d];
+				const char* name = get_string(diag.name);
+				if(! name || diag.unit > UNIT::INVALID)
+					return -1;
+
+				diagnostic_messages.push_back(std::make_shared<diagnostic_message_t>(diagnostic_message_t{
+					diag.pid,
+					name,
+					diag.min,
+					diag.max,
+					(enum UNIT)diag.unit,
+					diag.frequency,
+					diag.decoder == SDB_DECODER_OBD2 ? decoder_t::decode_obd2_response : nullptr,
+					nullptr,
+					(diag.flags & SDB_DIAGNOSTIC_SUPPORTED) != 0,
+					false
+				}));
+			}
+
+			loaded.push_back(std::make_shared<can_message_set_t>(can_message_set_t{(uint8_t)s, set_name,
+				can_messages_definition, diagnostic_messages}));
+		}
+
+		AFB_NOTICE("Signals database %s: %u message set(s), %u messages, %u signals, %u diagnostic messages",
+			path_.c_str(), header_->message_set_count, header_->message_count, header_->signal_count, header_->diagnostic_count);
+		message_sets.swap(loaded);
+		return 0;
+	}
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+/// Binary signals database layout, written by signals-compiler from a JSON
+/// signals description and mapped by the binding at init. All integers are
+/// little endian, every table is 4 bytes aligned and strings are referenced by
+/// their offset in a pool of NUL terminated, deduplicated strings.
+
+#define SIGNALS_DATABASE_MAGIC 0x4244434c // "LCDB"
+#define SIGNALS_DATABASE_VERSION 2
+
+/// @brief Decoders a signal can refer to, the functions are resolved at load.
+enum sdb_decoder_t : uint8_t {
+	SDB_DECODER_DEFAULT, ///< SDB_DECODER_DEFAULT - no decoder, the numerical value is sent.
+	SDB_DECODER_STATE, ///< SDB_DECODER_STATE - decoder_t::decode_state.
+	SDB_DECODER_BOOLEAN, ///< SDB_DECODER_BOOLEAN - decoder_t::decode_boolean.
+	SDB_DECODER_IGNORE, ///< SDB_DECODER_IGNORE - decoder_t::decode_ignore.
+	SDB_DECODER_NOOP, ///< SDB_DECODER_NOOP - decoder_t::decode_noop.
+	SDB_DECODER_OBD2, ///< SDB_DECODER_OBD2 - decoder_t::decode_obd2_response, diagnostic messages only.
+	SDB_DECODER_MAX
+};
+
+#define SDB_SIGNAL_SEND_SAME 0x01
+#define SDB_SIGNAL_FORCE_SEND_CHANGED 0x02
+#define SDB_SIGNAL_WRITABLE 0x04
+
+#define SDB_MESSAGE_EXTENDED 0x01
+#define SDB_MESSAGE_FORCE_SEND_CHANGED 0x02
+#define SDB_MESSAGE_FD 0x04
+#define SDB_MESSAGE_BIT_RATE_SWITCH 0x08
+
+#define SDB_DIAGNOSTIC_SUPPORTED 0x01
+
+struct sdb_header_t
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t header_size;
+	uint32_t file_size;
+	uint32_t message_set_count;
+	uint32_t message_count;
+	uint32_t signal_count;
+	uint32_t state_count;
+	uint32_t diagnostic_count;
+	uint32_t message_sets_offset;
+	uint32_t messages_offset;
+	uint32_t signals_offset;
+	uint32_t states_offset;
+	uint32_t diagnostics_offset;
+	uint32_t strings_offset;
+	uint32_t strings_size;
+	uint32_t reserved;
+};
+
+struct sdb_message_set_t
+{
+	uint32_t name;
+	uint32_t first_message;
+	uint32_t message_count;
+	uint32_t first_diagnostic;
+	uint32_t diagnostic_count;
+};
+
+struct sdb_message_t
+{
+	uint32_t bus;
+	uint32_t id;
+	float frequency;
+	uint32_t first_signal;
+	uint32_t signal_count;
+	uint32_t flags;
+};
+
+struct sdb_signal_t
+{
+	uint32_t name;
+	uint32_t first_state;
+	uint32_t state_count;
+	float factor;
+	float offset;
+	float min_value;
+	float max_value;
+	float frequency;
+	uint16_t bit_position;
+	uint8_t bit_size;
+	uint8_t decoder;
+	uint8_t flags;
+	uint8_t reserved[3];
+};
+
+struct sdb_state_t
+{
+	uint32_t name;
+	uint32_t value;
+};
+
+struct sdb_diagnostic_t
+{
+	uint32_t name;
+	float frequency;
+	int32_t min;
+	int32_t max;
+	uint8_t pid;
+	uint8_t unit;
+	uint8_t decoder;
+	uint8_t flags;
+};
+
+static_assert(sizeof(sdb_header_t) == 64, "sdb_header_t layout changed, bump SIGNALS_DATABASE_VERSION");
+static_assert(sizeof(sdb_signal_t) == 40, "sdb_signal_t layout changed, bump SIGNALS_DATABASE_VERSION");
+static_assert(sizeof(sdb_diagnostic_t) == 20, "sdb_diagnostic_t layout changed, bump SIGNALS_DATABASE_VERSION");
+
+class can_message_set_t;
+
+namespace utils
+{
+	/// @brief A binary signals database mapped read only in memory. Signals and
+	/// states names aren't copied, the objects built from it point into the
+	/// mapping, so it must live as long as them.
+	class signals_database_t
+	{
+	private:
+		std::string path_; ///< path_ - database file path.
+		const uint8_t* data_; ///< data_ - mapped file content.
+		size_t size_; ///< size_ - mapped file size.
+		const sdb_header_t* header_; ///< header_ - header at the beginning of the mapping.
+
+		template <typename T>
+		bool check_table(uint32_t offset, uint32_t count, const char* name) const;
+		const char* get_string(uint32_t offset) const;
+
+	public:
+		signals_database_t();
+		~signals_database_t();
+
+		signals_database_t(const signals_database_t&) = delete;
+		signals_database_t& operator=(const signals_database_t&) = delete;
+		signals_database_t& operator=(signals_database_t&& other);
+
+		int open(const std::string& path);
+		void close();
+		bool is_open() const;
+
+		int load(std::vector<std::shared_ptr<can_message_set_t> >& message_sets) const;
+	};
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <fnmatch.h>
+
+/// @brief Number of wildcard patterns whose result is kept, the cache is
+/// emptied when it is full.
+#define SIGNALS_INDEX_CACHE_MAX 256
+
+namespace utils
+{
+	/// @brief Index of signals by name and by identifier, matching as fnmatch
+	/// with FNM_CASEFOLD against the generic name or the prefixed name.
+	///
+	/// Names are indexed lowercased, in a hash map for exact names and sorted
+	/// for wildcard patterns: only names starting with the pattern literal part,
+	/// "engine." for "engine.*", are checked by fnmatch. Wildcard results are
+	/// cached by pattern. Not thread safe, the caller serializes accesses.
+	template <typename T>
+	class signals_index_t
+	{
+	private:
+		struct entry_t
+		{
+			std::string name;
+			uint32_t signal;
+
+			bool operator<(const entry_t& other) const
+			{
+				return name < other.name;
+			}
+		};
+
+		std::vector<std::shared_ptr<T> > signals_; ///< signals_ - indexed signals, in their definition order.
+		std::unordered_map<std::string, std::vector<uint32_t> > names_; ///< names_ - signals by lowercased generic and prefixed names.
+		std::vector<entry_t> sorted_names_; ///< sorted_names_ - the same names sorted, to get the ones starting with a prefix.
+		std::unordered_map<uint32_t, std::vector<uint32_t> > ids_; ///< ids_ - signals by identifier.
+		std::unordered_map<std::string, std::vector<uint32_t> > cache_; ///< cache_ - signals matched by wildcard patterns.
+		bool built_ = false; ///< built_ - false until build() is called, or after clear().
+
+		static std::string lowercase(const std::string& str)
+		{
+			std::string lower(str);
+			std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+			return lower;
+		}
+
+		void add_name(const std::string& name, uint32_t signal)
+		{
+			std::string lower = lowercase(name);
+			std::vector<uint32_t>& signals = names_[lower];
+			if(signals.empty() || signals.back() != signal)
+			{
+				signals.push_back(signal);
+				sorted_names_.push_back(entry_t{lower, signal});
+			}
+		}
+
+		void append(const std::vector<uint32_t>& matches, std::vector<std::shared_ptr<T> >& found_signals) const
+		{
+			for(uint32_t i : matches)
+				found_signals.push_back(signals_[i]);
+		}
+
+	public:
+		bool is_built() const
+		{
+			return built_;
+		}
+
+		/// @brief Drop the index, to be rebuilt after a change of the signals.
+		void clear()
+		{
+			signals_.clear();
+			names_.clear();
+			sorted_names_.clear();
+			ids_.clear();
+			cache_.clear();
+			built_ = false;
+		}
+
+		/// @brief Index signals.
+		///
+		/// @param[in] signals - signals to index.
+		/// @param[in] get_id - function returning the identifier of a signal.
+		template <typename F>
+		void build(const std::vector<std::shared_ptr<T> >& signals, F get_id)
+		{
+			clear();
+			signals_ = signals;
+			for(uint32_t i = 0; i < signals_.size(); i++)
+			{
+				add_name(signals_[i]->get_generic_name(), i);
+				add_name(signals_[i]->get_name(), i);
+				ids_[get_id(*signals_[i])].push_back(i);
+			}
+			std::sort(sorted_names_.begin(), sorted_names_.end());
+			built_ = true;
+		}
+
+		/// @brief Find signals whose generic or prefixed name matches a pattern.
+		///
+		/// @param[in] pattern - a name or a shell wildcard pattern, case insensitive.
+		/// @param[out] found_signals - matching signals are appended, in their definition order.
+		void find_by_name(const std::string& pattern, std::vector<std::shared_ptr<T> >& found_signals)
+		{
+			std::string lower = lowercase(pattern);
+			size_t literal = lower.find_first_of("*?[\\");
+			if(literal == std::string::npos)
+			{
+				auto it = names_.find(lower);
+				if(it != names_.end())
+					append(it->second, found_signals);
+				return;
+			}
+
+			auto cached = cache_.find(pattern);
+			if(cached != cache_.end())
+			{
+				append(cached->second, found_signals);
+				return;
+			}
+
+			// Only names starting with the literal part can match.
+			std::string prefix = lower.substr(0, literal);
+			std::vector<uint32_t> matches;
+			auto it = std::lower_bound(sorted_names_.begin(), sorted_names_.end(), entry_t{prefix, 0});
+			for(; it != sorted_names_.end() && it->name.compare(0, prefix.size(), prefix) == 0; ++it)
+			{
+				if(::fnmatch(lower.c_str(), it->name.c_str(), FNM_CASEFOLD) == 0)
+					matches.push_back(it->signal);
+			}
+			std::sort(matches.begin(), matches.end());
+			matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+
+			if(cache_.size() >= SIGNALS_INDEX_CACHE_MAX)
+				cache_.clear();
+			append(matches, found_signals);
+			cache_.emplace(pattern, std::move(matches));
+		}
+
+		/// @brief Find signals by identifier, CAN ID for CAN signals and PID for
+		/// diagnostic messages.
+		///
+		/// @param[in] id - the identifier, a non integral value matches nothing.
+		/// @param[out] found_signals - matching signals are appended, in their definition order.
+		void find_by_id(double id, std::vector<std::shared_ptr<T> >& found_signals) const
+		{
+			if(id < 0 || id > UINT32_MAX || std::floor(id) != id)
+				return;
+			auto it = ids_.find((uint32_t)id);
+			if(it != ids_.end())
+				append(it->second, found_signals);
+		}
+	};
+}
@@ -44,28 +44,93 @@ namespace utils
 		return subscribed_signals_;
 	}
 
+	/// @brief Return the dispatch table snapshot. It can be read without
+	/// holding the subscribed signals mutex.
+	const snapshot_t<dispatch_table_t>& signals_manager_t::get_dispatch_table() const
+	{
+		return dispatch_table_;
+	}
+
+	/// @brief Rebuild the dispatch table from the subscribed signals map and
+	/// publish it. Must be called with the subscribed signals mutex held, after
+	/// each change of the map.
+	void signals_manager_t::update_dispatch_table()
+	{
+		dispatch_table_.publish(std::make_shared<const dispatch_table_t>(subscribed_signals_));
+	}
+
+	///
+	/// @brief return the snapshot subscriptions map. As the subscribed signals
+	/// map, it must be accessed with the subscribed signals mutex held.
+	///
+	/// @return Map of snapshots, key is the signals pattern and the rate.
+	std::map<std::pair<std::string, float>, std::shared_ptr<low_can_snapshot_t> >& signals_manager_t::get_snapshots()
+	{
+		return snapshots_;
+	}
+
+	/// @brief Remove a snapshot and its member subscriptions. Must be called with
+	/// the subscribed signals mutex held, the snapshot is destroyed.
+	///
+	/// @param[in] snapshot - the snapshot to remove.
+	void signals_manager_t::remove_snapshot(low_can_snapshot_t* snapshot)
+	{
+		auto it = snapshots_.find(std::make_pair(snapshot->get_name(), snapshot->get_frequency()));
+		if(it == snapshots_.end() || it->second.get() != snapshot)
+			return;
+
+		for(int sub_index: snapshot->get_members())
+			{subscribed_signals_.erase(sub_index);}
+		update_dispatch_table();
+		snapshots_.erase(it);
+	}
+
+	/// @brief Index signals of the active message set, called with the
+	/// signals index mutex held on first lookup.
+	void signals_manager_t::build_signals_index()
+	{
+		application_t& app = application_t::instance();
+		can_signals_index_.build(app.get_all_can_signals(),
+			[&app](can_signal_t& sig) {return app.get_signal_id(sig);});
+		diagnostic_messages_index_.build(app.get_diagnostic_messages(),
+			[&app](diagnostic_message_t& sig) {return app.get_signal_id(sig);});
+	}
+
+	/// @brief Drop signals indexes and their cached results. Must be called
+	/// when the message sets or the active message set change.
+	void signals_manager_t::clear_signals_index()
+	{
+		std::lock_guard<std::mutex> signals_index_lock(signals_index_mutex_);
+		can_signals_index_.clear();
+		diagnostic_messages_index_.clear();
+	}
+
 	///
 	/// @fn std::vector<std::string> find_signals(const openxc_DynamicField &key)
 	/// @brief return signals name found searching through CAN_signals and OBD2 pid
 	///
 	/// @param[in] key : can contain numeric or string value in order to search against
-	///   can signals or obd2 signals name.
+	///   can signals or obd2 signals name. Strings are matched as with fnmatch,
+	///   case insensitively, against generic and prefixed names.
 	///
 	/// @return Vector of signals name found.
 	///
 	struct signals_found signals_manager_t::find_signals(const openxc_DynamicField &key)
 	{
 		struct signals_found sf;
+		std::lock_guard<std::mutex> signals_index_lock(signals_index_mutex_);
+		if(! can_signals_index_.is_built())
+			build_signals_index();
 
 		switch(key.type)
 		{
 			case openxc_DynamicField_Type::openxc_DynamicField_Type_STRING:
-					lookup_signals_by_name(key.string_value, application_t::instance().get_all_can_signals(), sf.can_signals);
-					lookup_signals_by_name(key.string_value, application_t::instance().get_diagnostic_messages(), sf.diagnostic_messages);
+					can_signals_index_.find_by_name(key.string_value, sf.can_signals);
+					diagnostic_messages_index_.find_by_name(key.string_value, sf.diagnostic_messages);
 				break;
 			case openxc_DynamicField_Type::openxc_DynamicField_Type_NUM:
-					lookup_signals_by_id(key.numeric_value, application_t::instance().get_all_can_signals(), sf.can_signals);
-					lookup_signals_by_id(key.numeric_value, application_t::instance().get_diagnostic_messages(), sf.diagnostic_messages);
+					can_signals_index_.find_by_id(key.numeric_value, sf.can_signals);
+					diagnostic_messages_index_.find_by_id(key.numeric_value, sf.diagnostic_messages);
 				break;
 			default:
 				AFB_ERROR("wrong openxc_DynamicField specified. Use openxc_DynamicField_Type_NUM or openxc_DynamicField_Type_STRING type only.");
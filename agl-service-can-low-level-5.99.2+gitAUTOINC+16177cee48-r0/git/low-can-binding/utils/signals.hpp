@@ -19,7 +19,6 @@
 
 #include <vector>
 #include <string>
-#include <fnmatch.h>
 
 #include "openxc.pb.h"
 #include "../binding/application.hpp"
@@ -27,6 +26,10 @@
 #include "../diagnostic/diagnostic-message.hpp"
 
 #include "../binding/low-can-subscription.hpp"
+#include "../binding/low-can-snapshot.hpp"
+#include "dispatch-table.hpp"
+#include "signals-index.hpp"
+#include "snapshot.hpp"
 
 namespace utils
 {
@@ -37,7 +40,8 @@ namespace utils
 	};
 
 	/// @brief Signal manager singleton hold subscription object with attached afb_event and its mutex
-	/// to read and write it safely.
+	/// to read and write it safely. The mutex only serializes writers: decoding and pushing threads
+	/// read the published dispatch table snapshot without locking.
 	/// It can be used to browse CAN signals and Diagnostic messages vectors and find a particular signal to
 	/// subscribe to.
 	class signals_manager_t
@@ -45,8 +49,15 @@ namespace utils
 	private:
 		std::mutex subscribed_signals_mutex_;
 		std::map<int, std::shared_ptr<low_can_subscription_t> > subscribed_signals_; ///< Map containing all subscribed signals, key is the socket int value.
+		snapshot_t<dispatch_table_t> dispatch_table_; ///< Snapshot of subscribed_signals_ indexed for readers, published at each change of the map.
+		std::map<std::pair<std::string, float>, std::shared_ptr<low_can_snapshot_t> > snapshots_; ///< Snapshot subscriptions by signals pattern and rate, protected by the subscribed signals mutex.
+
+		std::mutex signals_index_mutex_; ///< signals_index_mutex_ - serializes lookups in the signals indexes, which cache their results.
+		signals_index_t<can_signal_t> can_signals_index_; ///< can_signals_index_ - CAN signals of the active message set by name and CAN ID.
+		signals_index_t<diagnostic_message_t> diagnostic_messages_index_; ///< diagnostic_messages_index_ - diagnostic messages of the active message set by name and PID.
 
 		signals_manager_t(); ///< Private constructor to make singleton class.
+		void build_signals_index();
 
 	public:
 		static signals_manager_t& instance();
@@ -54,32 +65,15 @@ namespace utils
 		std::mutex& get_subscribed_signals_mutex();
 		std::map<int, std::shared_ptr<low_can_subscription_t> >& get_subscribed_signals();
 
+		const snapshot_t<dispatch_table_t>& get_dispatch_table() const;
+		void update_dispatch_table();
+
+		std::map<std::pair<std::string, float>, std::shared_ptr<low_can_snapshot_t> >& get_snapshots();
+		void remove_snapshot(low_can_snapshot_t* snapshot);
+
 		struct signals_found find_signals(const openxc_DynamicField &key);
 		void find_diagnostic_messages(const openxc_DynamicField &key, std::vector<std::shared_ptr<diagnostic_message_t> >& found_signals);
 		void find_can_signals(const openxc_DynamicField &key, std::vector<std::shared_ptr<can_signal_t> >& found_signals);
-
-		template <typename T>
-		void lookup_signals_by_name(const std::string& key, std::vector<std::shared_ptr<T> > signals, std::vector<std::shared_ptr<T> >& found_signals)
-		{
-			for(std::shared_ptr<T> s : signals)
-			{
-				if(::fnmatch(key.c_str(), s->get_generic_name().c_str(), FNM_CASEFOLD) == 0)
-					found_signals.push_back(s);
-				else if(::fnmatch(key.c_str(), s->get_name().c_str(), FNM_CASEFOLD) == 0)
-					found_signals.push_back(s);
-			}
-		}
-
-		template <typename T>
-		void lookup_signals_by_id(const double key, std::vector<std::shared_ptr<T> > signals, std::vector<std::shared_ptr<T> >& found_signals)
-		{
-			for(std::shared_ptr<T> s : signals)
-			{
-				if(application_t::instance().get_signal_id(*s) == key)
-				{
-					found_signals.push_back(s);
-				}
-			}
-		}
+		void clear_signals_index();
 	};
 }
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace utils
+{
+	/// @brief Read-copy-update holder of an immutable object.
+	///
+	/// Writers build a new version of the object, serialized by their own mutex,
+	/// then publish it. Readers take a reference on the current version without
+	/// ever waiting for a writer; an old version is freed when its last reader
+	/// drops it. A version counter lets readers keep their reference and only
+	/// reload it when something has been published, see snapshot_reader_t.
+	template <typename T>
+	class snapshot_t
+	{
+	private:
+		std::shared_ptr<const T> current_; ///< current_ - last published version.
+		std::atomic<uint64_t> version_; ///< version_ - incremented at each publication.
+
+	public:
+		snapshot_t()
+			: current_{std::make_shared<const T>()}, version_{0}
+		{}
+
+		snapshot_t(const snapshot_t&) = delete;
+		snapshot_t& operator=(const snapshot_t&) = delete;
+
+		/// @brief Get the last published version.
+		std::shared_ptr<const T> load() const
+		{
+			return std::atomic_load(&current_);
+		}
+
+		uint64_t get_version() const
+		{
+			return version_.load(std::memory_order_acquire);
+		}
+
+		/// @brief Replace the current version. Writers have to be serialized by the caller.
+		void publish(std::shared_ptr<const T> next)
+		{
+			std::atomic_store(&current_, next);
+			version_.fetch_add(1, std::memory_order_release);
+		}
+	};
+
+	/// @brief Per thread cached access to a snapshot_t, reloading it only when
+	/// a new version has been published. The referenced object stays valid until
+	/// the next call to get().
+	template <typename T>
+	class snapshot_reader_t
+	{
+	private:
+		const snapshot_t<T>& snapshot_; ///< snapshot_ - the snapshot read.
+		uint64_t version_; ///< version_ - version of cached_.
+		std::shared_ptr<const T> cached_; ///< cached_ - last version loaded.
+
+	public:
+		explicit snapshot_reader_t(const snapshot_t<T>& snapshot)
+			: snapshot_{snapshot}, version_{snapshot.get_version()}, cached_{snapshot.load()}
+		{}
+
+		const T& get()
+		{
+			uint64_t version = snapshot_.get_version();
+			if(version != version_)
+			{
+				version_ = version;
+				cached_ = snapshot_.load();
+			}
+			return *cached_;
+		}
+	};
+}
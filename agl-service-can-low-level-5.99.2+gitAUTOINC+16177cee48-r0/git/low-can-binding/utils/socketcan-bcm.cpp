@@ -19,8 +19,11 @@
 
 #include <net/if.h>
 #include <sys/ioctl.h>
+#include <sys/time.h>
 #include <fcntl.h>
+#include <algorithm>
 
+#include "trace.hpp"
 #include "../binding/application.hpp"
 
 namespace utils
@@ -63,39 +66,204 @@ namespace utils
 			}
 			// Needed because of using systemD event loop. See sd_event_add_io manual.
 			fcntl(socketcan_t::socket_, F_SETFL, O_NONBLOCK);
+
+			// Get reception timestamps as ancillary data instead of one SIOCGSTAMP ioctl by frame.
+			const int timestamp_on = 1;
+			if(setopt(SOL_SOCKET, SO_TIMESTAMP, &timestamp_on, sizeof(timestamp_on)) < 0)
+				AFB_WARNING("setsockopt SO_TIMESTAMP failed, fallback on SIOCGSTAMP. %s", strerror(errno));
+			device_name_ = device_name;
 		}
 		return socket_;
 	}
 
+	/// @brief Get the name of the CAN device the socket has been opened on.
+	/// @return Linux CAN device name.
+	const std::string& socketcan_bcm_t::get_device_name() const
+	{
+		return device_name_;
+	}
+
+	/// @brief Get the reception timestamp of a message read by recvmsg or recvmmsg
+	/// from its SO_TIMESTAMP control message. If not found, the kernel is asked
+	/// with SIOCGSTAMP which only returns the timestamp of the last message read.
+	///
+	/// @return timestamp in microseconds.
+	static uint64_t get_timestamp(const socketcan_bcm_t& s, struct msghdr& hdr)
+	{
+		struct timeval tv;
+		::memset(&tv, 0, sizeof(tv));
+
+		struct cmsghdr* cmsg;
+		for(cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+		{
+			if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMP)
+			{
+				::memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+				break;
+			}
+		}
+		if(cmsg == nullptr)
+			ioctl(s.socket(), SIOCGSTAMP, &tv);
+
+		return 1000000 * tv.tv_sec + tv.tv_usec;
+	}
+
+	/// @brief Size of a BCM message to write: its head and its frame, if any, as
+	/// a CAN FD frame if the head has the CAN_FD_FRAME flag, else as a CAN frame.
+	static size_t bcm_msg_size(const struct simple_bcm_msg& obj)
+	{
+		size_t frame_size = obj.msg_head.flags & CAN_FD_FRAME ? CANFD_MTU : CAN_MTU;
+		return sizeof(obj.msg_head) + (obj.msg_head.nframes ? frame_size : 0);
+	}
+
+	/// @brief Convert a BCM message read from the socket into a CAN message. The
+	/// frame read is a CAN FD one if the job has the CAN_FD_FRAME flag, the number
+	/// of bytes read tells which one it is.
+	static can_message_t convert_from_bcm_msg(const socketcan_bcm_t& s, const struct simple_bcm_msg& msg, ssize_t nbytes, uint64_t timestamp)
+	{
+		long unsigned int frame_size = nbytes > (ssize_t)sizeof(struct bcm_msg_head) ? nbytes - sizeof(struct bcm_msg_head) : 0;
+
+		LOW_CAN_TRACE(trace_level_t::FRAMES,
+			tracer_t::instance().frame(trace_point_t::BCM_READ, s.get_tx_address().can_ifindex, msg.msg_head.can_id, msg.frames.data, msg.frames.len));
+
+		can_message_t cm = ::can_message_t::convert_from_frame(msg.frames,
+				frame_size,
+				timestamp);
+		cm.set_sub_id((int)s.socket());
+		cm.set_ifindex(s.get_tx_address().can_ifindex);
+		return cm;
+	}
+
 	/// Read the socket to retrieve the associated CAN message. All the hard work is do into
 	/// convert_from_frame method and if there isn't CAN message retrieve, only BCM head struct,
 	/// then CAN message will be zeroed and must be handled later.
 	socketcan_bcm_t& operator>>(socketcan_bcm_t& s, can_message_t& cm)
 	{
 		struct utils::simple_bcm_msg msg;
+		char control[CMSG_SPACE(sizeof(struct timeval))];
+		struct iovec iov = {&msg, sizeof(msg)};
+		struct msghdr hdr;
 
 		::memset(&msg, 0, sizeof(msg));
-		const struct sockaddr_can& addr = s.get_tx_address();
-		socklen_t addrlen = sizeof(addr);
-		struct ifreq ifr;
+		::memset(&hdr, 0, sizeof(hdr));
+		hdr.msg_iov = &iov;
+		hdr.msg_iovlen = 1;
+		hdr.msg_control = control;
+		hdr.msg_controllen = sizeof(control);
 
-		ssize_t nbytes = ::recvfrom(s.socket(), &msg, sizeof(msg), 0, (struct sockaddr*)&addr, &addrlen);
-		ifr.ifr_ifindex = addr.can_ifindex;
-		ioctl(s.socket(), SIOCGIFNAME, &ifr);
-		long unsigned int frame_size = nbytes-sizeof(struct bcm_msg_head);
+		ssize_t nbytes = ::recvmsg(s.socket(), &hdr, 0);
+		if(nbytes < 0)
+		{
+			cm = can_message_t();
+			return s;
+		}
 
-		AFB_DEBUG("Data available: %li bytes read. BCM head, opcode: %i, can_id: %i, nframes: %i", frame_size, msg.msg_head.opcode, msg.msg_head.can_id, msg.msg_head.nframes);
-		AFB_DEBUG("read: Found on bus %s:\n id: %X, length: %X, data %02X%02X%02X%02X%02X%02X%02X%02X", ifr.ifr_name, msg.msg_head.can_id, msg.frames.can_dlc,
-			msg.frames.data[0], msg.frames.data[1], msg.frames.data[2], msg.frames.data[3], msg.frames.data[4], msg.frames.data[5], msg.frames.data[6], msg.frames.data[7]);
+		cm = convert_from_bcm_msg(s, msg, nbytes, get_timestamp(s, hdr));
+		return s;
+	}
 
-		struct timeval tv;
-		ioctl(s.socket(), SIOCGSTAMP, &tv);
-		uint64_t timestamp = 1000000 * tv.tv_sec + tv.tv_usec;
-		cm = ::can_message_t::convert_from_frame(msg.frames ,
-				frame_size,
-				timestamp);
-		cm.set_sub_id((int)s.socket());
+	/// Drain the socket, reading up to BCM_READ_BATCH messages by recvmmsg call
+	/// until no more message is pending. Read CAN messages are appended to vcm, those
+	/// without CAN frame, only BCM head struct, are zeroed and must be handled later.
+	socketcan_bcm_t& operator>>(socketcan_bcm_t& s, std::vector<can_message_t>& vcm)
+	{
+		struct utils::simple_bcm_msg msgs[BCM_READ_BATCH];
+		char controls[BCM_READ_BATCH][CMSG_SPACE(sizeof(struct timeval))];
+		struct iovec iovs[BCM_READ_BATCH];
+		struct mmsghdr hdrs[BCM_READ_BATCH];
+		int nmsgs;
+
+		do
+		{
+			::memset(msgs, 0, sizeof(msgs));
+			::memset(hdrs, 0, sizeof(hdrs));
+			for(int i = 0; i < BCM_READ_BATCH; i++)
+			{
+				iovs[i].iov_base = &msgs[i];
+				iovs[i].iov_len = sizeof(msgs[i]);
+				hdrs[i].msg_hdr.msg_iov = &iovs[i];
+				hdrs[i].msg_hdr.msg_iovlen = 1;
+				hdrs[i].msg_hdr.msg_control = controls[i];
+				hdrs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+			}
+
+			nmsgs = ::recvmmsg(s.socket(), hdrs, BCM_READ_BATCH, MSG_DONTWAIT, nullptr);
+			for(int i = 0; i < nmsgs; i++)
+				vcm.push_back(convert_from_bcm_msg(s, msgs[i], hdrs[i].msg_len, get_timestamp(s, hdrs[i].msg_hdr)));
+		} while(nmsgs == BCM_READ_BATCH);
+
+		if(nmsgs < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+			AFB_ERROR("recvmmsg failed on %s. %s", s.get_device_name().c_str(), strerror(errno));
 
 		return s;
 	}
+
+	/// @brief Write a BCM message. The frame, if any, is written as a CAN FD frame if
+	/// the head has the CAN_FD_FRAME flag, else as a CAN frame, the kernel
+	/// rejecting a message whose size doesn't match its frames.
+	///
+	/// @return 0 if the kernel accepted the operation, else -1 and errno set.
+	int socketcan_bcm_t::write(const struct simple_bcm_msg& obj)
+	{
+		if (::sendto(socket_, &obj, bcm_msg_size(obj), 0, (const struct sockaddr*)&tx_address_, sizeof(tx_address_)) < 0)
+			return -1;
+		return 0;
+	}
+
+	/// Write a BCM message, errors are only logged.
+	socketcan_bcm_t& operator<<(socketcan_bcm_t& s, const struct simple_bcm_msg& obj)
+	{
+		if (s.write(obj) < 0)
+			AFB_ERROR("Error sending : %i %s", errno, ::strerror(errno));
+		return s;
+	}
+
+	/// @brief Write BCM messages, up to BCM_WRITE_BATCH messages by sendmmsg call.
+	/// Each message is still a distinct BCM operation, only system calls are saved.
+	/// Sending stops at the first message refused by the kernel.
+	///
+	/// @return number of messages the kernel accepted, the first ones of vobj. If
+	/// less than all, errno is set by the message refused.
+	ssize_t socketcan_bcm_t::write(const std::vector<struct simple_bcm_msg>& vobj)
+	{
+		struct iovec iovs[BCM_WRITE_BATCH];
+		struct mmsghdr hdrs[BCM_WRITE_BATCH];
+
+		size_t sent = 0;
+		while(sent < vobj.size())
+		{
+			size_t count = std::min(vobj.size() - sent, (size_t)BCM_WRITE_BATCH);
+			::memset(hdrs, 0, sizeof(hdrs));
+			for(size_t i = 0; i < count; i++)
+			{
+				iovs[i].iov_base = (void*)&vobj[sent + i];
+				iovs[i].iov_len = bcm_msg_size(vobj[sent + i]);
+				hdrs[i].msg_hdr.msg_name = (void*)&tx_address_;
+				hdrs[i].msg_hdr.msg_namelen = sizeof(tx_address_);
+				hdrs[i].msg_hdr.msg_iov = &iovs[i];
+				hdrs[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			int nmsgs = ::sendmmsg(socket_, hdrs, count, 0);
+			if(nmsgs < 0)
+				break;
+			sent += nmsgs;
+			if((size_t)nmsgs < count)
+			{
+				// The next one failed, sending it alone sets its errno.
+				if(write(vobj[sent]) == 0)
+					{sent++;}
+				break;
+			}
+		}
+		return sent;
+	}
+
+	/// Write BCM messages, errors are only logged.
+	socketcan_bcm_t& operator<<(socketcan_bcm_t& s, const std::vector<struct simple_bcm_msg>& vobj)
+	{
+		if ((size_t)s.write(vobj) < vobj.size())
+			AFB_ERROR("Error sending : %i %s", errno, ::strerror(errno));
+		return s;
+	}
 }
@@ -17,25 +17,24 @@
 
 #pragma once
 
+#include <vector>
+
 #include "socketcan.hpp"
 #include "../can/can-message.hpp"
 
+#define BCM_READ_BATCH 32
+#define BCM_WRITE_BATCH 32
+
 namespace utils
 {
+	/// @brief A BCM message with at most one frame. The frame is sized for CAN FD,
+	/// a CAN frame being its 16 first bytes: only the part matching the CAN_FD_FRAME
+	/// flag of the head is written to the socket.
 	struct simple_bcm_msg
-	{
-		struct bcm_msg_head msg_head;
-		struct can_frame frames;
-	};
-
-#ifdef KERNEL_MINIMAL_VERSION_OK
-	struct canfd_bcm_msg
 	{
 		struct bcm_msg_head msg_head;
 		struct canfd_frame frames;
-		canfd_bcm_msg() { msg_head.flags |= CAN_FD_FRAME; }
 	};
-#endif
 
 	/// @brief derivated socketcan class specialized for BCM CAN socket.
 	class socketcan_bcm_t : public socketcan_t
@@ -45,11 +44,18 @@ namespace utils
 
 		virtual int open(std::string device_name);
 
+		const std::string& get_device_name() const;
+		int write(const struct simple_bcm_msg& obj);
+		ssize_t write(const std::vector<struct simple_bcm_msg>& vobj);
+
 	private:
+		std::string device_name_; ///< device_name_ - Linux CAN device name the socket is bound to, cached at open.
+
 		int connect(const struct sockaddr* addr, socklen_t len);
 	};
 
 	socketcan_bcm_t& operator>>(socketcan_bcm_t& s, can_message_t& cm);
-//	socketcan_bcm_t& operator<<(socketcan_bcm_t& s, const struct simple_bcm_msg& obj);
-//	socketcan_bcm_t& operator<<(socketcan_bcm_t& s, const struct canfd_bcm_msg& obj);
+	socketcan_bcm_t& operator>>(socketcan_bcm_t& s, std::vector<can_message_t>& vcm);
+	socketcan_bcm_t& operator<<(socketcan_bcm_t& s, const struct simple_bcm_msg& obj);
+	socketcan_bcm_t& operator<<(socketcan_bcm_t& s, const std::vector<struct simple_bcm_msg>& vobj);
 }
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2015, 2016 ,2017 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ * Author "Loïc Collignon" <loic.collignon@iot.bzh>
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "socketcan-isotp.hpp"
+
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_CAN_ISOTP
+#include <linux/can/isotp.h>
+#endif
+
+namespace utils
+{
+	socketcan_isotp_t::socketcan_isotp_t(uint32_t tx_id, uint32_t rx_id)
+		: socketcan_t(), tx_id_{tx_id}, rx_id_{rx_id}
+	{}
+
+	uint32_t socketcan_isotp_t::get_tx_id() const
+	{
+		return tx_id_;
+	}
+
+	uint32_t socketcan_isotp_t::get_rx_id() const
+	{
+		return rx_id_;
+	}
+
+	/// @brief Bind the socket.
+	/// @return 0 if success.
+	int socketcan_isotp_t::bind(const struct sockaddr* addr, socklen_t len)
+	{
+		return socket_ != INVALID_SOCKET ? ::bind(socket_, addr, len) : 0;
+	}
+
+	/// @brief Open a non blocking ISO-TP socket on a CAN device, bound to the
+	/// socket CAN IDs. Frames are padded, as most ECUs expect 8 bytes frames.
+	///
+	/// @param[in] device_name is the kernel network device name of the CAN interface.
+	///
+	/// @return the socket file descriptor, -1 with errno set if it can't be opened.
+	int socketcan_isotp_t::open(std::string device_name)
+	{
+		close();
+		socket_ = INVALID_SOCKET;
+#ifdef HAVE_CAN_ISOTP
+		socket_ = socketcan_t::open(PF_CAN, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_ISOTP);
+		if(socket_ < 0)
+		{
+			AFB_WARNING("Can't open an ISO-TP socket: %s", strerror(errno));
+			socket_ = INVALID_SOCKET;
+			return -1;
+		}
+
+		struct can_isotp_options opts;
+		::memset(&opts, 0, sizeof(opts));
+		opts.flags = CAN_ISOTP_TX_PADDING;
+		opts.txpad_content = 0x00;
+		opts.rxpad_content = 0x00;
+		setopt(SOL_CAN_ISOTP, CAN_ISOTP_OPTS, &opts, sizeof(opts));
+
+		struct ifreq ifr;
+		::strncpy(ifr.ifr_name, device_name.c_str(), IFNAMSIZ - 1);
+		ifr.ifr_name[IFNAMSIZ - 1] = '\0';
+		if(::ioctl(socket_, SIOCGIFINDEX, &ifr) < 0)
+		{
+			AFB_ERROR("ioctl failed. Error was : %s", strerror(errno));
+			close();
+			socket_ = INVALID_SOCKET;
+			return -1;
+		}
+
+		tx_address_.can_family = AF_CAN;
+		tx_address_.can_ifindex = ifr.ifr_ifindex;
+		tx_address_.can_addr.tp.tx_id = tx_id_;
+		tx_address_.can_addr.tp.rx_id = rx_id_;
+		if(bind((struct sockaddr *)&tx_address_, sizeof(tx_address_)) < 0)
+		{
+			AFB_ERROR("Bind failed. %s", strerror(errno));
+			close();
+			socket_ = INVALID_SOCKET;
+			return -1;
+		}
+#else
+		errno = EPROTONOSUPPORT;
+#endif
+		return socket_;
+	}
+
+	/// @brief Send a PDU, segmented by the kernel.
+	///
+	/// @return number of bytes sent, -1 on error.
+	ssize_t socketcan_isotp_t::write_pdu(const uint8_t* data, size_t size)
+	{
+		ssize_t nbytes = ::write(socket_, data, size);
+		if(nbytes < 0)
+			AFB_ERROR("Error sending ISO-TP PDU to %X: %s", tx_id_, strerror(errno));
+		return nbytes;
+	}
+
+	/// @brief Read a complete PDU, without blocking.
+	///
+	/// @return number of bytes read, -1 if there is no PDU or on error.
+	ssize_t socketcan_isotp_t::read_pdu(uint8_t* data, size_t size)
+	{
+		return ::read(socket_, data, size);
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2015, 2016 ,2017 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ * Author "Loïc Collignon" <loic.collignon@iot.bzh>
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "socketcan.hpp"
+
+namespace utils
+{
+	/// @brief derivated socketcan class specialized for kernel ISO-TP (CAN_ISOTP)
+	/// sockets. Each socket is bound to a pair of CAN IDs, the kernel segments
+	/// the PDUs written, reassembles the ones received and sends flow control.
+	///
+	/// Built only if the kernel headers have linux/can/isotp.h (HAVE_CAN_ISOTP),
+	/// opening fails otherwise or if the can-isotp module isn't available.
+	class socketcan_isotp_t : public socketcan_t
+	{
+	public:
+		socketcan_isotp_t(uint32_t tx_id, uint32_t rx_id);
+
+		virtual int open(std::string device_name);
+
+		uint32_t get_tx_id() const;
+		uint32_t get_rx_id() const;
+
+		ssize_t write_pdu(const uint8_t* data, size_t size);
+		ssize_t read_pdu(uint8_t* data, size_t size);
+
+	private:
+		uint32_t tx_id_; ///< tx_id_ - CAN ID of the frames sent, PDUs and flow control.
+		uint32_t rx_id_; ///< rx_id_ - CAN ID of the frames received.
+
+		int bind(const struct sockaddr* addr, socklen_t len);
+	};
+}
@@ -19,6 +19,7 @@
 
 #include <net/if.h>
 #include <sys/ioctl.h>
+#include <linux/can/raw.h>
 
 namespace utils
 {
@@ -53,6 +54,11 @@ namespace utils
 			tx_address_.can_family = AF_CAN;
 			tx_address_.can_ifindex = ifr.ifr_ifindex;
 
+			// Receive CAN FD frames too, CAN frames are still read with their own size.
+			const int fd_frames_on = 1;
+			if(setopt(SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &fd_frames_on, sizeof(fd_frames_on)) < 0)
+				AFB_WARNING("setsockopt CAN_RAW_FD_FRAMES failed, only CAN frames will be read. %s", strerror(errno));
+
 			if(bind((struct sockaddr *)&tx_address_, sizeof(tx_address_)) < 0)
 			{
 				AFB_ERROR("Bind failed. %s", strerror(errno));
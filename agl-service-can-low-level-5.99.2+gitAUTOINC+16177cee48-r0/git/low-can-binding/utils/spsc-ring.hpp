@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/// @brief Maximum number of rings a thread can wait on at once.
+#define SPSC_RING_WAIT_MAX 16
+
+namespace utils
+{
+	/// @brief What a ring does with a new element when it is full.
+	enum class overflow_policy_t {
+		DROP_OLDEST, ///< DROP_OLDEST - the oldest element not yet read is discarded to make room.
+		DROP_NEWEST ///< DROP_NEWEST - the new element is discarded.
+	};
+
+	/// @brief Parse an overflow policy name as written in the configuration file.
+	///
+	/// @param[in] name - "drop-oldest" or "drop-newest".
+	/// @param[in] default_policy - policy returned if name isn't recognized.
+	inline overflow_policy_t overflow_policy_from_string(const std::string& name, overflow_policy_t default_policy)
+	{
+		if(name == "drop-oldest")
+			return overflow_policy_t::DROP_OLDEST;
+		if(name == "drop-newest")
+			return overflow_policy_t::DROP_NEWEST;
+		return default_policy;
+	}
+
+	/// @brief Bounded, preallocated, lock-free ring buffer between exactly one
+	/// producer thread and one consumer thread.
+	///
+	/// Each slot carries a sequence number telling if it is free or filled for a
+	/// given turn, as in Vyukov bounded queue. The read index is the only shared
+	/// index: the consumer claims a slot by a compare and swap on it, which lets
+	/// the producer also claim the oldest slot to discard it with DROP_OLDEST policy.
+	///
+	/// Wakeups go through an eventfd written only when the consumer is actually
+	/// sleeping, so a producer pushing a batch then calling notify() costs at most
+	/// one syscall for the whole batch.
+	template <typename T>
+	class spsc_ring_t
+	{
+	private:
+		struct slot_t
+		{
+			std::atomic<size_t> seq;
+			T value;
+		};
+
+		std::unique_ptr<slot_t[]> slots_; ///< slots_ - preallocated storage.
+		size_t capacity_; ///< capacity_ - number of slots, a power of two.
+		size_t mask_; ///< mask_ - capacity_ - 1, to get a slot from an index.
+		overflow_policy_t policy_; ///< policy_ - what to do when pushing in a full ring.
+
+		alignas(64) std::atomic<size_t> head_; ///< head_ - next index to read, claimed by consumer or by producer dropping oldest.
+		alignas(64) std::atomic<size_t> tail_; ///< tail_ - next index to write, only written by producer.
+
+		alignas(64) std::atomic<bool> waiting_; ///< waiting_ - consumer is sleeping or about to sleep on event_fd_.
+		int event_fd_; ///< event_fd_ - eventfd used to wake up the consumer.
+
+		std::atomic<uint64_t> pushed_; ///< pushed_ - elements successfully pushed.
+		std::atomic<uint64_t> dropped_; ///< dropped_ - elements discarded because the ring was full.
+
+	public:
+		/// @brief Construct a ring.
+		///
+		/// @param[in] capacity - slots number, rounded up to a power of two.
+		/// @param[in] policy - overflow policy to apply when full.
+		explicit spsc_ring_t(size_t capacity, overflow_policy_t policy = overflow_policy_t::DROP_OLDEST)
+			: capacity_{0}, mask_{0}, policy_{policy}, head_{0}, tail_{0}, waiting_{false},
+			event_fd_{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}, pushed_{0}, dropped_{0}
+		{
+			resize(capacity);
+		}
+
+		spsc_ring_t(const spsc_ring_t&) = delete;
+		spsc_ring_t& operator=(const spsc_ring_t&) = delete;
+
+		~spsc_ring_t()
+		{
+			if(event_fd_ >= 0)
+				::close(event_fd_);
+		}
+
+		/// @brief Reallocate the ring, dropping its content. Neither producer nor
+		/// consumer must use the ring meanwhile.
+		///
+		/// @param[in] capacity - slots number, rounded up to a power of two.
+		void resize(size_t capacity)
+		{
+			size_t n = 1;
+			while(n < capacity)
+				n <<= 1;
+
+			slots_.reset(new slot_t[n]);
+			for(size_t i = 0; i < n; i++)
+				slots_[i].seq.store(i, std::memory_order_relaxed);
+			capacity_ = n;
+			mask_ = n - 1;
+			head_.store(0, std::memory_order_relaxed);
+			tail_.store(0, std::memory_order_release);
+		}
+
+		void set_overflow_policy(overflow_policy_t policy)
+		{
+			policy_ = policy;
+		}
+
+		overflow_policy_t get_overflow_policy() const
+		{
+			return policy_;
+		}
+
+		size_t capacity() const
+		{
+			return capacity_;
+		}
+
+		/// @brief Approximate number of elements waiting to be read.
+		size_t size() const
+		{
+			size_t tail = tail_.load(std::memory_order_acquire);
+			size_t head = head_.load(std::memory_order_acquire);
+			return tail > head ? tail - head : 0;
+		}
+
+		uint64_t get_pushed() const
+		{
+			return pushed_.load(std::memory_order_relaxed);
+		}
+
+		uint64_t get_dropped() const
+		{
+			return dropped_.load(std::memory_order_relaxed);
+		}
+
+		/// @brief Producer side, copy an element into the ring. Consumer isn't woken up,
+		/// call notify() once the batch is pushed.
+		///
+		/// @return false if the element was discarded by DROP_NEWEST policy, true otherwise.
+		bool push(const T& value)
+		{
+			size_t tail = tail_.load(std::memory_order_relaxed);
+			slot_t& slot = slots_[tail & mask_];
+
+			if(slot.seq.load(std::memory_order_acquire) != tail)
+			{
+				// Full, the slot still holds element tail - capacity_.
+				if(policy_ == overflow_policy_t::DROP_NEWEST)
+				{
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+
+				// Claim the oldest element to discard it. If the consumer claimed it
+				// first, it is being read: wait for the consumer to release the slot.
+				size_t oldest = tail - capacity_;
+				if(head_.compare_exchange_strong(oldest, oldest + 1, std::memory_order_acq_rel))
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+				else
+				{
+					while(slot.seq.load(std::memory_order_acquire) != tail)
+						{}
+				}
+			}
+
+			slot.value = value;
+			slot.seq.store(tail + 1, std::memory_order_release);
+			tail_.store(tail + 1, std::memory_order_release);
+			pushed_.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		/// @brief Consumer side, take the oldest element out of the ring.
+		///
+		/// @return false if the ring is empty.
+		bool pop(T& value)
+		{
+			size_t head = head_.load(std::memory_order_acquire);
+			for(;;)
+			{
+				slot_t& slot = slots_[head & mask_];
+				if(slot.seq.load(std::memory_order_acquire) != head + 1)
+					return false;
+
+				if(head_.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel))
+				{
+					value = slot.value;
+					slot.seq.store(head + capacity_, std::memory_order_release);
+					return true;
+				}
+				// The producer dropped that element meanwhile, head has been reloaded.
+			}
+		}
+
+		/// @brief Producer side, wake up the consumer if it is waiting.
+		void notify()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(waiting_.load(std::memory_order_relaxed))
+				wake();
+		}
+
+		/// @brief Wake up the consumer unconditionally, used to stop it.
+		void wake()
+		{
+			uint64_t one = 1;
+			if(::write(event_fd_, &one, sizeof(one)) < 0)
+				{return;}
+		}
+
+		/// @brief Consumer side, sleep until something has been pushed, wake()
+		/// has been called or the timeout expired.
+		///
+		/// @param[in] timeout_ms - poll timeout, -1 to wait forever.
+		void wait(int timeout_ms = -1)
+		{
+			waiting_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			size_t head = head_.load(std::memory_order_acquire);
+			if(slots_[head & mask_].seq.load(std::memory_order_acquire) != head + 1)
+			{
+				struct pollfd pfd = {event_fd_, POLLIN, 0};
+				::poll(&pfd, 1, timeout_ms);
+			}
+
+			waiting_.store(false, std::memory_order_relaxed);
+			uint64_t count;
+			if(::read(event_fd_, &count, sizeof(count)) < 0)
+				{return;}
+		}
+
+		/// @brief Consumer side of several rings, sleep until something has been
+		/// pushed into any of them, one of them has been woken up or the timeout expired.
+		///
+		/// @param[in] rings - rings read by the calling thread.
+		/// @param[in] count - number of rings, at most SPSC_RING_WAIT_MAX.
+		/// @param[in] timeout_ms - poll timeout, -1 to wait forever.
+		static void wait_any(spsc_ring_t* const* rings, size_t count, int timeout_ms = -1)
+		{
+			struct pollfd pfds[SPSC_RING_WAIT_MAX];
+			if(count > SPSC_RING_WAIT_MAX)
+				count = SPSC_RING_WAIT_MAX;
+
+			for(size_t i = 0; i < count; i++)
+				rings[i]->waiting_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			bool empty = true;
+			for(size_t i = 0; i < count && empty; i++)
+			{
+				size_t head = rings[i]->head_.load(std::memory_order_acquire);
+				empty = rings[i]->slots_[head & rings[i]->mask_].seq.load(std::memory_order_acquire) != head + 1;
+			}
+
+			for(size_t i = 0; i < count; i++)
+				pfds[i] = {rings[i]->event_fd_, POLLIN, 0};
+			::poll(pfds, count, empty ? timeout_ms : 0);
+
+			for(size_t i = 0; i < count; i++)
+			{
+				rings[i]->waiting_.store(false, std::memory_order_relaxed);
+				uint64_t value;
+				if((pfds[i].revents & POLLIN) && ::read(rings[i]->event_fd_, &value, sizeof(value)) < 0)
+					{continue;}
+			}
+		}
+	};
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_LEVELS 4
+/// @brief Farthest expiration, in ticks, farther ones are clamped to it.
+#define TIMER_WHEEL_MAX_DELTA ((1ull << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+namespace utils
+{
+	/// @brief Hierarchical timer wheel, in ticks of a unit chosen by the caller.
+	///
+	/// Level 0 has a slot per tick for the next 64 ticks, each higher level has
+	/// slots 64 times wider. Timers are added and expired in O(1), a timer of
+	/// a higher level is moved down when the wheel reaches its slot. Not thread
+	/// safe, the caller serializes accesses.
+	template <typename T>
+	class timer_wheel_t
+	{
+	private:
+		struct entry_t
+		{
+			uint64_t expiry;
+			T value;
+		};
+
+		std::vector<entry_t> slots_[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; ///< slots_ - timers by level and slot.
+		uint64_t now_ = 0; ///< now_ - last tick reached by advance().
+		size_t count_ = 0; ///< count_ - number of timers in the wheel.
+
+		static unsigned int slot_index(uint64_t tick, int level)
+		{
+			return (tick >> (TIMER_WHEEL_SLOT_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+		}
+
+		/// @brief Put a timer in the level matching its distance, expiry isn't before now_.
+		void insert(entry_t&& entry)
+		{
+			uint64_t delta = entry.expiry - now_;
+			int level = 0;
+			while(level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ull << (TIMER_WHEEL_SLOT_BITS * (level + 1))))
+				level++;
+			slots_[level][slot_index(entry.expiry, level)].push_back(std::move(entry));
+		}
+
+		/// @brief Move timers of the current slot of a level to lower levels.
+		void cascade(int level)
+		{
+			std::vector<entry_t> entries;
+			entries.swap(slots_[level][slot_index(now_, level)]);
+			for(entry_t& entry : entries)
+				insert(std::move(entry));
+		}
+
+	public:
+		bool empty() const
+		{
+			return count_ == 0;
+		}
+
+		size_t size() const
+		{
+			return count_;
+		}
+
+		uint64_t now() const
+		{
+			return now_;
+		}
+
+		/// @brief Add a timer.
+		///
+		/// @param[in] expiry - tick at which the timer expires, a past tick expires at the next one.
+		/// @param[in] value - value given back at expiration.
+		void add(uint64_t expiry, const T& value)
+		{
+			if(expiry <= now_)
+				expiry = now_ + 1;
+			else if(expiry - now_ > TIMER_WHEEL_MAX_DELTA)
+				expiry = now_ + TIMER_WHEEL_MAX_DELTA;
+			insert(entry_t{expiry, value});
+			count_++;
+		}
+
+		/// @brief Remove timers whose value matches a predicate. It goes through
+		/// all slots, to be used for cancellations, not on each expiration.
+		///
+		/// @return number of timers removed.
+		template <typename P>
+		size_t remove_if(P pred)
+		{
+			size_t removed = 0;
+			for(auto& level : slots_)
+			{
+				for(auto& slot : level)
+				{
+					auto it = std::remove_if(slot.begin(), slot.end(), [&pred](const entry_t& entry){ return pred(entry.value); });
+					removed += slot.end() - it;
+					slot.erase(it, slot.end());
+				}
+			}
+			count_ -= removed;
+			return removed;
+		}
+
+		/// @brief Return a tick not after the next expiration, UINT64_MAX if the
+		/// wheel is empty. It is exact for timers already moved to level 0, else
+		/// it is the tick where the slot of the nearest one is cascaded.
+		uint64_t next_expiry() const
+		{
+			if(count_ == 0)
+				return UINT64_MAX;
+
+			uint64_t next = UINT64_MAX;
+			for(uint64_t tick = now_ + 1; tick < now_ + TIMER_WHEEL_SLOTS; tick++)
+			{
+				if(! slots_[0][slot_index(tick, 0)].empty())
+				{
+					next = tick;
+					break;
+				}
+			}
+
+			// Timers of higher levels expire at best when their slot is cascaded.
+			for(int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+			{
+				uint64_t width = 1ull << (TIMER_WHEEL_SLOT_BITS * level);
+				uint64_t base = (now_ + width) & ~(width - 1);
+				for(int i = 0; i < TIMER_WHEEL_SLOTS; i++)
+				{
+					uint64_t tick = base + i * width;
+					if(! slots_[level][slot_index(tick, level)].empty())
+					{
+						next = std::min(next, tick);
+						break;
+					}
+				}
+			}
+			return next;
+		}
+
+		/// @brief Move the wheel up to a tick, calling a function with the value
+		/// of each expired timer. The function may add timers.
+		///
+		/// @param[in] tick - tick reached, the wheel doesn't go back.
+		/// @param[in] expire - function called with each expired value.
+		template <typename F>
+		void advance(uint64_t tick, F expire)
+		{
+			if(count_ == 0 && tick > now_)
+				now_ = tick;
+
+			while(now_ < tick)
+			{
+				now_++;
+				for(int level = 1; level < TIMER_WHEEL_LEVELS && slot_index(now_, level - 1) == 0; level++)
+					cascade(level);
+
+				std::vector<entry_t> expired;
+				expired.swap(slots_[0][slot_index(now_, 0)]);
+				count_ -= expired.size();
+				for(entry_t& entry : expired)
+					expire(entry.value);
+			}
+		}
+	};
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "../binding/low-can-hat.hpp"
+
+namespace utils
+{
+	std::atomic<int> tracer_t::level_{0};
+
+	static const char* trace_point_name(trace_point_t point)
+	{
+		switch(point)
+		{
+			case trace_point_t::BCM_READ:
+				return "bcm read";
+			case trace_point_t::NEXT_CAN_MESSAGE:
+				return "next can message";
+			case trace_point_t::SIGNAL_DECODED:
+				return "signal decoded";
+		}
+		return "unknown";
+	}
+
+	tracer_t& tracer_t::instance()
+	{
+		static tracer_t tracer;
+		return tracer;
+	}
+
+	tracer_t::~tracer_t()
+	{
+		level_.store(0, std::memory_order_relaxed);
+		if(header_)
+			{::munmap(header_, mapped_size_);}
+	}
+
+	/// @brief Enable traces, must be called at initialization, before CAN
+	/// messages are read.
+	///
+	/// @param[in] level - "frames", "signals" or "none". Levels above LOW_CAN_TRACE_LEVEL
+	///  are accepted but don't trace anything.
+	/// @param[in] file - file to map the ring of records from, it is truncated. Traces
+	///  are logged if it is empty.
+	/// @param[in] records - number of records of the ring.
+	///
+	/// @return 0 if ok, -1 if the level is unknown or the file can't be mapped.
+	int tracer_t::configure(const std::string& level, const std::string& file, size_t records)
+	{
+		trace_level_t trace_level;
+		if(level.empty() || level == "none")
+			trace_level = trace_level_t::NONE;
+		else if(level == "frames")
+			trace_level = trace_level_t::FRAMES;
+		else if(level == "signals")
+			trace_level = trace_level_t::SIGNALS;
+		else
+		{
+			AFB_ERROR("Unknown trace level %s, use none, frames or signals", level.c_str());
+			return -1;
+		}
+
+		if(trace_level == trace_level_t::NONE)
+			return 0;
+		if(! trace_compiled(LOW_CAN_TRACE_LEVEL, trace_level))
+			{AFB_WARNING("Trace level %s isn't compiled in, rebuild with LOW_CAN_TRACE_LEVEL=%d", level.c_str(), (int)trace_level);}
+
+		if(! file.empty() && records)
+		{
+			size_t size = sizeof(trace_file_header_t) + records * sizeof(trace_record_t);
+			int fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if(fd < 0 || ::ftruncate(fd, size) < 0)
+			{
+				AFB_ERROR("Can't create trace file %s: %s", file.c_str(), ::strerror(errno));
+				if(fd >= 0)
+					{::close(fd);}
+				return -1;
+			}
+
+			void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+			if(map == MAP_FAILED)
+			{
+				AFB_ERROR("Can't map trace file %s: %s", file.c_str(), ::strerror(errno));
+				return -1;
+			}
+
+			header_ = (trace_file_header_t*)map;
+			records_ = (trace_record_t*)(header_ + 1);
+			mapped_size_ = size;
+			::memcpy(header_->magic, TRACE_FILE_MAGIC, sizeof(header_->magic));
+			header_->version = TRACE_FILE_VERSION;
+			header_->record_size = sizeof(trace_record_t);
+			header_->capacity = records;
+			header_->head = 0;
+		}
+
+		level_.store((int)trace_level, std::memory_order_release);
+		AFB_NOTICE("Tracing %s to %s", level.c_str(), header_ ? file.c_str() : "the log");
+		return 0;
+	}
+
+	/// @brief Claim the next record of the ring and mark it as being written.
+	///
+	/// @param[out] seq - value of seq to publish the record with.
+	trace_record_t& tracer_t::claim(trace_point_t point, uint32_t id, uint64_t& seq)
+	{
+		uint64_t index = __atomic_fetch_add(&header_->head, 1, __ATOMIC_RELAXED);
+		trace_record_t& record = records_[index % header_->capacity];
+		seq = index + 1;
+		__atomic_store_n(&record.seq, 0, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+
+		record.timestamp = monotonic_ns();
+		record.id = id;
+		record.ifindex = 0;
+		record.point = (uint16_t)point;
+		record.length = 0;
+		record.reserved = 0;
+		record.bit_position = 0;
+		record.reserved2 = 0;
+		return record;
+	}
+
+	/// @brief Publish a record filled after claim().
+	void tracer_t::release(trace_record_t& record, uint64_t seq)
+	{
+		__atomic_store_n(&record.seq, seq, __ATOMIC_RELEASE);
+	}
+
+	/// @brief Trace a CAN frame.
+	///
+	/// @param[in] point - where the frame is.
+	/// @param[in] ifindex - CAN device interface index.
+	/// @param[in] id - CAN ID.
+	/// @param[in] data - payload of at least 8 bytes, only the first 8 ones are stored in a record.
+	/// @param[in] length - payload length.
+	void tracer_t::frame(trace_point_t point, int ifindex, uint32_t id, const uint8_t* data, uint8_t length)
+	{
+		if(! header_)
+		{
+			AFB_DEBUG("%s: ifindex %d, id %X, length %u, data %02X%02X%02X%02X%02X%02X%02X%02X", trace_point_name(point), ifindex, id, length,
+				data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7]);
+			return;
+		}
+
+		uint64_t seq;
+		trace_record_t& record = claim(point, id, seq);
+		record.ifindex = ifindex;
+		record.length = length;
+		::memcpy(record.data, data, sizeof(record.data));
+		release(record, seq);
+	}
+
+	/// @brief Trace a decoded signal value.
+	///
+	/// @param[in] point - where the value is.
+	/// @param[in] id - CAN ID of the message of the signal.
+	/// @param[in] bit_position - bit position of the signal in its message.
+	/// @param[in] value - decoded value.
+	/// @param[in] name - signal name, only logged.
+	void tracer_t::value(trace_point_t point, uint32_t id, uint16_t bit_position, float value, const std::string& name)
+	{
+		if(! header_)
+		{
+			AFB_DEBUG("%s: %s, id %X, bit position %u, value %f", trace_point_name(point), name.c_str(), id, bit_position, value);
+			return;
+		}
+
+		uint64_t seq;
+		trace_record_t& record = claim(point, id, seq);
+		record.bit_position = bit_position;
+		::memset(record.data, 0, sizeof(record.data));
+		::memcpy(record.data, &value, sizeof(value));
+		release(record, seq);
+	}
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+/// @brief Highest trace level compiled in the frame path, 0 removes every trace
+/// point. Set with cmake -DLOW_CAN_TRACE_LEVEL=n.
+#ifndef LOW_CAN_TRACE_LEVEL
+#define LOW_CAN_TRACE_LEVEL 0
+#endif
+
+#define TRACE_FILE_MAGIC "LOWCANTR"
+#define TRACE_FILE_VERSION 1
+#define TRACE_RECORDS_DEFAULT 65536
+
+/// @brief Run a trace statement if its level is compiled in and enabled at
+/// runtime. Nothing of the statement, its arguments included, is evaluated
+/// otherwise: a level above LOW_CAN_TRACE_LEVEL is removed by the compiler,
+/// else it costs a relaxed load and a branch predicted not taken.
+///
+/// @param[in] level - a utils::trace_level_t.
+/// @param[in] ... - statement calling utils::tracer_t methods.
+#define LOW_CAN_TRACE(level, ...) \
+	do { \
+		if(utils::trace_compiled(LOW_CAN_TRACE_LEVEL, level) && __builtin_expect(utils::tracer_t::enabled(level), 0)) \
+			{__VA_ARGS__;} \
+	} while(0)
+
+namespace utils
+{
+	/// @brief Trace levels, each one includes the previous ones.
+	enum class trace_level_t : int {
+		NONE = 0, ///< NONE - no trace.
+		FRAMES = 1, ///< FRAMES - CAN frames read and handed to decoders.
+		SIGNALS = 2 ///< SIGNALS - signal values decoded.
+	};
+
+	constexpr bool trace_compiled(int compiled_level, trace_level_t level)
+	{
+		return compiled_level >= (int)level;
+	}
+
+	/// @brief Where a trace record comes from.
+	enum class trace_point_t : uint16_t {
+		BCM_READ = 1, ///< BCM_READ - frame read on a BCM socket.
+		NEXT_CAN_MESSAGE = 2, ///< NEXT_CAN_MESSAGE - CAN message taken by a decoder.
+		SIGNAL_DECODED = 3 ///< SIGNAL_DECODED - signal value extracted from a CAN message.
+	};
+
+	/// @brief Head of a binary trace file, followed by its records. Fields are
+	/// in host byte order.
+	struct trace_file_header_t
+	{
+		char magic[8]; ///< magic - TRACE_FILE_MAGIC, without terminating nul.
+		uint32_t version; ///< version - TRACE_FILE_VERSION.
+		uint32_t record_size; ///< record_size - sizeof(trace_record_t).
+		uint64_t capacity; ///< capacity - number of records of the ring.
+		uint64_t head; ///< head - number of records ever written, the last one is at (head - 1) % capacity.
+	};
+
+	/// @brief A binary trace record. seq is cleared while the record is written,
+	/// then set to its index in the trace plus one: a reader skips records whose
+	/// seq doesn't match their slot.
+	struct trace_record_t
+	{
+		uint64_t seq; ///< seq - index of the record plus one, 0 if being written.
+		uint64_t timestamp; ///< timestamp - CLOCK_MONOTONIC time in nanoseconds.
+		uint32_t id; ///< id - CAN ID.
+		int32_t ifindex; ///< ifindex - CAN device interface index, 0 if unknown.
+		uint16_t point; ///< point - a trace_point_t.
+		uint8_t length; ///< length - payload length of a frame.
+		uint8_t reserved;
+		uint16_t bit_position; ///< bit_position - bit position of a decoded signal.
+		uint16_t reserved2;
+		uint8_t data[8]; ///< data - first bytes of a frame payload, or the float value of a decoded signal.
+	};
+
+	/// @brief Trace sink of the frame path, enabled at runtime at a given level.
+	///
+	/// Traces go to the binding log at debug level, or are stored without any
+	/// formatting in a ring of records mapped from a file, to be read while the
+	/// binding runs or after it stopped. Producers claim records with an atomic
+	/// increment, older records are overwritten once the ring is full.
+	class tracer_t
+	{
+	private:
+		static std::atomic<int> level_; ///< level_ - trace level enabled at runtime.
+
+		trace_file_header_t* header_ = nullptr; ///< header_ - mapped trace file, nullptr to log traces.
+		trace_record_t* records_ = nullptr; ///< records_ - ring of records following the header.
+		size_t mapped_size_ = 0; ///< mapped_size_ - size of the mapping.
+
+		tracer_t() = default;
+		trace_record_t& claim(trace_point_t point, uint32_t id, uint64_t& seq);
+		void release(trace_record_t& record, uint64_t seq);
+
+	public:
+		static tracer_t& instance();
+		tracer_t(const tracer_t&) = delete;
+		~tracer_t();
+
+		static bool enabled(trace_level_t level)
+		{
+			return level_.load(std::memory_order_relaxed) >= (int)level;
+		}
+
+		int configure(const std::string& level, const std::string& file, size_t records);
+
+		void frame(trace_point_t point, int ifindex, uint32_t id, const uint8_t* data, uint8_t length);
+		void value(trace_point_t point, uint32_t id, uint16_t bit_position, float value, const std::string& name);
+	};
+}
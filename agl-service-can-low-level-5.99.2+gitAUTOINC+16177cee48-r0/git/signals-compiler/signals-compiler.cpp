@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// Offline compiler of JSON signals descriptions, the ones given to the
+/// low-can generator, into a binary signals database the binding maps at init
+/// in place of its generated signals (see "signals-database" option).
+///
+/// Each JSON file becomes a message set, in the order given. Custom decoders
+/// and handlers written in C++ can't be referenced by a database, signals
+/// using them are rejected.
+///
+/// Usage: signals-compiler -o signals.lcdb signals.json...
+
+#include <map>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <json-c/json.h>
+
+#include "../low-can-binding/utils/signals-database.hpp"
+
+/// @brief Database being built, tables are written as is.
+struct database_builder_t
+{
+	std::vector<sdb_message_set_t> message_sets;
+	std::vector<sdb_message_t> messages;
+	std::vector<sdb_signal_t> signals;
+	std::vector<sdb_state_t> states;
+	std::vector<sdb_diagnostic_t> diagnostics;
+	std::string strings;
+	std::map<std::string, uint32_t> interned; ///< interned - strings already in the pool with their offset.
+
+	uint32_t intern(const std::string& str)
+	{
+		auto it = interned.find(str);
+		if(it != interned.end())
+			return it->second;
+		uint32_t offset = (uint32_t)strings.size();
+		strings.append(str).push_back('\0');
+		interned[str] = offset;
+		return offset;
+	}
+};
+
+static json_object* get_key(json_object* obj, const char* key)
+{
+	json_object* value = nullptr;
+	if(! obj || ! json_object_object_get_ex(obj, key, &value))
+		return nullptr;
+	return value;
+}
+
+static double get_number(json_object* obj, const char* key, double default_value)
+{
+	json_object* value = get_key(obj, key);
+	return value ? json_object_get_double(value) : default_value;
+}
+
+static bool get_bool(json_object* obj, const char* key, bool default_value)
+{
+	json_object* value = get_key(obj, key);
+	return value ? json_object_get_boolean(value) != 0 : default_value;
+}
+
+static std::string get_string(json_object* obj, const char* key, const std::string& default_value)
+{
+	json_object* value = get_key(obj, key);
+	return value ? json_object_get_string(value) : default_value;
+}
+
+/// @brief Map a decoder name, as written for the generator, to a database decoder.
+///
+/// @return the decoder or SDB_DECODER_MAX if it is a custom one.
+static uint8_t parse_decoder(const std::string& name)
+{
+	static const std::map<std::string, uint8_t> decoders = {
+		{"", SDB_DECODER_DEFAULT},
+		{"decoder_t::decode_state", SDB_DECODER_STATE},
+		{"decoder_t::stateDecoder", SDB_DECODER_STATE},
+		{"stateDecoder", SDB_DECODER_STATE},
+		{"decoder_t::decode_boolean", SDB_DECODER_BOOLEAN},
+		{"decoder_t::booleanDecoder", SDB_DECODER_BOOLEAN},
+		{"booleanDecoder", SDB_DECODER_BOOLEAN},
+		{"decoder_t::decode_ignore", SDB_DECODER_IGNORE},
+		{"decoder_t::ignoreDecoder", SDB_DECODER_IGNORE},
+		{"ignoreDecoder", SDB_DECODER_IGNORE},
+		{"decoder_t::decode_noop", SDB_DECODER_NOOP},
+		{"decoder_t::noopDecoder", SDB_DECODER_NOOP},
+		{"noopDecoder", SDB_DECODER_NOOP},
+		{"decoder_t::decode_obd2_response", SDB_DECODER_OBD2}
+	};
+	auto it = decoders.find(name);
+	return it != decoders.end() ? it->second : SDB_DECODER_MAX;
+}
+
+static int compile_signal(database_builder_t& db, const char* key, json_object* jsig, uint32_t id, unsigned int payload_bits)
+{
+	sdb_signal_t sig;
+	std::memset(&sig, 0, sizeof(sig));
+
+	std::string name = get_string(jsig, "generic_name", key);
+	std::string decoder = get_string(jsig, "decoder", "");
+	sig.decoder = parse_decoder(decoder);
+	if(sig.decoder == SDB_DECODER_MAX || sig.decoder == SDB_DECODER_OBD2)
+	{
+		std::fprintf(stderr, "0x%X %s: custom decoder %s needs the generated code\n", id, name.c_str(), decoder.c_str());
+		return -1;
+	}
+	if(get_key(jsig, "encoder"))
+	{
+		std::fprintf(stderr, "0x%X %s: custom encoder needs the generated code\n", id, name.c_str());
+		return -1;
+	}
+
+	sig.name = db.intern(name);
+	sig.bit_position = (uint16_t)get_number(jsig, "bit_position", 0);
+	sig.bit_size = (uint8_t)get_number(jsig, "bit_size", 0);
+	sig.factor = (float)get_number(jsig, "factor", 1);
+	sig.offset = (float)get_number(jsig, "offset", 0);
+	sig.min_value = (float)get_number(jsig, "min_value", 0);
+	sig.max_value = (float)get_number(jsig, "max_value", 0);
+	sig.frequency = (float)get_number(jsig, "max_frequency", 0);
+	if(get_bool(jsig, "send_same", true))
+		sig.flags |= SDB_SIGNAL_SEND_SAME;
+	if(get_bool(jsig, "force_send_changed", false))
+		sig.flags |= SDB_SIGNAL_FORCE_SEND_CHANGED;
+	if(get_bool(jsig, "writable", false))
+		sig.flags |= SDB_SIGNAL_WRITABLE;
+	if(sig.bit_size == 0 || sig.bit_size > 64 || (unsigned int)sig.bit_position + sig.bit_size > payload_bits)
+	{
+		std::fprintf(stderr, "0x%X %s: bad bit position %u or size %u\n", id, name.c_str(), sig.bit_position, sig.bit_size);
+		return -1;
+	}
+
+	// States are written as "NAME": [values...].
+	sig.first_state = (uint32_t)db.states.size();
+	json_object* jstates = get_key(jsig, "states");
+	if(jstates)
+	{
+		json_object_object_foreach(jstates, state_name, jvalues)
+		{
+			for(size_t i = 0; i < json_object_array_length(jvalues); i++)
+			{
+				sdb_state_t state;
+				state.name = db.intern(state_name);
+				state.value = (uint32_t)json_object_get_int(json_object_array_get_idx(jvalues, i));
+				db.states.push_back(state);
+			}
+		}
+	}
+	sig.state_count = (uint32_t)db.states.size() - sig.first_state;
+
+	db.signals.push_back(sig);
+	return 0;
+}
+
+static int compile_message(database_builder_t& db, const char* key, json_object* jmsg)
+{
+	sdb_message_t msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.id = (uint32_t)std::strtoul(key, nullptr, 0);
+	msg.bus = db.intern(get_string(jmsg, "bus", ""));
+	msg.frequency = (float)get_number(jmsg, "max_frequency", 5);
+	if(get_bool(jmsg, "is_extended", msg.id > 0x7FF))
+		msg.flags |= SDB_MESSAGE_EXTENDED;
+	if(get_bool(jmsg, "force_send_changed", true))
+		msg.flags |= SDB_MESSAGE_FORCE_SEND_CHANGED;
+	if(get_bool(jmsg, "is_fd", false))
+		msg.flags |= SDB_MESSAGE_FD;
+	if(get_bool(jmsg, "bit_rate_switch", false))
+		msg.flags |= SDB_MESSAGE_BIT_RATE_SWITCH;
+	unsigned int payload_bits = (msg.flags & SDB_MESSAGE_FD ? 64 : 8) * 8;
+	if(get_key(jmsg, "handlers"))
+		std::fprintf(stderr, "0x%X: message handlers need the generated code, ignored\n", msg.id);
+
+	msg.first_signal = (uint32_t)db.signals.size();
+	json_object* jsignals = get_key(jmsg, "signals");
+	if(jsignals)
+	{
+		json_object_object_foreach(jsignals, sig_key, jsig)
+		{
+			if(! get_bool(jsig, "enabled", true))
+				continue;
+			if(compile_signal(db, sig_key, jsig, msg.id, payload_bits) < 0)
+				return -1;
+		}
+	}
+	msg.signal_count = (uint32_t)db.signals.size() - msg.first_signal;
+
+	db.messages.push_back(msg);
+	return 0;
+}
+
+static int compile_diagnostic(database_builder_t& db, json_object* jdiag)
+{
+	sdb_diagnostic_t diag;
+	std::memset(&diag, 0, sizeof(diag));
+
+	std::string name = get_string(jdiag, "name", "");
+	std::string decoder = get_string(jdiag, "decoder", "");
+	diag.decoder = parse_decoder(decoder);
+	if(name.empty() || (diag.decoder != SDB_DECODER_DEFAULT && diag.decoder != SDB_DECODER_OBD2))
+	{
+		std::fprintf(stderr, "diagnostic message pid %d: unnamed or with custom decoder %s, ignored\n",
+			(int)get_number(jdiag, "pid", 0), decoder.c_str());
+		return 0;
+	}
+
+	diag.name = db.intern(name);
+	diag.pid = (uint8_t)get_number(jdiag, "pid", 0);
+	diag.frequency = (float)get_number(jdiag, "frequency", 0);
+	diag.min = (int32_t)get_number(jdiag, "min", 0);
+	diag.max = (int32_t)get_number(jdiag, "max", 0);
+	diag.unit = (uint8_t)get_number(jdiag, "unit", 10); // UNIT::INVALID
+	if(get_bool(jdiag, "supported", true))
+		diag.flags |= SDB_DIAGNOSTIC_SUPPORTED;
+
+	db.diagnostics.push_back(diag);
+	return 0;
+}
+
+static int compile_file(database_builder_t& db, const char* path)
+{
+	std::ifstream in(path);
+	std::stringstream content;
+	content << in.rdbuf();
+	json_object* root = in ? json_tokener_parse(content.str().c_str()) : nullptr;
+	if(! root)
+	{
+		std::fprintf(stderr, "%s: can't read JSON signals description\n", path);
+		return -1;
+	}
+
+	sdb_message_set_t set;
+	std::memset(&set, 0, sizeof(set));
+	set.name = db.intern(get_string(root, "name", path));
+
+	int ret = 0;
+	set.first_message = (uint32_t)db.messages.size();
+	json_object* jmessages = get_key(root, "messages");
+	if(jmessages)
+	{
+		json_object_object_foreach(jmessages, msg_key, jmsg)
+		{
+			if(! get_bool(jmsg, "enabled", true))
+				continue;
+			if((ret = compile_message(db, msg_key, jmsg)) < 0)
+				break;
+		}
+	}
+	set.message_count = (uint32_t)db.messages.size() - set.first_message;
+
+	set.first_diagnostic = (uint32_t)db.diagnostics.size();
+	json_object* jdiags = get_key(root, "diagnostic_messages");
+	for(size_t i = 0; ret == 0 && jdiags && i < json_object_array_length(jdiags); i++)
+		ret = compile_diagnostic(db, json_object_array_get_idx(jdiags, i));
+	set.diagnostic_count = (uint32_t)db.diagnostics.size() - set.first_diagnostic;
+
+	json_object_put(root);
+	if(ret < 0)
+	{
+		std::fprintf(stderr, "%s: compilation failed\n", path);
+		return -1;
+	}
+
+	db.message_sets.push_back(set);
+	std::printf("%s: message set %zu, %u messages, %u diagnostic messages\n",
+		path, db.message_sets.size() - 1, set.message_count, set.diagnostic_count);
+	return 0;
+}
+
+template <typename T>
+static uint32_t append_table(std::string& out, const std::vector<T>& table)
+{
+	uint32_t offset = (uint32_t)out.size();
+	out.append((const char*)table.data(), table.size() * sizeof(T));
+	return offset;
+}
+
+static int write_database(const database_builder_t& db, const char* path)
+{
+	sdb_header_t header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = SIGNALS_DATABASE_MAGIC;
+	header.version = SIGNALS_DATABASE_VERSION;
+	header.header_size = sizeof(sdb_header_t);
+	header.message_set_count = (uint32_t)db.message_sets.size();
+	header.message_count = (uint32_t)db.messages.size();
+	header.signal_count = (uint32_t)db.signals.size();
+	header.state_count = (uint32_t)db.states.size();
+	header.diagnostic_count = (uint32_t)db.diagnostics.size();
+
+	// Every table size is a multiple of 4, they all stay aligned.
+	std::string out(sizeof(header), '\0');
+	header.message_sets_offset = append_table(out, db.message_sets);
+	header.messages_offset = append_table(out, db.messages);
+	header.signals_offset = append_table(out, db.signals);
+	header.states_offset = append_table(out, db.states);
+	header.diagnostics_offset = append_table(out, db.diagnostics);
+	header.strings_offset = (uint32_t)out.size();
+	header.strings_size = (uint32_t)db.strings.size();
+	out.append(db.strings);
+	out.resize((out.size() + 3) & ~(size_t)3, '\0');
+	header.file_size = (uint32_t)out.size();
+	out.replace(0, sizeof(header), (const char*)&header, sizeof(header));
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(out.data(), out.size());
+	if(! file)
+	{
+		std::fprintf(stderr, "%s: can't write signals database\n", path);
+		return -1;
+	}
+	std::printf("%s: %u signals, %u states, %zu bytes of %zu strings, %zu bytes\n", path,
+		header.signal_count, header.state_count, db.strings.size(), db.interned.size(), out.size());
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* output = "signals.lcdb";
+	int opt;
+	while((opt = getopt(argc, argv, "o:h")) != -1)
+	{
+		if(opt != 'o')
+		{
+			std::printf("Usage: %s -o signals.lcdb signals.json...\n", argv[0]);
+			return 1;
+		}
+		output = optarg;
+	}
+
+	// The database is mapped as is, it is read by little endian targets only.
+	const uint32_t endian = 1;
+	if(*(const uint8_t*)&endian != 1 || optind >= argc)
+	{
+		std::fprintf(stderr, "Usage: %s -o signals.lcdb signals.json... (little endian hosts only)\n", argv[0]);
+		return 1;
+	}
+
+	database_builder_t db;
+	db.intern("");
+	for(int i = optind; i < argc; i++)
+	{
+		if(compile_file(db, argv[i]) < 0)
+			return 1;
+	}
+	return write_database(db, output) < 0 ? 1 : 0;
+}
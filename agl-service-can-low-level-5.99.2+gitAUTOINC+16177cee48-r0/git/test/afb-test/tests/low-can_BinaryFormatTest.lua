@@ -0,0 +1,132 @@
+--[[
+    Copyright (C) 2018 "IoT.bzh"
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+
+    NOTE: strict mode: every global variables should be prefixed by '_'
+--]]
+
+_AFT.setAfterEach(function()
+    os.execute("pkill canplayer")
+    os.execute("pkill linuxcan-canpla")
+end)
+
+local _b64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+
+-- Decode a base64 string into a table of bytes, nil if it isn't valid base64.
+local function _base64Decode(str)
+    if #str % 4 ~= 0 then
+        return nil
+    end
+    local bytes, bits, nbits = {}, 0, 0
+    for i = 1, #str do
+        local c = str:sub(i, i)
+        if c == "=" then
+            if i < #str - 1 then
+                return nil
+            end
+        else
+            local n = _b64:find(c, 1, true)
+            if not n then
+                return nil
+            end
+            bits = bits * 64 + (n - 1)
+            nbits = nbits + 6
+            if nbits >= 8 then
+                nbits = nbits - 8
+                local div = 2 ^ nbits
+                bytes[#bytes + 1] = math.floor(bits / div)
+                bits = bits % div
+            end
+        end
+    end
+    return bytes
+end
+
+-- Split length delimited frames, nil if a length prefix doesn't match the data.
+local function _splitFrames(bytes)
+    local frames, pos = {}, 1
+    while pos <= #bytes do
+        local len, shift = 0, 1
+        repeat
+            local b = bytes[pos]
+            if not b then
+                return nil
+            end
+            len = len + (b % 128) * shift
+            shift = shift * 128
+            pos = pos + 1
+        until b < 128
+        if len == 0 or pos + len - 1 > #bytes then
+            return nil
+        end
+        frames[#frames + 1] = { table.unpack(bytes, pos, pos + len - 1) }
+        pos = pos + len
+    end
+    return frames
+end
+
+-- Check an event holds from 1 to maxFrames SIMPLE VehicleMessages.
+local function _assertBinaryEvent(data, maxFrames)
+    _AFT.assertEquals(type(data), "string")
+    local bytes = _base64Decode(data)
+    _AFT.assertIsTrue(bytes ~= nil)
+    local frames = _splitFrames(bytes)
+    _AFT.assertIsTrue(frames ~= nil)
+    _AFT.assertIsTrue(#frames >= 1 and #frames <= maxFrames)
+    for _, frame in ipairs(frames) do
+        -- Field 1 "type" comes first, set to SIMPLE (2).
+        _AFT.assertEquals(frame[1], 8)
+        _AFT.assertEquals(frame[2], 2)
+    end
+end
+
+_AFT.testVerbStatusSuccess("low-can_subscribe_binary_batch_too_small", "low-can", "subscribe", { event = "messages.fuel.level.low", format = "binary", batch = 0 })
+_AFT.testVerbStatusSuccess("low-can_unsubscribe_binary_batch_too_small", "low-can", "unsubscribe", { event = "messages.fuel.level.low" })
+_AFT.testVerbStatusSuccess("low-can_subscribe_binary_batch_too_big", "low-can", "subscribe", { event = "messages.fuel.level.low", format = "binary", batch = 100000 })
+_AFT.testVerbStatusSuccess("low-can_unsubscribe_binary_batch_too_big", "low-can", "unsubscribe", { event = "messages.fuel.level.low" })
+_AFT.testVerbStatusSuccess("low-can_subscribe_unknown_format", "low-can", "subscribe", { event = "messages.fuel.level.low", format = "xml" })
+_AFT.testVerbStatusSuccess("low-can_unsubscribe_unknown_format", "low-can", "unsubscribe", { event = "messages.fuel.level.low" })
+
+_AFT.describe("Binary_format_one_value_by_event", function()
+    local api = "low-can"
+    local evt = "messages.engine.speed"
+
+    _AFT.addEventToMonitor(api .. "/" .. evt, function(eventName, data)
+        _assertBinaryEvent(data, 1)
+    end)
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt, format = "binary" })
+
+    local ret = os.execute("./var/replay_launcher.sh ./var/testFilter01pass.canreplay")
+    _AFT.assertIsTrue(ret)
+    _AFT.assertEvtReceived(api .. "/" .. evt, 1000000)
+
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt })
+end)
+
+_AFT.describe("Binary_format_batch", function()
+    local api = "low-can"
+    local evt = "messages.engine.speed"
+
+    _AFT.addEventToMonitor(api .. "/" .. evt, function(eventName, data)
+        _assertBinaryEvent(data, 16)
+    end)
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt, format = "binary", batch = 16 })
+
+    local ret = os.execute("./var/replay_launcher.sh ./var/testFilter01pass.canreplay")
+    _AFT.assertIsTrue(ret)
+    _AFT.assertEvtReceived(api .. "/" .. evt, 1000000)
+
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt })
+end)
@@ -0,0 +1,56 @@
+--[[
+    Copyright (C) 2018 "IoT.bzh"
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+
+    NOTE: strict mode: every global variables should be prefixed by '_'
+--]]
+
+local _frame = { can_id = 801, can_dlc = 2, can_data = { 1, 2 } }
+
+_AFT.testVerbStatusError("low-can_write_cyclic_no_args", "low-can", "write_cyclic", {})
+_AFT.testVerbStatusError("low-can_write_cyclic_no_interval", "low-can", "write_cyclic", { bus_name = "hs", frame = _frame })
+_AFT.testVerbStatusError("low-can_write_cyclic_unknown_bus", "low-can", "write_cyclic", { bus_name = "unknown", frame = _frame, interval = 100 })
+_AFT.testVerbStatusError("low-can_write_cyclic_frame_too_long", "low-can", "write_cyclic", { bus_name = "hs", frame = { can_id = 801, can_dlc = 9, can_data = { 1, 2, 3, 4, 5, 6, 7, 8, 9 } }, interval = 100 })
+_AFT.testVerbStatusError("low-can_write_cyclic_invalid_fd_length", "low-can", "write_cyclic", { bus_name = "hs", frame = { can_id = 801, can_dlc = 9, can_data = { 1, 2, 3, 4, 5, 6, 7, 8, 9 }, fd = true }, interval = 100 })
+_AFT.testVerbStatusError("low-can_write_cyclic_not_writable", "low-can", "write_cyclic", { signal_name = "engine.speed", signal_value = 1000, interval = 100 })
+_AFT.testVerbStatusError("low-can_stop_cyclic_no_args", "low-can", "stop_cyclic", {})
+_AFT.testVerbStatusError("low-can_stop_cyclic_not_installed", "low-can", "stop_cyclic", { bus_name = "hs", can_id = 802 })
+
+_AFT.describe("Cyclic_install_update_stop", function()
+    local api = "low-can"
+
+    _AFT.assertVerbStatusSuccess(api, "write_cyclic", { bus_name = "hs", frame = _frame, interval = 100 })
+    -- Without interval, only the frame of the installed transmission is replaced.
+    _AFT.assertVerbStatusSuccess(api, "write_cyclic", { bus_name = "hs", frame = { can_id = 801, can_dlc = 2, can_data = { 3, 4 } } })
+    _AFT.assertVerbStatusSuccess(api, "stop_cyclic", { bus_name = "hs", can_id = 801 })
+    _AFT.assertVerbStatusError(api, "stop_cyclic", { bus_name = "hs", can_id = 801 })
+end)
+
+_AFT.describe("Cyclic_frames_are_received", function()
+    local api = "low-can"
+    local evt = "engine.speed"
+
+    _AFT.addEventToMonitor(api .. "/" .. evt, function(eventName, data)
+        _AFT.assertEquals(data.name, evt)
+    end)
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt })
+
+    -- engine.speed is in the frames of CAN ID 0x3D9.
+    _AFT.assertVerbStatusSuccess(api, "write_cyclic", { bus_name = "hs", frame = { can_id = 985, can_dlc = 8, can_data = { 0, 0, 16, 0, 0, 0, 0, 0 } }, interval = 100, count = 5 })
+    _AFT.assertEvtReceived(api .. "/" .. evt, 1000000)
+
+    _AFT.assertVerbStatusSuccess(api, "stop_cyclic", { bus_name = "hs", can_id = 985 })
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt })
+end)
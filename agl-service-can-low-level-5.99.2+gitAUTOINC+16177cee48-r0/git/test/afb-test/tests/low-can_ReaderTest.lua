@@ -0,0 +1,69 @@
+--[[
+    Copyright (C) 2018 "IoT.bzh"
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+
+    NOTE: strict mode: every global variables should be prefixed by '_'
+--]]
+
+-- Subscriptions on signals of the same CAN ID. With reader="bus" in section
+-- CANbus-options they share one kernel job on the bus reader, which is merged
+-- when a subscription comes or goes, and frames are dispatched to each of
+-- them. With the default socket by subscription they are independent.
+
+_AFT.setAfterEach(function()
+    os.execute("pkill canplayer")
+    os.execute("pkill linuxcan-canpla")
+end)
+
+_AFT.describe("Reader_same_can_id_subscriptions", function()
+    local api = "low-can"
+    local evt1 = "messages.engine.speed"
+    local evt2 = "messages.fuel.level.low"
+
+    _AFT.addEventToMonitor(api .. "/" .. evt1, function(eventName, data)
+        _AFT.assertEquals(data.name, evt1)
+    end)
+    _AFT.addEventToMonitor(api .. "/" .. evt2, function(eventName, data)
+        _AFT.assertEquals(data.name, evt2)
+    end)
+    -- Different frequencies on one CAN ID, the shortest one is applied to the job.
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt1 })
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt2, filter = { frequency = 1 } })
+
+    local ret = os.execute("./var/replay_launcher.sh ./var/testFilter01pass.canreplay")
+    _AFT.assertIsTrue(ret)
+    _AFT.assertEvtGrpReceived({ api .. "/" .. evt1, api .. "/" .. evt2 }, 1000000)
+
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt2 })
+end)
+
+_AFT.describe("Reader_subscribe_on_a_running_job", function()
+    local api = "low-can"
+    local evt1 = "messages.engine.speed"
+    local evt2 = "messages.fuel.level"
+
+    -- evt1 is still subscribed, its job is updated for the new subscription.
+    _AFT.addEventToMonitor(api .. "/" .. evt2, function(eventName, data)
+        _AFT.assertIsTrue(data.name:find(evt2, 1, true) ~= nil)
+    end)
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt2 })
+
+    local ret = os.execute("./var/replay_launcher.sh ./var/testFilter01pass.canreplay")
+    _AFT.assertIsTrue(ret)
+    _AFT.assertEvtReceived(api .. "/" .. evt2, 1000000)
+
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt2 })
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt1 })
+end)
@@ -0,0 +1,43 @@
+--[[
+    Copyright (C) 2018 "IoT.bzh"
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+
+    NOTE: strict mode: every global variables should be prefixed by '_'
+--]]
+
+_AFT.setAfterEach(function()
+    os.execute("pkill canplayer")
+    os.execute("pkill linuxcan-canpla")
+end)
+
+_AFT.testVerbStatusError("low-can_snapshot_unknown_signal", "low-can", "subscribe", { event = "unknown.signal", filter = { snapshot = 10 } })
+_AFT.testVerbStatusError("low-can_snapshot_diagnostic_only", "low-can", "subscribe", { event = "diagnostic_messages.engine.speed", filter = { snapshot = 10 } })
+
+_AFT.describe("Snapshot_grouped_event", function()
+    local api = "low-can"
+    local evt = "messages.engine.speed"
+
+    _AFT.addEventToMonitor(api .. "/" .. evt, function(eventName, data)
+        _AFT.assertEquals(data.name, evt)
+        _AFT.assertIsTrue(type(data.values) == "table")
+    end)
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt, filter = { snapshot = 10 } })
+
+    local ret = os.execute("./var/replay_launcher.sh ./var/testFilter01pass.canreplay")
+    _AFT.assertIsTrue(ret)
+    _AFT.assertEvtReceived(api .. "/" .. evt, 1000000)
+
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt, filter = { snapshot = 10 } })
+end)
@@ -0,0 +1,52 @@
+--[[
+    Copyright (C) 2018 "IoT.bzh"
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+
+    NOTE: strict mode: every global variables should be prefixed by '_'
+--]]
+
+_AFT.setAfterEach(function()
+    os.execute("pkill canplayer")
+    os.execute("pkill linuxcan-canpla")
+end)
+
+_AFT.testVerbStatusSuccess("low-can_stats", "low-can", "stats", {})
+_AFT.testVerbStatusSuccess("low-can_stats_unknown_arg", "low-can", "stats", { unknown = true })
+
+_AFT.describe("Stats_count_decoded_values", function()
+    local api = "low-can"
+    local evt = "messages.engine.speed"
+
+    _AFT.addEventToMonitor(api .. "/" .. evt, function(eventName, data)
+        _AFT.assertEquals(data.name, evt)
+    end)
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt })
+
+    local ret = os.execute("./var/replay_launcher.sh ./var/testFilter01pass.canreplay")
+    _AFT.assertIsTrue(ret)
+    _AFT.assertEvtReceived(api .. "/" .. evt, 1000000)
+
+    _AFT.assertVerbCb(api, "stats", {}, function(responseJ)
+        local decoded = 0
+        for _, sig in pairs(responseJ.response.signals) do
+            if sig.event == evt then
+                decoded = decoded + sig.decoded
+            end
+        end
+        _AFT.assertIsTrue(decoded > 0)
+    end)
+
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt })
+end)
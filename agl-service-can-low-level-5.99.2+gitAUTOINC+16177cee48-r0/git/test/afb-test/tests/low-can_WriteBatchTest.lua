@@ -0,0 +1,47 @@
+--[[
+    Copyright (C) 2018 "IoT.bzh"
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+
+    NOTE: strict mode: every global variables should be prefixed by '_'
+--]]
+
+_AFT.testVerbStatusError("low-can_write_batch_no_signals", "low-can", "write_batch", {})
+_AFT.testVerbStatusError("low-can_write_batch_not_an_array", "low-can", "write_batch", { signals = "engine.speed" })
+_AFT.testVerbStatusError("low-can_write_batch_malformed_signal", "low-can", "write_batch", { signals = { { signal_name = "engine.speed" } } })
+_AFT.testVerbStatusError("low-can_write_batch_unknown_signal", "low-can", "write_batch", { signals = { { signal_name = "unknown.signal", signal_value = 1 } } })
+
+_AFT.describe("Write_batch_nothing_sent_on_error", function()
+    local api = "low-can"
+    local evt = "engine.speed"
+
+    -- Signals of the tested configuration aren't writable, so the whole batch
+    -- is refused and no frame may reach the bus.
+    _AFT.addEventToMonitor(api .. "/" .. evt, function(eventName, data)
+        _AFT.assertEquals(data.name, evt)
+    end)
+    _AFT.assertVerbStatusSuccess(api, "subscribe", { event = evt })
+
+    _AFT.assertVerbStatusError(api, "write_batch", { signals = {
+        { signal_name = "engine.speed", signal_value = 1000 },
+        { signal_name = "unknown.signal", signal_value = 1 }
+    }})
+    _AFT.assertVerbStatusError(api, "write_batch", { signals = {
+        { signal_name = "engine.speed", signal_value = 1000 },
+        { signal_name = "fuel.level", signal_value = 50 }
+    }})
+    _AFT.assertEvtNotReceived(api .. "/" .. evt, 1000000)
+
+    _AFT.assertVerbStatusSuccess(api, "unsubscribe", { event = evt })
+end)
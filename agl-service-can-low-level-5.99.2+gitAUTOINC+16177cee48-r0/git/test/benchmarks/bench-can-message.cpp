@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// Micro benchmark of the receive to decode path of a CAN frame: conversion
+/// from the socket frame, push and pop through the CAN message ring then data
+/// access. It counts heap allocations made by frame.
+///
+/// Usage: bench-can-message [frames]
+
+#include <new>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../../low-can-binding/can/can-message.hpp"
+#include "../../low-can-binding/utils/spsc-ring.hpp"
+#include "../../low-can-binding/binding/low-can-hat.hpp"
+
+// Keep binding logging macros quiet, there is no daemon behind them.
+struct afb_binding_data_v2 afbBindingV2data = { -1 };
+
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = std::malloc(size ? size : 1);
+	if(p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+template <typename F>
+static void run(const char* name, long frames, F frame_path)
+{
+	uint64_t allocs = allocations.load();
+	auto start = std::chrono::steady_clock::now();
+
+	uint64_t sum = 0;
+	for(long i = 0; i < frames; i++)
+		sum += frame_path(i);
+
+	auto stop = std::chrono::steady_clock::now();
+	allocs = allocations.load() - allocs;
+	double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+
+	std::printf("%-16s %10ld frames %8.1f ns/frame %6.2f allocs/frame (checksum %llu)\n",
+		name, frames, ns / frames, (double)allocs / frames, (unsigned long long)sum);
+}
+
+int main(int argc, char* argv[])
+{
+	long frames = argc > 1 ? std::strtol(argv[1], nullptr, 0) : 1000000;
+	utils::spsc_ring_t<can_message_t> ring(4096);
+	can_message_t out;
+
+	struct can_frame frame;
+	::memset(&frame, 0, sizeof(frame));
+	frame.can_dlc = 8;
+
+	run("can_frame", frames, [&](long i) -> uint64_t {
+		frame.can_id = 0x100 + (i & 0x3F);
+		frame.data[0] = (uint8_t)i;
+		ring.push(can_message_t::convert_from_frame(frame, CAN_MTU, i));
+		ring.pop(out);
+		return out.get_id() + out.get_data()[0];
+	});
+
+	struct canfd_frame fd_frame;
+	::memset(&fd_frame, 0, sizeof(fd_frame));
+	fd_frame.len = 64;
+
+	run("canfd_frame", frames, [&](long i) -> uint64_t {
+		fd_frame.can_id = 0x100 + (i & 0x3F);
+		fd_frame.data[63] = (uint8_t)i;
+		ring.push(can_message_t::convert_from_frame(fd_frame, CANFD_MTU, i));
+		ring.pop(out);
+		return out.get_id() + out.get_data()[63];
+	});
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// Micro benchmark of the CAN signals extraction: each signal parsed from the
+/// payload by bitfield_parse_float, as before, against the message definition
+/// decode plan. Signal layouts are read from generated application files, both
+/// paths results are checked to be the same.
+///
+/// Usage: bench-decode-plan [frames] [application-generated.cpp...]
+
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+
+#include "canutil/read.h"
+#include "generated-layouts.hpp"
+#include "../../low-can-binding/binding/low-can-hat.hpp"
+
+// Keep binding logging macros quiet, there is no daemon behind them.
+struct afb_binding_data_v2 afbBindingV2data = { -1 };
+
+static void bench(const char* path, long frames)
+{
+	std::vector<message_layout_t> messages = load_layouts(path);
+	size_t signal_count = 0;
+	for(const auto& msg: messages)
+		signal_count += msg.signals.size();
+	if(signal_count == 0)
+	{
+		std::printf("%s: no CAN signals\n", path);
+		return;
+	}
+
+	// Random payloads, one per frame of a small pool to stay in cache.
+	std::mt19937_64 rng(42);
+	std::vector<can_message_t> payloads;
+	for(int i = 0; i < 256; i++)
+	{
+		uint8_t data[CAN_MESSAGE_SIZE];
+		uint64_t r = rng();
+		std::memcpy(data, &r, sizeof(data));
+		payloads.push_back(can_message_t(CAN_MESSAGE_SIZE, 0, CAN_MESSAGE_SIZE, can_message_format_t::STANDARD, false, 0, data, 0));
+	}
+
+	float values[DECODE_PLAN_MAX_SIGNALS];
+	size_t mismatches = 0;
+	for(const auto& msg: messages)
+	{
+		for(const auto& cm: payloads)
+		{
+			msg.plan.decode(cm, values);
+			for(size_t i = 0; i < msg.signals.size(); i++)
+			{
+				const signal_layout_t& sig = msg.signals[i];
+				float expected = bitfield_parse_float(cm.get_data(), CAN_MESSAGE_SIZE,
+					sig.bit_position, sig.bit_size, sig.factor, sig.offset);
+				if(std::memcmp(&expected, &values[i], sizeof(float)) != 0)
+				{
+					if(mismatches++ < 10)
+						std::printf("mismatch 0x%X %s: %f != %f\n", msg.id, sig.name.c_str(), expected, values[i]);
+				}
+			}
+		}
+	}
+
+	double sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(long f = 0; f < frames; f++)
+	{
+		const can_message_t& cm = payloads[f & 0xFF];
+		for(const auto& msg: messages)
+		{
+			for(const auto& sig: msg.signals)
+				sum += bitfield_parse_float(cm.get_data(), CAN_MESSAGE_SIZE,
+					sig.bit_position, sig.bit_size, sig.factor, sig.offset);
+		}
+	}
+	auto middle = std::chrono::steady_clock::now();
+	for(long f = 0; f < frames; f++)
+	{
+		const can_message_t& cm = payloads[f & 0xFF];
+		for(const auto& msg: messages)
+		{
+			msg.plan.decode(cm, values);
+			for(size_t i = 0; i < msg.signals.size(); i++)
+				sum += values[i];
+		}
+	}
+	auto stop = std::chrono::steady_clock::now();
+
+	double per_signal = std::chrono::duration<double, std::nano>(middle - start).count() / frames / signal_count;
+	double planned = std::chrono::duration<double, std::nano>(stop - middle).count() / frames / signal_count;
+	std::printf("%s: %zu messages, %zu signals, %zu mismatches\n", path, messages.size(), signal_count, mismatches);
+	std::printf("  bitfield_parse_float %8.2f ns/signal\n  decode plan          %8.2f ns/signal (x%.1f, checksum %g)\n",
+		per_signal, planned, per_signal / planned, sum);
+}
+
+int main(int argc, char* argv[])
+{
+	long frames = argc > 1 ? std::strtol(argv[1], nullptr, 0) : 1000000;
+	if(argc > 2)
+	{
+		for(int i = 2; i < argc; i++)
+			bench(argv[i], frames);
+	}
+	else
+	{
+		bench(EXAMPLES_DIR "/toyota/auris/application-generated.cpp", frames);
+		bench(EXAMPLES_DIR "/agl-vcar/application-generated.cpp", frames);
+		bench(EXAMPLES_DIR "/engine/application-generated.cpp", frames);
+		bench(EXAMPLES_DIR "/hvac/application-generated.cpp", frames);
+	}
+	return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// Contention benchmark of the subscription registry. A reader thread replays
+/// CAN frames at 5 kHz and looks up the subscription of each frame, as the
+/// decoding and pushing threads do, while a writer thread runs subscribe storms:
+/// 200 subscriptions made in one call then removed, each one costing some work
+/// like opening a socket and sending its RX_SETUP job.
+///
+/// The registry is either a map guarded by one mutex, held by the writer for
+/// the whole subscribe call, or a snapshot_t published once by call. Frame
+/// lookup latencies are reported for both.
+///
+/// Usage: bench-subscription-registry [seconds]
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "../../low-can-binding/utils/snapshot.hpp"
+
+#define STORM_SIZE 200
+#define SUBSCRIPTION_WORK_US 20
+#define FRAME_PERIOD_US 200
+
+typedef std::chrono::steady_clock bench_clock;
+typedef std::map<int, std::shared_ptr<int> > registry_t;
+
+static void busy_wait_us(int us)
+{
+	auto end = bench_clock::now() + std::chrono::microseconds(us);
+	while(bench_clock::now() < end)
+		{}
+}
+
+struct mutex_registry_t
+{
+	std::mutex mutex;
+	registry_t map;
+
+	bool lookup(int key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return map.find(key) != map.end();
+	}
+
+	void storm(int base)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for(int i = 0; i < STORM_SIZE; i++)
+			{
+				busy_wait_us(SUBSCRIPTION_WORK_US);
+				map[base + i] = std::make_shared<int>(i);
+			}
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		for(int i = 0; i < STORM_SIZE; i++)
+			map.erase(base + i);
+	}
+};
+
+struct snapshot_registry_t
+{
+	std::mutex writers_mutex;
+	registry_t map;
+	utils::snapshot_t<registry_t> snapshot;
+
+	bool lookup(utils::snapshot_reader_t<registry_t>& reader, int key)
+	{
+		const registry_t& m = reader.get();
+		return m.find(key) != m.end();
+	}
+
+	void storm(int base)
+	{
+		std::lock_guard<std::mutex> lock(writers_mutex);
+		for(int i = 0; i < STORM_SIZE; i++)
+		{
+			busy_wait_us(SUBSCRIPTION_WORK_US);
+			map[base + i] = std::make_shared<int>(i);
+		}
+		snapshot.publish(std::make_shared<const registry_t>(map));
+
+		for(int i = 0; i < STORM_SIZE; i++)
+			map.erase(base + i);
+		snapshot.publish(std::make_shared<const registry_t>(map));
+	}
+};
+
+template <typename Lookup, typename Storm>
+static void run(const char* name, double seconds, Lookup lookup, Storm storm)
+{
+	std::atomic<bool> running{true};
+	long storms = 0;
+
+	std::thread writer([&]() {
+		while(running)
+		{
+			storm(1000);
+			storms++;
+		}
+	});
+
+	std::vector<double> latencies;
+	long found = 0;
+	auto start = bench_clock::now();
+	auto next = start;
+	for(int frame = 0; bench_clock::now() - start < std::chrono::duration<double>(seconds); frame++)
+	{
+		next += std::chrono::microseconds(FRAME_PERIOD_US);
+		std::this_thread::sleep_until(next);
+
+		auto t0 = bench_clock::now();
+		found += lookup(frame % 64) ? 1 : 0;
+		latencies.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - t0).count());
+	}
+
+	running = false;
+	writer.join();
+
+	std::sort(latencies.begin(), latencies.end());
+	size_t n = latencies.size();
+	std::printf("%-10s %7zu frames %5ld storms  lookup us: p50 %8.2f  p99 %8.2f  p99.9 %8.2f  max %8.2f (found %ld)\n",
+		name, n, storms, latencies[n / 2], latencies[n * 99 / 100], latencies[n * 999 / 1000], latencies[n - 1], found);
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = argc > 1 ? std::atof(argv[1]) : 5.;
+
+	mutex_registry_t mr;
+	snapshot_registry_t sr;
+	for(int i = 0; i < 64; i++)
+	{
+		mr.map[i] = std::make_shared<int>(i);
+		sr.map[i] = std::make_shared<int>(i);
+	}
+	sr.snapshot.publish(std::make_shared<const registry_t>(sr.map));
+
+	run("mutex", seconds,
+		[&](int key) { return mr.lookup(key); },
+		[&](int base) { mr.storm(base); });
+
+	utils::snapshot_reader_t<registry_t> reader(sr.snapshot);
+	run("snapshot", seconds,
+		[&](int key) { return sr.lookup(reader, key); },
+		[&](int base) { sr.storm(base); });
+
+	return 0;
+}
@@ -0,0 +1,512 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// Deterministic replay of recorded CAN traces, candump log or .canreplay
+/// fixtures, through the same stages as can_bus_t: frames read on the event
+/// loop side are pushed into a CAN message ring, a decoding thread extracts
+/// signals with the message decode plans and pushes VehicleMessages into a
+/// vehicle message ring, a pushing thread builds and serializes each event.
+///
+/// Frames are injected in process, as if just read, or written on a virtual
+/// CAN device and read back through a BCM socket with -i. Reported figures are
+/// the throughput, the read to push latency percentiles, the CPU time spent per
+/// 1000 frames and the frames dropped at each stage.
+///
+/// Usage: bench-trace-replay [-s speedup] [-l loops] [-q queue-size]
+///	[-g application-generated.cpp] [-i vcan0] [trace...]
+///  -s: 1 replays at recorded speed, N N times faster, 0 as fast as possible (default).
+///  -l: number of times the traces are replayed, one after the other (default 1).
+///  -q: rings size (default 1024).
+///  -g: generated file giving the signals layout (default the binding one).
+///  -i: virtual CAN device to replay on, in process injection if not given.
+
+#include <map>
+#include <set>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <time.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <linux/can/raw.h>
+#include <json-c/json.h>
+
+#include "openxc.pb.h"
+#include "generated-layouts.hpp"
+#include "../../low-can-binding/utils/spsc-ring.hpp"
+#include "../../low-can-binding/utils/socketcan-bcm.hpp"
+#include "../../low-can-binding/binding/low-can-hat.hpp"
+
+// Keep binding logging macros quiet, there is no daemon behind them.
+struct afb_binding_data_v2 afbBindingV2data = { -1 };
+
+/// One frame of a trace, with its recorded timestamp in µs.
+struct trace_frame_t
+{
+	uint64_t timestamp;
+	bool fd;
+	struct canfd_frame frame;
+};
+
+struct replay_options_t
+{
+	double speedup = 0;
+	int loops = 1;
+	size_t queue_size = 1024;
+	std::string generated = GENERATED_FILE;
+	std::string device;
+	std::vector<std::string> traces;
+};
+
+/// Counters shared by the stages, each one written by a single thread.
+struct replay_stats_t
+{
+	std::atomic<uint64_t> injected{0}; ///< injected - frames written or pushed by the injector.
+	std::atomic<uint64_t> read{0}; ///< read - frames read back from the BCM socket.
+	std::atomic<uint64_t> decoded{0}; ///< decoded - frames taken out of the CAN message ring.
+	std::atomic<uint64_t> signals{0}; ///< signals - values pushed into the vehicle message ring.
+	std::atomic<uint64_t> pushed{0}; ///< pushed - events built and serialized.
+	std::atomic<uint64_t> bytes{0}; ///< bytes - serialized events size.
+	std::atomic<uint64_t> last_push{0}; ///< last_push - realtime µs of the last event.
+	std::vector<uint32_t> latencies; ///< latencies - read to push latency of each event, in µs, pushing thread only.
+};
+
+static uint64_t realtime_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t cpu_us()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+		+ usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/// Parse a candump log line: "(1520951000.000000) can0 7E8#04410C1FD0000000".
+/// Extended identifiers are written with 8 digits, CAN FD frames with "##" and
+/// a flags digit, remote frames with "R".
+static bool parse_trace_line(const std::string& line, trace_frame_t& tf)
+{
+	unsigned long sec, usec;
+	char iface[IFNAMSIZ + 1], frame[300];
+	if(std::sscanf(line.c_str(), " (%lu.%lu) %16s %299s", &sec, &usec, iface, frame) != 4)
+		return false;
+
+	char* hash = std::strchr(frame, '#');
+	if(! hash)
+		return false;
+
+	std::memset(&tf, 0, sizeof(tf));
+	tf.timestamp = (uint64_t)sec * 1000000 + usec;
+	tf.frame.can_id = (canid_t)std::strtoul(frame, nullptr, 16);
+	if(hash - frame > 3)
+		tf.frame.can_id |= CAN_EFF_FLAG;
+
+	const char* data = hash + 1;
+	if(*data == '#')
+	{
+		tf.fd = true;
+		tf.frame.flags = (uint8_t)std::strtoul(std::string(data + 1, 1).c_str(), nullptr, 16);
+		data += 2;
+	}
+	else if(*data == 'R')
+	{
+		tf.frame.can_id |= CAN_RTR_FLAG;
+		return true;
+	}
+
+	size_t max = tf.fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+	while(data[0] && data[1] && tf.frame.len < max)
+	{
+		if(data[0] == '.')
+		{
+			data++;
+			continue;
+		}
+		char byte[3] = {data[0], data[1], 0};
+		tf.frame.data[tf.frame.len++] = (uint8_t)std::strtoul(byte, nullptr, 16);
+		data += 2;
+	}
+	return true;
+}
+
+/// Load traces, a directory stands for all the .canreplay and .log files in it.
+static std::vector<trace_frame_t> load_traces(const std::vector<std::string>& paths)
+{
+	std::vector<std::string> files;
+	for(const auto& path: paths)
+	{
+		DIR* dir = opendir(path.c_str());
+		if(! dir)
+		{
+			files.push_back(path);
+			continue;
+		}
+		std::vector<std::string> entries;
+		while(struct dirent* entry = readdir(dir))
+		{
+			std::string name = entry->d_name;
+			size_t dot = name.rfind('.');
+			if(dot != std::string::npos && (name.substr(dot) == ".canreplay" || name.substr(dot) == ".log"))
+				entries.push_back(path + "/" + name);
+		}
+		closedir(dir);
+		std::sort(entries.begin(), entries.end());
+		files.insert(files.end(), entries.begin(), entries.end());
+	}
+
+	// Traces are replayed one after the other, each one shifted to start
+	// right after the previous one.
+	std::vector<trace_frame_t> frames;
+	uint64_t base = 0;
+	for(const auto& file: files)
+	{
+		std::ifstream in(file);
+		std::string line;
+		std::vector<trace_frame_t> trace;
+		trace_frame_t tf;
+		while(std::getline(in, line))
+		{
+			if(parse_trace_line(line, tf))
+				trace.push_back(tf);
+		}
+		if(trace.empty())
+		{
+			std::printf("%s: no CAN frames\n", file.c_str());
+			continue;
+		}
+
+		uint64_t first = trace.front().timestamp;
+		for(auto& f: trace)
+		{
+			f.timestamp = f.timestamp - first + base;
+			frames.push_back(f);
+		}
+		base = frames.back().timestamp + 1000;
+		std::printf("%s: %zu frames\n", file.c_str(), trace.size());
+	}
+	return frames;
+}
+
+/// Decoding thread, as can_bus_t::can_decode_message without subscription
+/// lookup: every signal of a known message is decoded and sent.
+static void decode_loop(utils::spsc_ring_t<can_message_t>& can_q,
+	utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage>>& vehicle_q,
+	const std::unordered_map<uint32_t, const message_layout_t*>& layouts,
+	replay_stats_t& stats, const std::atomic<bool>& running)
+{
+	float values[DECODE_PLAN_MAX_SIGNALS];
+	openxc_VehicleMessage vm;
+	std::memset(&vm, 0, sizeof(vm));
+	vm.has_type = true;
+	vm.type = openxc_VehicleMessage_Type::openxc_VehicleMessage_Type_SIMPLE;
+	vm.has_simple_message = true;
+	vm.simple_message.has_name = true;
+	vm.simple_message.has_value = true;
+	vm.simple_message.value.has_type = true;
+	vm.simple_message.value.type = openxc_DynamicField_Type::openxc_DynamicField_Type_NUM;
+	vm.simple_message.value.has_numeric_value = true;
+	vm.has_timestamp = true;
+
+	can_message_t cm;
+	while(running)
+	{
+		can_q.wait(100);
+		size_t sent = 0;
+		while(can_q.pop(cm))
+		{
+			stats.decoded.fetch_add(1, std::memory_order_relaxed);
+			auto it = layouts.find(cm.get_id());
+			if(it == layouts.end())
+				continue;
+
+			const message_layout_t& msg = *it->second;
+			msg.plan.decode(cm, values);
+			for(size_t i = 0; i < msg.signals.size(); i++)
+			{
+				::strncpy(vm.simple_message.name, msg.signals[i].name.c_str(), sizeof(vm.simple_message.name) - 1);
+				vm.simple_message.value.numeric_value = values[i];
+				vm.timestamp = cm.get_timestamp();
+				vehicle_q.push(std::make_pair((int)i, vm));
+			}
+			sent += msg.signals.size();
+		}
+		if(sent)
+		{
+			stats.signals.fetch_add(sent, std::memory_order_relaxed);
+			vehicle_q.notify();
+		}
+	}
+}
+
+/// Pushing thread, builds the JSON event as jsonify_vehicle and serializes it
+/// as the daemon does before sending it to clients.
+static void push_loop(utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage>>& vehicle_q,
+	replay_stats_t& stats, const std::atomic<bool>& running)
+{
+	std::pair<int, openxc_VehicleMessage> v_message;
+	while(running)
+	{
+		vehicle_q.wait(100);
+		while(vehicle_q.pop(v_message))
+		{
+			const openxc_VehicleMessage& vm = v_message.second;
+			json_object* jo = json_object_new_object();
+			json_object_object_add(jo, "name", json_object_new_string(vm.simple_message.name));
+			json_object_object_add(jo, "value", json_object_new_double(vm.simple_message.value.numeric_value));
+			json_object_object_add(jo, "timestamp", json_object_new_int64(vm.timestamp));
+			size_t len = std::strlen(json_object_to_json_string(jo));
+			json_object_put(jo);
+
+			uint64_t now = realtime_us();
+			stats.latencies.push_back(now > vm.timestamp ? (uint32_t)(now - vm.timestamp) : 0);
+			stats.bytes.fetch_add(len, std::memory_order_relaxed);
+			stats.pushed.fetch_add(1, std::memory_order_relaxed);
+			stats.last_push.store(now, std::memory_order_relaxed);
+		}
+	}
+}
+
+/// Event loop side of the virtual CAN replay, reads frames back through a BCM
+/// socket in batch, as can_bus_t read callback.
+static void read_loop(utils::socketcan_bcm_t& bcm, utils::spsc_ring_t<can_message_t>& can_q,
+	replay_stats_t& stats, const std::atomic<bool>& running)
+{
+	std::vector<can_message_t> vcm;
+	struct pollfd pfd = {bcm.socket(), POLLIN, 0};
+	while(running)
+	{
+		if(::poll(&pfd, 1, 100) <= 0)
+			continue;
+
+		vcm.clear();
+		bcm >> vcm;
+		for(const auto& cm: vcm)
+			can_q.push(cm);
+		stats.read.fetch_add(vcm.size(), std::memory_order_relaxed);
+		can_q.notify();
+	}
+}
+
+/// Open the virtual CAN device: a raw socket to write frames and a BCM socket
+/// receiving every frame of the trace identifiers.
+static int open_device(const std::string& device, const std::vector<trace_frame_t>& frames,
+	int& raw, utils::socketcan_bcm_t& bcm)
+{
+	raw = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	struct ifreq ifr;
+	std::memset(&ifr, 0, sizeof(ifr));
+	::strncpy(ifr.ifr_name, device.c_str(), IFNAMSIZ - 1);
+	if(raw < 0 || ::ioctl(raw, SIOCGIFINDEX, &ifr) < 0)
+	{
+		std::printf("%s: can't open CAN device, %s\n", device.c_str(), strerror(errno));
+		return -1;
+	}
+	struct sockaddr_can addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	const int fd_on = 1;
+	::setsockopt(raw, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &fd_on, sizeof(fd_on));
+	if(::bind(raw, (struct sockaddr*)&addr, sizeof(addr)) < 0 || bcm.open(device) < 0)
+	{
+		std::printf("%s: can't bind CAN device, %s\n", device.c_str(), strerror(errno));
+		return -1;
+	}
+
+	std::set<std::pair<canid_t, bool>> ids;
+	for(const auto& f: frames)
+		ids.insert(std::make_pair(f.frame.can_id & ~CAN_RTR_FLAG, f.fd));
+	for(const auto& id: ids)
+	{
+		struct bcm_msg_head head;
+		std::memset(&head, 0, sizeof(head));
+		head.opcode = RX_SETUP;
+		head.can_id = id.first;
+		head.flags = RX_FILTER_ID;
+#ifdef CAN_FD_FRAME
+		if(id.second)
+			head.flags |= CAN_FD_FRAME;
+#endif
+		bcm << head;
+	}
+	return 0;
+}
+
+static void report(const replay_options_t& options, replay_stats_t& stats,
+	utils::spsc_ring_t<can_message_t>& can_q,
+	utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage>>& vehicle_q,
+	uint64_t start, uint64_t cpu)
+{
+	uint64_t injected = stats.injected;
+	uint64_t elapsed = stats.last_push > start ? stats.last_push - start : 1;
+	char speedup[32] = "max";
+	if(options.speedup > 0)
+		std::snprintf(speedup, sizeof(speedup), "x%g", options.speedup);
+	std::printf("\n%s replay, speedup %s, %d loop(s), rings of %zu\n",
+		options.device.empty() ? "in process" : options.device.c_str(),
+		speedup, options.loops, can_q.capacity());
+	std::printf("  frames      %10llu injected, %llu decoded, %.0f frames/s\n",
+		(unsigned long long)injected, (unsigned long long)stats.decoded.load(), stats.decoded * 1e6 / elapsed);
+	std::printf("  events      %10llu pushed, %.0f events/s, %.1f bytes/event\n",
+		(unsigned long long)stats.pushed.load(), stats.pushed * 1e6 / elapsed,
+		stats.pushed ? (double)stats.bytes / stats.pushed : 0.);
+
+	std::vector<uint32_t>& lat = stats.latencies;
+	if(! lat.empty())
+	{
+		std::sort(lat.begin(), lat.end());
+		std::printf("  latency     %10u µs p50, %u µs p99, %u µs max\n",
+			lat[lat.size() / 2], lat[lat.size() * 99 / 100], lat.back());
+	}
+	std::printf("  cpu         %10.3f ms per 1000 frames\n", injected ? cpu / 1000. * 1000 / injected : 0.);
+	if(! options.device.empty())
+		std::printf("  drops       %10llu socket, ", (unsigned long long)(injected - stats.read));
+	else
+		std::printf("  drops       %10s ", "");
+	std::printf("%llu CAN message ring, %llu vehicle message ring\n",
+		(unsigned long long)can_q.get_dropped(), (unsigned long long)vehicle_q.get_dropped());
+}
+
+static int usage(const char* name)
+{
+	std::printf("Usage: %s [-s speedup] [-l loops] [-q queue-size] [-g application-generated.cpp] [-i vcan0] [trace...]\n", name);
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	replay_options_t options;
+	int opt;
+	while((opt = getopt(argc, argv, "s:l:q:g:i:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 's': options.speedup = std::strtod(optarg, nullptr); break;
+			case 'l': options.loops = std::max(1, std::atoi(optarg)); break;
+			case 'q': options.queue_size = std::strtoul(optarg, nullptr, 0); break;
+			case 'g': options.generated = optarg; break;
+			case 'i': options.device = optarg; break;
+			default: return usage(argv[0]);
+		}
+	}
+	for(int i = optind; i < argc; i++)
+		options.traces.push_back(argv[i]);
+	if(options.traces.empty())
+		options.traces.push_back(FIXTURES_DIR);
+
+	std::vector<message_layout_t> messages = load_layouts(options.generated.c_str());
+	std::unordered_map<uint32_t, const message_layout_t*> layouts;
+	for(const auto& msg: messages)
+		layouts[msg.id] = &msg;
+	std::vector<trace_frame_t> frames = load_traces(options.traces);
+	if(frames.empty())
+		return usage(argv[0]);
+
+	utils::spsc_ring_t<can_message_t> can_q(options.queue_size);
+	utils::spsc_ring_t<std::pair<int, openxc_VehicleMessage>> vehicle_q(options.queue_size);
+	replay_stats_t stats;
+	stats.latencies.reserve(frames.size() * options.loops * 4);
+
+	int raw = -1;
+	utils::socketcan_bcm_t bcm;
+	if(! options.device.empty() && open_device(options.device, frames, raw, bcm) < 0)
+		return 1;
+
+	std::atomic<bool> running{true};
+	std::thread decoder(decode_loop, std::ref(can_q), std::ref(vehicle_q), std::cref(layouts), std::ref(stats), std::cref(running));
+	std::thread pusher(push_loop, std::ref(vehicle_q), std::ref(stats), std::cref(running));
+	std::thread reader;
+	if(raw >= 0)
+		reader = std::thread(read_loop, std::ref(bcm), std::ref(can_q), std::ref(stats), std::cref(running));
+
+	uint64_t duration = frames.back().timestamp + 1000;
+	uint64_t cpu_start = cpu_us();
+	uint64_t start = realtime_us();
+	auto clock_start = std::chrono::steady_clock::now();
+	size_t pending = 0;
+	for(int loop = 0; loop < options.loops; loop++)
+	{
+		for(size_t i = 0; i < frames.size(); i++)
+		{
+			const trace_frame_t& tf = frames[i];
+			uint64_t offset = loop * duration + tf.timestamp;
+			if(options.speedup > 0)
+				std::this_thread::sleep_until(clock_start + std::chrono::microseconds((uint64_t)(offset / options.speedup)));
+
+			if(raw >= 0)
+			{
+				if(::write(raw, &tf.frame, tf.fd ? CANFD_MTU : CAN_MTU) < 0)
+					continue;
+			}
+			else
+			{
+				// Pushed as just read by the event loop, which notifies the
+				// decoder once per socket read batch.
+				if(tf.fd)
+					can_q.push(can_message_t::convert_from_frame(tf.frame, CANFD_MTU, realtime_us()));
+				else
+					can_q.push(can_message_t::convert_from_frame(*(const struct can_frame*)&tf.frame, CAN_MTU, realtime_us()));
+				if(++pending >= BCM_READ_BATCH || options.speedup > 0)
+				{
+					can_q.notify();
+					pending = 0;
+				}
+			}
+			stats.injected.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	can_q.notify();
+
+	// Drained once nothing moved for a while.
+	uint64_t last = ~0ULL;
+	while(last != stats.decoded + stats.pushed + stats.read)
+	{
+		last = stats.decoded + stats.pushed + stats.read;
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+	uint64_t cpu = cpu_us() - cpu_start;
+
+	running = false;
+	can_q.wake();
+	vehicle_q.wake();
+	decoder.join();
+	pusher.join();
+	if(reader.joinable())
+		reader.join();
+	if(raw >= 0)
+		::close(raw);
+
+	report(options, stats, can_q, vehicle_q, start, cpu);
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// Micro benchmark of the debug output cost on the frame path: conversion from
+/// the BCM socket frame, push and pop through the CAN message ring, with the
+/// trace points of the BCM read and of the decoder. It compares the AFB_DEBUG
+/// calls of previous builds, with the log level dropping them, to trace points
+/// compiled out, compiled in but disabled, then storing records in a trace file.
+///
+/// Usage: bench-trace [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <linux/can/bcm.h>
+
+#include "../../low-can-binding/can/can-message.hpp"
+#include "../../low-can-binding/utils/spsc-ring.hpp"
+#include "../../low-can-binding/utils/trace.hpp"
+#include "../../low-can-binding/binding/low-can-hat.hpp"
+
+// Keep binding logging macros quiet, there is no daemon behind them.
+struct afb_binding_data_v2 afbBindingV2data = { -1 };
+
+static const std::string device_name = "vcan0";
+static const int ifindex = 3;
+
+template <typename F>
+static void run(const char* name, long frames, F frame_path)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	uint64_t sum = 0;
+	for(long i = 0; i < frames; i++)
+		sum += frame_path(i);
+
+	auto stop = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+
+	std::printf("%-20s %10ld frames %8.1f ns/frame (checksum %llu)\n",
+		name, frames, ns / frames, (unsigned long long)sum);
+}
+
+/// @brief Frame path with the AFB_DEBUG calls of previous builds.
+static uint64_t path_afb_debug(utils::spsc_ring_t<can_message_t>& ring, const struct canfd_frame& frame, uint64_t timestamp)
+{
+	can_message_t out;
+
+	AFB_DEBUG("Data available: %li bytes read. BCM head, opcode: %i, can_id: %i, nframes: %i", (long)CANFD_MTU, RX_CHANGED, frame.can_id, 1);
+	AFB_DEBUG("read: Found on bus %s:\n id: %X, length: %X, data %02X%02X%02X%02X%02X%02X%02X%02X", device_name.c_str(), frame.can_id, frame.len,
+		frame.data[0], frame.data[1], frame.data[2], frame.data[3], frame.data[4], frame.data[5], frame.data[6], frame.data[7]);
+	// Logs convert_from_frame made before they were removed from it.
+	AFB_DEBUG("Got an CAN FD frame");
+	AFB_DEBUG("Found id: %X, format: %X, length: %X, data %02X%02X%02X%02X%02X%02X%02X%02X",
+		frame.can_id & CAN_SFF_MASK, 0, frame.len, frame.data[0], frame.data[1], frame.data[2], frame.data[3], frame.data[4], frame.data[5], frame.data[6], frame.data[7]);
+	ring.push(can_message_t::convert_from_frame(frame, CANFD_MTU, timestamp));
+
+	ring.pop(out);
+	AFB_DEBUG("Here is the next can message : id %X, length %X, data %02X%02X%02X%02X%02X%02X%02X%02X", out.get_id(), out.get_length(),
+		out.get_data()[0], out.get_data()[1], out.get_data()[2], out.get_data()[3], out.get_data()[4], out.get_data()[5], out.get_data()[6], out.get_data()[7]);
+	return out.get_id() + out.get_data()[0];
+}
+
+// The compiled level is read where LOW_CAN_TRACE is expanded, so both paths
+// below are built from the same code with different levels.
+#define TRACED_FRAME_PATH(name) \
+	static uint64_t name(utils::spsc_ring_t<can_message_t>& ring, const struct canfd_frame& frame, uint64_t timestamp) \
+	{ \
+		can_message_t out; \
+		LOW_CAN_TRACE(utils::trace_level_t::FRAMES, \
+			utils::tracer_t::instance().frame(utils::trace_point_t::BCM_READ, ifindex, frame.can_id, frame.data, frame.len)); \
+		ring.push(can_message_t::convert_from_frame(frame, CANFD_MTU, timestamp)); \
+		ring.pop(out); \
+		LOW_CAN_TRACE(utils::trace_level_t::FRAMES, \
+			utils::tracer_t::instance().frame(utils::trace_point_t::NEXT_CAN_MESSAGE, ifindex, out.get_id(), out.get_data(), out.get_length())); \
+		return out.get_id() + out.get_data()[0]; \
+	}
+
+#undef LOW_CAN_TRACE_LEVEL
+#define LOW_CAN_TRACE_LEVEL 0
+TRACED_FRAME_PATH(path_trace_compiled_out)
+
+#undef LOW_CAN_TRACE_LEVEL
+#define LOW_CAN_TRACE_LEVEL 2
+TRACED_FRAME_PATH(path_trace_compiled_in)
+
+int main(int argc, char* argv[])
+{
+	long frames = argc > 1 ? std::strtol(argv[1], nullptr, 0) : 1000000;
+	utils::spsc_ring_t<can_message_t> ring(4096);
+
+	struct canfd_frame frame;
+	::memset(&frame, 0, sizeof(frame));
+	frame.len = 8;
+
+	auto bench = [&](const char* name, uint64_t (*frame_path)(utils::spsc_ring_t<can_message_t>&, const struct canfd_frame&, uint64_t)) {
+		run(name, frames, [&](long i) -> uint64_t {
+			frame.can_id = 0x100 + (i & 0x3F);
+			frame.data[0] = (uint8_t)i;
+			return frame_path(ring, frame, i);
+		});
+	};
+
+	bench("afb_debug", path_afb_debug);
+	bench("trace compiled out", path_trace_compiled_out);
+	bench("trace disabled", path_trace_compiled_in);
+
+	char file[] = "/tmp/bench-trace-XXXXXX";
+	int fd = ::mkstemp(file);
+	if(fd < 0 || utils::tracer_t::instance().configure("frames", file, TRACE_RECORDS_DEFAULT) < 0)
+	{
+		std::fprintf(stderr, "Can't create trace file %s\n", file);
+		return 1;
+	}
+	::close(fd);
+	bench("trace to file", path_trace_compiled_in);
+	::unlink(file);
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	 http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// Signal layouts read from a generated application file, for benchmarks
+/// which can't link the whole binding.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <fstream>
+
+#include "../../low-can-binding/can/can-decode-plan.hpp"
+
+struct signal_layout_t
+{
+	std::string name;
+	uint8_t bit_position;
+	uint8_t bit_size;
+	float factor;
+	float offset;
+};
+
+struct message_layout_t
+{
+	uint32_t id;
+	std::vector<signal_layout_t> signals;
+	decode_plan_t plan;
+};
+
+static inline std::string next_token(std::ifstream& in)
+{
+	std::string line;
+	std::getline(in, line);
+	size_t start = line.find_first_not_of(" \t\"");
+	size_t end = line.find_last_not_of(" \t\",");
+	return start == std::string::npos ? "" : line.substr(start, end - start + 1);
+}
+
+/// Read message definitions and their signals layout from a generated file,
+/// then compile their decode plan.
+static inline std::vector<message_layout_t> load_layouts(const char* path)
+{
+	std::vector<message_layout_t> messages;
+	std::ifstream in(path);
+	std::string line;
+	while(std::getline(in, line))
+	{
+		size_t pos = line.find("can_message_definition_t{\"");
+		if(pos != std::string::npos)
+		{
+			messages.push_back(message_layout_t());
+			size_t id = line.find(",0x", pos);
+			messages.back().id = id == std::string::npos ? 0 : (uint32_t)std::strtoul(line.c_str() + id + 1, nullptr, 16);
+		}
+		else if(line.find("can_signal_t{") != std::string::npos && ! messages.empty())
+		{
+			signal_layout_t sig;
+			sig.name = next_token(in);
+			sig.bit_position = (uint8_t)std::strtoul(next_token(in).c_str(), nullptr, 0);
+			sig.bit_size = (uint8_t)std::strtoul(next_token(in).c_str(), nullptr, 0);
+			sig.factor = std::strtof(next_token(in).c_str(), nullptr);
+			sig.offset = std::strtof(next_token(in).c_str(), nullptr);
+			messages.back().signals.push_back(sig);
+		}
+	}
+
+	for(auto& msg: messages)
+	{
+		for(const auto& sig: msg.signals)
+			msg.plan.add(nullptr, sig.bit_position, sig.bit_size, sig.factor, sig.offset);
+	}
+	return messages;
+}
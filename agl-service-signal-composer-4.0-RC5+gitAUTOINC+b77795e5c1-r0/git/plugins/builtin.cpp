@@ -39,14 +39,26 @@ CTLP_CAPI (defaultOnReceived, source, argsJ, eventJ)
 
 	json_object* valueJ = nullptr;
 	json_object* timestampJ = nullptr;
-	double value = 0;
+	struct signalValue v = 0.0;
 	uint64_t timestamp = 0;
 	if(json_object_object_get_ex(eventJ, "value", &valueJ))
-		{value = json_object_get_double(valueJ);}
+	{
+		if(json_object_is_type(valueJ, json_type_string) && ctx->version >= 2)
+		{
+			v.type = SIGNAL_VALUE_STR;
+			v.strId = ctx->internString(json_object_get_string(valueJ));
+			if(v.strId == SIGNAL_STRING_INVALID)
+			{
+				AFB_ERROR("Can't hold string value, ignoring %s", json_object_to_json_string(eventJ));
+				return -1;
+			}
+		}
+		else
+			{v = json_object_get_double(valueJ);}
+	}
 	if(json_object_object_get_ex(eventJ, "timestamp", &timestampJ))
 		{timestamp = json_object_get_int64(timestampJ);}
 
-	struct signalValue v = value;
 	ctx->setSignalValue(ctx->aSignal, timestamp, v);
 	return 0;
 }
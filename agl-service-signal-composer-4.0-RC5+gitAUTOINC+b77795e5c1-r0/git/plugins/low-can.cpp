@@ -129,6 +129,60 @@ CTLP_CAPI (subscribeToLow, source, argsJ, eventJ) {
 	return err;
 }
 
+/// @brief Default onReceived of low-can signals. low-can events always carry
+///  "name", "value" and "timestamp" members, they are read directly and the
+///  typed value is handed to the composer.
+CTLP_CAPI (onReceivedSample, source, argsJ, eventJ) {
+	struct signalCBT* context = reinterpret_cast<struct signalCBT*>(source->context);
+	json_object *valueJ = nullptr, *timestampJ = nullptr;
+	struct signalSample sample;
+
+	if(!json_object_object_get_ex(eventJ, "value", &valueJ))
+	{
+		AFB_ERROR("No value in event %s", json_object_to_json_string(eventJ));
+		return -1;
+	}
+
+	switch(json_object_get_type(valueJ))
+	{
+		case json_type_boolean:
+			sample.value = (bool)json_object_get_boolean(valueJ);
+			break;
+		case json_type_double:
+		case json_type_int:
+			sample.value = json_object_get_double(valueJ);
+			break;
+		case json_type_string:
+			if(context->version < 2)
+			{
+				AFB_ERROR("Composer can't hold string values, ignoring %s", json_object_to_json_string(eventJ));
+				return -1;
+			}
+			sample.value.type = SIGNAL_VALUE_STR;
+			sample.value.strId = context->internString(json_object_get_string(valueJ));
+			if(sample.value.strId == SIGNAL_STRING_INVALID)
+			{
+				AFB_ERROR("Can't hold string value, ignoring %s", json_object_to_json_string(eventJ));
+				return -1;
+			}
+			break;
+		default:
+			AFB_ERROR("Unexpected value type in event %s", json_object_to_json_string(eventJ));
+			return -1;
+	}
+
+	sample.timestamp = json_object_object_get_ex(eventJ, "timestamp", &timestampJ) ?
+		(uint64_t)json_object_get_int64(timestampJ) :
+		0;
+
+	if(context->version >= 3)
+		{context->setSignalSamples(context->aSignal, &sample, 1);}
+	else
+		{context->setSignalValue(context->aSignal, sample.timestamp, sample.value);}
+
+	return 0;
+}
+
 CTLP_CAPI (isOpen, source, argsJ, eventJ) {
 	const char *eventName = nullptr;
 	int eventStatus;
@@ -148,22 +202,22 @@ CTLP_CAPI (isOpen, source, argsJ, eventJ) {
 
 	if(strcasestr(eventName, "front_left"))
 	{
-		context->searchNsetSignalValue(eventName,(uint64_t)timestamp, eventStatus);
+		context->setSignalValue(context->aSignal, (uint64_t)timestamp, eventStatus);
 		setDoor(&pluginCtx->allDoorsCtx.front_left, eventName, eventStatus);
 	}
 	else if(strcasestr(eventName, "front_right"))
 	{
-		context->searchNsetSignalValue(eventName,(uint64_t)timestamp, eventStatus);
+		context->setSignalValue(context->aSignal, (uint64_t)timestamp, eventStatus);
 		setDoor(&pluginCtx->allDoorsCtx.front_right, eventName, eventStatus);
 	}
 	else if(strcasestr(eventName, "rear_left"))
 	{
-		context->searchNsetSignalValue(eventName,(uint64_t)timestamp, eventStatus);
+		context->setSignalValue(context->aSignal, (uint64_t)timestamp, eventStatus);
 		setDoor(&pluginCtx->allDoorsCtx.rear_left, eventName, eventStatus);
 	}
 	else if(strcasestr(eventName, "rear_right"))
 	{
-		context->searchNsetSignalValue(eventName,(uint64_t)timestamp, eventStatus);
+		context->setSignalValue(context->aSignal, (uint64_t)timestamp, eventStatus);
 		setDoor(&pluginCtx->allDoorsCtx.rear_right, eventName, eventStatus);
 	}
 	else
@@ -33,7 +33,6 @@
 void onEvent(const char *event, json_object *object)
 {
 	Composer& composer = Composer::instance();
-	AFB_NOTICE("event: %s", json_object_to_json_string(object));
 
 	std::vector<std::shared_ptr<Signal>> signals = composer.searchSignals(event);
 	if(!signals.empty())
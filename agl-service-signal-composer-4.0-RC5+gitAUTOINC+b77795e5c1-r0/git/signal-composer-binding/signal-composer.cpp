@@ -18,6 +18,8 @@
 #include <uuid.h>
 #include <string.h>
 #include <fnmatch.h>
+#include <algorithm>
+#include <set>
 
 #include "clientApp.hpp"
 
@@ -37,6 +39,16 @@ extern "C" void setSignalValueHandle(void* aSignal, uint64_t timestamp, struct s
 	sig->set(timestamp, value);
 }
 
+extern "C" void setSignalSamplesHandle(void* aSignal, const struct signalSample* samples, size_t count)
+{
+	Signal* sig = static_cast<Signal*>(aSignal);
+	for(size_t i = 0; i < count; i++)
+	{
+		struct signalValue value = samples[i].value;
+		sig->set(samples[i].timestamp ? samples[i].timestamp : Signal::receptionTime(), value);
+	}
+}
+
 bool startsWith(const std::string& str, const std::string& pattern)
 {
 	size_t sep;
@@ -59,6 +71,10 @@ static struct signalCBT pluginHandle = {
 	.setSignalValue = setSignalValueHandle,
 	.aSignal = nullptr,
 	.pluginCtx = nullptr,
+	.version = SIGNALCBT_VERSION,
+	.internString = signalStringIntern,
+	.lookupString = signalStringLookup,
+	.setSignalSamples = setSignalSamplesHandle,
 };
 
 CtlSectionT Composer::ctlSections_[] = {
@@ -84,7 +100,8 @@ CtlSectionT Composer::ctlSections_[] = {
 //                             PRIVATE METHODS                               //
 ///////////////////////////////////////////////////////////////////////////////
 
-Composer::Composer()
+Composer::Composer():
+ indexed_(false)
 {}
 
 Composer::~Composer()
@@ -242,8 +259,7 @@ int Composer::loadOneSourceAPI(json_object* sourceJ)
 				*getSignalsJ = nullptr,
 				*onReceivedJ = nullptr;
 	CtlActionT  *initCtl = nullptr,
-				*getSignalsCtl = nullptr,
-				*onReceivedCtl = nullptr;
+				*getSignalsCtl = nullptr;
 	const char *uid, *api, *info;
 	int retention = 0;
 
@@ -292,9 +308,15 @@ int Composer::loadOneSourceAPI(json_object* sourceJ)
 	}
 	getSignalsCtl = convert2Action("getSignals", getSignalsJ);
 
-	onReceivedCtl = onReceivedJ ? convert2Action("onReceived", onReceivedJ) : nullptr;
+	// Each signal of the source without its own onReceived gets an action
+	// built from this one, keep it until then.
+	if(onReceivedJ)
+	{
+		json_object_get(onReceivedJ);
+		ctlActionsJ_.push_back(onReceivedJ);
+	}
 
-	sourcesListV_.push_back(std::make_shared<SourceAPI>(uid, api, info, initCtl, getSignalsCtl, onReceivedCtl, retention));
+	sourcesListV_.push_back(std::make_shared<SourceAPI>(uid, api, info, initCtl, getSignalsCtl, onReceivedJ, retention));
 	return err;
 }
 
@@ -349,13 +371,13 @@ int Composer::loadOneSignal(json_object* signalJ)
 	const char *id = nullptr,
 			   *event = nullptr,
 			   *unit = nullptr;
-	int retention = 0;
+	int retention = 0, window = 0;
 	double frequency=0.0;
 	std::vector<std::string> dependsV;
 	ssize_t sep;
 	std::shared_ptr<SourceAPI> src = nullptr;
 
-	int err = wrap_json_unpack(signalJ, "{ss,s?s,s?o,s?o,s?i,s?s,s?F,s?o !}",
+	int err = wrap_json_unpack(signalJ, "{ss,s?s,s?o,s?o,s?i,s?s,s?F,s?o,s?i !}",
 			"uid", &id,
 			"event", &event,
 			"depends", &dependsJ,
@@ -363,10 +385,11 @@ int Composer::loadOneSignal(json_object* signalJ)
 			"retention", &retention,
 			"unit", &unit,
 			"frequency", &frequency,
-			"onReceived", &onReceivedJ);
+			"onReceived", &onReceivedJ,
+			"window", &window);
 	if (err)
 	{
-		AFB_ERROR("Missing something uid|[event|depends]|[getSignalsArgs]|[retention]|[unit]|[frequency]|[onReceived] in %s", json_object_get_string(signalJ));
+		AFB_ERROR("Missing something uid|[event|depends]|[getSignalsArgs]|[retention]|[unit]|[frequency]|[onReceived]|[window] in %s", json_object_get_string(signalJ));
 		return err;
 	}
 
@@ -436,19 +459,17 @@ int Composer::loadOneSignal(json_object* signalJ)
 	char uid[CONTROL_MAXPATH_LEN] = "onReceived_";
 	strncat(uid, id, strlen(id));
 
+	// Signal owns its action, build its own one from the source default
 	if(!onReceivedJ)
-	{
-		onReceivedCtl = src->signalsDefault().onReceived ?
-			src->signalsDefault().onReceived :
-			nullptr;
-			// Overwrite uid to the signal one instead of the default
-			if(onReceivedCtl)
-				{onReceivedCtl->uid = uid;}
-	}
-	else {onReceivedCtl = convert2Action(uid, onReceivedJ);}
+		{onReceivedJ = src->signalsDefault().onReceivedJ;}
+	onReceivedCtl = onReceivedJ ? convert2Action(uid, onReceivedJ) : nullptr;
 
 	if(src != nullptr)
-		{src->addSignal(id, event, dependsV, retention, unit, frequency, onReceivedCtl, getSignalsArgs);}
+	{
+		src->addSignal(id, event, dependsV, retention, unit, frequency, window, onReceivedCtl, getSignalsArgs);
+		std::lock_guard<std::mutex> lock(indexMutex_);
+		indexed_ = false;
+	}
 	else
 		{err = -1;}
 
@@ -495,14 +516,14 @@ void Composer::processOptions(const std::map<std::string, int>& opts, std::share
 		else if (o.first.compare("minimum") && !min)
 		{
 			min = true;
-			double value = sig->minimum();
+			double value = sig->minimum(o.second);
 			json_object_object_add(response, "value",
 				json_object_new_double(value));
 		}
 		else if (o.first.compare("maximum") && !max)
 		{
 			max = true;
-			double value = sig->maximum();
+			double value = sig->maximum(o.second);
 			json_object_object_add(response, "value",
 				json_object_new_double(value));
 		}
@@ -510,20 +531,20 @@ void Composer::processOptions(const std::map<std::string, int>& opts, std::share
 		{
 			last = true;
 			struct signalValue value = sig->last();
-			if(value.hasBool)
+			if(value.hasBool())
 			{
 				json_object_object_add(response, "value",
 					json_object_new_boolean(value.boolVal));
 			}
-			else if(value.hasNum)
+			else if(value.hasNum())
 			{
 				json_object_object_add(response, "value",
 					json_object_new_double(value.numVal));
 			}
-			else if(value.hasStr)
+			else if(value.hasStr())
 			{
 				json_object_object_add(response, "value",
-					json_object_new_string(value.strVal.c_str()));
+					json_object_new_string(value.strVal()));
 			}
 			else
 			{
@@ -659,9 +680,97 @@ void Composer::initSignals()
 		std::shared_ptr<SourceAPI> src = sourcesListV_[i];
 		src->initSignals();
 	}
+	indexSignals();
+	graph_.compile(getAllSignals());
 	execSignalsSubscription();
 }
 
+/// @brief A signal value changed, schedule the evaluation of the signals
+///  depending on it.
+///
+/// @param[in] sig - signal which changed
+void Composer::signalChanged(Signal* sig)
+{
+	graph_.changed(sig);
+}
+
+/// @brief Build the indexes used to resolve signals by name, from all
+///  loaded signals. The search result of each id and event name, the same
+///  as the linear search gives, is computed once and hashed. Wildcard
+///  patterns are matched against a sorted list of all names, and other
+///  partial names searches are cached until the next indexing.
+///
+///  Signals are listed once, then each id and event name substring having
+///  the length of an indexed name is looked up, so that every result list
+///  is filled in a single pass, in the linear search order.
+///
+///  Indexes are built aside then swapped in under indexMutex_, so concurrent
+///  searches see either the previous or the new ones.
+void Composer::indexSignals()
+{
+	std::unordered_map<std::string, std::vector<std::shared_ptr<Signal>>> signalsIndex;
+	std::vector<std::pair<std::string, std::shared_ptr<Signal>>> wildcardIndex;
+	std::vector<std::shared_ptr<Signal>> allSignals = getAllSignals();
+	std::set<size_t> lengths;
+
+	for(auto& sig: allSignals)
+	{
+		std::string id = sig->id();
+		std::string event = sig->event();
+		wildcardIndex.emplace_back(id, sig);
+		if(!event.empty() && event != id)
+			{wildcardIndex.emplace_back(event, sig);}
+	}
+	for(auto& entry: wildcardIndex)
+	{
+		// Names holding an api are searched in their source only
+		if(signalsIndex.count(entry.first))
+			{continue;}
+		if(entry.first.find('/') != std::string::npos)
+			{signalsIndex[entry.first] = scanSignals(entry.first);}
+		else
+		{
+			signalsIndex[entry.first];
+			lengths.insert(entry.first.size());
+		}
+	}
+
+	std::string sub;
+	std::vector<std::vector<std::shared_ptr<Signal>>*> found;
+	for(auto& sig: allSignals)
+	{
+		found.clear();
+		for(const std::string& name: {sig->id(), sig->event()})
+		{
+			for(size_t len: lengths)
+			{
+				if(len > name.size())
+					{break;}
+				for(size_t pos = 0; pos + len <= name.size(); pos++)
+				{
+					sub.assign(name, pos, len);
+					auto it = signalsIndex.find(sub);
+					if(it != signalsIndex.end() && sub.find('/') == std::string::npos &&
+						std::find(found.begin(), found.end(), &it->second) == found.end())
+						{found.push_back(&it->second);}
+				}
+			}
+		}
+		for(auto list: found)
+			{list->push_back(sig);}
+	}
+
+	std::sort(wildcardIndex.begin(), wildcardIndex.end(),
+		[](const std::pair<std::string, std::shared_ptr<Signal>>& a, const std::pair<std::string, std::shared_ptr<Signal>>& b)
+		{return a.first < b.first;});
+
+	std::lock_guard<std::mutex> lock(indexMutex_);
+	signalsIndex_.swap(signalsIndex);
+	wildcardIndex_.swap(wildcardIndex);
+	searchCache_.clear();
+	indexed_ = true;
+}
+
 std::shared_ptr<SourceAPI> Composer::getSourceAPI(const std::string& api)
 {
 	for(auto& source: sourcesListV_)
@@ -689,7 +798,71 @@ std::vector<std::shared_ptr<Signal>> Composer::getAllSignals()
 	return allSignals;
 }
 
+/// @brief Search signals by name. Signals whose id or event name contain
+///  the name are returned, the result for a whole signal id or event name is
+///  taken from the index. A name holding wildcards ('*', '?', '[') is
+///  matched as a shell pattern against ids and event names instead.
+///
+/// @param[in] aName - A signal id, event name, part of them or pattern
+///
+/// @return Returns a vector of found signals.
 std::vector<std::shared_ptr<Signal>> Composer::searchSignals(const std::string& aName)
+{
+	std::unique_lock<std::mutex> lock(indexMutex_);
+	if(!indexed_)
+	{
+		lock.unlock();
+		return scanSignals(aName);
+	}
+
+	auto exact = signalsIndex_.find(aName);
+	if(exact != signalsIndex_.end())
+		{return exact->second;}
+
+	if(aName.find_first_of("*?[") != std::string::npos)
+		{return matchSignals(aName);}
+
+	auto cached = searchCache_.find(aName);
+	if(cached != searchCache_.end())
+		{return cached->second;}
+
+	std::vector<std::shared_ptr<Signal>> signals = scanSignals(aName);
+	if(searchCache_.size() < SEARCH_CACHE_MAX)
+		{searchCache_[aName] = signals;}
+	return signals;
+}
+
+/// @brief Match signals ids and event names against a shell wildcard
+///  pattern. The constant prefix before the first wildcard bounds the
+///  range of the sorted index to test.
+///
+/// @param[in] pattern - fnmatch pattern
+///
+/// @return Returns a vector of matching signals, each one once.
+std::vector<std::shared_ptr<Signal>> Composer::matchSignals(const std::string& pattern) const
+{
+	std::vector<std::shared_ptr<Signal>> signals;
+	std::string prefix = pattern.substr(0, pattern.find_first_of("*?[\\"));
+
+	auto it = std::lower_bound(wildcardIndex_.begin(), wildcardIndex_.end(), prefix,
+		[](const std::pair<std::string, std::shared_ptr<Signal>>& entry, const std::string& value)
+		{return entry.first < value;});
+	for(; it != wildcardIndex_.end() && !it->first.compare(0, prefix.size(), prefix); ++it)
+	{
+		if(!fnmatch(pattern.c_str(), it->first.c_str(), 0) &&
+			std::find(signals.begin(), signals.end(), it->second) == signals.end())
+			{signals.push_back(it->second);}
+	}
+	return signals;
+}
+
+/// @brief Linear search of signals whose id or event name contain a name,
+///  used while signals aren't indexed yet and for partial names.
+///
+/// @param[in] aName - A signal name or part of it
+///
+/// @return Returns a vector of found signals.
+std::vector<std::shared_ptr<Signal>> Composer::scanSignals(const std::string& aName)
 {
 	std::string api;
 	std::vector<std::shared_ptr<Signal>> signals;
@@ -698,7 +871,8 @@ std::vector<std::shared_ptr<Signal>> Composer::searchSignals(const std::string&
 	{
 		api = aName.substr(0, sep);
 		std::shared_ptr<SourceAPI> source = getSourceAPI(api);
-		return source->searchSignals(aName);
+		if(source)
+			{return source->searchSignals(aName);}
 	}
 	else
 	{
@@ -733,20 +907,20 @@ json_object* Composer::getsignalValue(const std::string& sig, json_object* optio
 			if (opts.empty())
 			{
 				struct signalValue value = sig->last();
-				if(value.hasBool)
+				if(value.hasBool())
 				{
 					json_object_object_add(response, "value",
 						json_object_new_boolean(value.boolVal));
 				}
-				else if(value.hasNum)
+				else if(value.hasNum())
 				{
 					json_object_object_add(response, "value",
 						json_object_new_double(value.numVal));
 				}
-				else if(value.hasStr)
+				else if(value.hasStr())
 				{
 					json_object_object_add(response, "value",
-						json_object_new_string(value.strVal.c_str()));
+						json_object_new_string(value.strVal()));
 				}
 				else
 				{
@@ -18,7 +18,12 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <mutex>
 #include "source.hpp"
+#include "signal-graph.hpp"
+
+#define SEARCH_CACHE_MAX 1024
 
 class Composer
 {
@@ -29,6 +34,12 @@ private:
 	std::vector<json_object*> ctlActionsJ_; ///< Vector of action json object to be kept if we want to freed them correctly avoiding leak mem.
 	std::vector<std::shared_ptr<SourceAPI>> newSourcesListV_;
 	std::vector<std::shared_ptr<SourceAPI>> sourcesListV_;
+	std::mutex indexMutex_; ///< indexMutex_ - Protects indexed_, the indexes and the search cache between verbs and events
+	bool indexed_; ///< indexed_ - True when the indexes below match the loaded signals
+	std::unordered_map<std::string, std::vector<std::shared_ptr<Signal>>> signalsIndex_; ///< signalsIndex_ - Search results of each signal id and event name
+	std::vector<std::pair<std::string, std::shared_ptr<Signal>>> wildcardIndex_; ///< wildcardIndex_ - Every id and event name sorted, to match wildcard patterns
+	SignalGraph graph_; ///< graph_ - Dependencies between signals, schedules virtual signals evaluation
+	std::unordered_map<std::string, std::vector<std::shared_ptr<Signal>>> searchCache_; ///< searchCache_ - Results of partial name searches since the last indexing
 
 	explicit Composer(const std::string& filepath);
 	Composer();
@@ -49,6 +60,9 @@ private:
 	void initSourcesAPI();
 	void execSignalsSubscription();
 	std::shared_ptr<SourceAPI> getSourceAPI(const std::string& api);
+	void indexSignals();
+	std::vector<std::shared_ptr<Signal>> matchSignals(const std::string& pattern) const;
+	std::vector<std::shared_ptr<Signal>> scanSignals(const std::string& aName);
 	void processOptions(const std::map<std::string, int>& opts, std::shared_ptr<Signal> sig, json_object* response) const;
 public:
 	static Composer& instance();
@@ -59,6 +73,7 @@ public:
 	int loadSources(json_object* sourcesJ);
 	int loadSignals(json_object* signalsJ);
 	void initSignals();
+	void signalChanged(Signal* sig);
 
 	CtlConfigT* ctlConfig();
 	std::vector<std::shared_ptr<Signal>> getAllSignals();
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <deque>
+#include <cstdint>
+#include <algorithm>
+
+#include "signal-graph.hpp"
+#include "signal-composer.hpp"
+
+SignalGraph::SignalGraph()
+:timer_(nullptr),
+ ticking_(false)
+{}
+
+SignalGraph::~SignalGraph()
+{
+	if(timer_) {sd_event_source_unref(timer_);}
+}
+
+/// @brief Compile signals dependencies, as attached by
+///  Signal::attachToSourceSignals, in a graph ranking each signal after its
+///  dependencies. It replaces the previous graph.
+///
+/// @param[in] signals - all loaded signals
+///
+/// @return number of signals left out because they are part of a loop.
+int SignalGraph::compile(const std::vector<std::shared_ptr<Signal>>& signals)
+{
+	std::unordered_map<Signal*, int> inDegrees;
+	std::deque<Signal*> ready;
+
+	ranks_.clear();
+	dependants_.clear();
+	due_.clear();
+	waiting_.clear();
+	triggers_.clear();
+
+	for(auto& sig: signals)
+		{inDegrees[sig.get()];}
+	for(auto& sig: signals)
+	{
+		std::vector<Signal*>& dependants = dependants_[sig.get()];
+		dependants = sig->observers();
+		for(Signal* dep: dependants)
+			{inDegrees[dep]++;}
+	}
+
+	for(auto& node: inDegrees)
+	{
+		if(!node.second)
+			{ready.push_back(node.first);}
+	}
+
+	int rank = 0;
+	while(!ready.empty())
+	{
+		Signal* sig = ready.front();
+		ready.pop_front();
+		ranks_[sig] = rank++;
+		for(Signal* dep: dependants_[sig])
+		{
+			if(!--inDegrees[dep])
+				{ready.push_back(dep);}
+		}
+	}
+
+	int loops = 0;
+	for(auto& node: inDegrees)
+	{
+		if(!ranks_.count(node.first))
+		{
+			AFB_ERROR("Signal %s is part of a dependency loop, it won't be evaluated.", node.first->id().c_str());
+			loops++;
+		}
+	}
+	return loops;
+}
+
+/// @brief Mark a signal to be evaluated, at once or at the end of its
+///  coalescing window.
+void SignalGraph::schedule(Signal* sig, Signal* trigger, uint64_t now)
+{
+	auto rank = ranks_.find(sig);
+	if(rank == ranks_.end())
+		{return;}
+
+	triggers_[sig] = trigger;
+	if(sig->window() <= 0)
+		{due_.emplace(rank->second, sig);}
+	else if(!waiting_.count(sig))
+		{waiting_[sig] = now + (uint64_t)sig->window() * 1000;}
+}
+
+/// @brief A signal value changed, schedule the signals depending on it. Out
+///  of a tick, run one to evaluate those due now.
+///
+/// @param[in] sig - signal which changed
+void SignalGraph::changed(Signal* sig)
+{
+	auto dependants = dependants_.find(sig);
+	if(dependants == dependants_.end() || dependants->second.empty())
+		{return;}
+
+	uint64_t now = Signal::receptionTime();
+	for(Signal* dep: dependants->second)
+		{schedule(dep, sig, now);}
+
+	if(!ticking_)
+		{tick();}
+}
+
+/// @brief Evaluate signals due, and those whose coalescing window ended, in
+///  topological order. Signals changed by an evaluation schedule their
+///  dependants, ranked after them, so they are evaluated in the same tick.
+void SignalGraph::tick()
+{
+	uint64_t now = Signal::receptionTime();
+	ticking_ = true;
+
+	for(auto it = waiting_.begin(); it != waiting_.end();)
+	{
+		if(it->second <= now)
+		{
+			due_.emplace(ranks_[it->first], it->first);
+			it = waiting_.erase(it);
+		}
+		else
+			{++it;}
+	}
+
+	while(!due_.empty())
+	{
+		Signal* sig = due_.begin()->second;
+		due_.erase(due_.begin());
+		Signal* trigger = triggers_[sig];
+		triggers_.erase(sig);
+		sig->evaluate(trigger);
+	}
+
+	ticking_ = false;
+	armTimer();
+}
+
+/// @brief Arm the timer at the end of the nearest coalescing window, if any.
+void SignalGraph::armTimer()
+{
+	if(waiting_.empty())
+	{
+		if(timer_) {sd_event_source_set_enabled(timer_, SD_EVENT_OFF);}
+		return;
+	}
+
+	uint64_t next = UINT64_MAX;
+	for(auto& w: waiting_)
+		{next = std::min(next, w.second);}
+
+	if(!timer_)
+	{
+		if(sd_event_add_time(afb_daemon_get_event_loop(), &timer_, CLOCK_MONOTONIC, next, 1000, onTimer, this) < 0)
+		{
+			AFB_ERROR("Can't create the coalescing timer, evaluating waiting signals now");
+			timer_ = nullptr;
+			for(auto& w: waiting_)
+				{w.second = 0;}
+			tick();
+		}
+		return;
+	}
+	sd_event_source_set_time(timer_, next);
+	sd_event_source_set_enabled(timer_, SD_EVENT_ONESHOT);
+}
+
+int SignalGraph::onTimer(sd_event_source* source, uint64_t usec, void* userdata)
+{
+	static_cast<SignalGraph*>(userdata)->tick();
+	return 0;
+}
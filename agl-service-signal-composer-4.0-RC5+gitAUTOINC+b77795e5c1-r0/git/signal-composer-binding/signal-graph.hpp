@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#pragma once
+
+#include <set>
+#include <map>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <systemd/sd-event.h>
+
+class Signal;
+
+/// @brief Dependency graph of the virtual signals, compiled from the
+///  signals 'depends' once they are all loaded.
+///
+///  A change of a signal doesn't evaluate the signals depending on it right
+///  away, they are marked and evaluated in a tick, in topological order, so
+///  each one is evaluated once per tick even when several of its dependencies
+///  changed in that tick (diamonds). A signal with a coalescing window waits
+///  for it to elapse, collecting the changes of its dependencies, before
+///  being evaluated in the tick at the end of the window.
+///
+///  Ticks run on the binding event loop, not thread safe.
+class SignalGraph
+{
+private:
+	std::unordered_map<Signal*, int> ranks_; ///< ranks_ - topological rank of each signal, dependencies first
+	std::unordered_map<Signal*, std::vector<Signal*>> dependants_; ///< dependants_ - signals depending on each signal
+	std::set<std::pair<int, Signal*>> due_; ///< due_ - signals to evaluate in the running tick, by rank
+	std::map<Signal*, uint64_t> waiting_; ///< waiting_ - signals in their coalescing window, with its end in microseconds
+	std::unordered_map<Signal*, Signal*> triggers_; ///< triggers_ - last dependency change of signals due or waiting
+	sd_event_source* timer_; ///< timer_ - runs a tick at the end of the nearest coalescing window
+	bool ticking_; ///< ticking_ - true while a tick evaluates signals
+
+	void schedule(Signal* sig, Signal* trigger, uint64_t now);
+	void armTimer();
+	static int onTimer(sd_event_source* source, uint64_t usec, void* userdata);
+
+public:
+	SignalGraph();
+	~SignalGraph();
+
+	int compile(const std::vector<std::shared_ptr<Signal>>& signals);
+	void changed(Signal* sig);
+	void tick();
+};
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <cmath>
+
+#include "signal.hpp"
+#include "signal-history.hpp"
+
+/// @brief Build an empty history.
+///
+/// @param[in] retention - retention period in seconds.
+/// @param[in] frequency - expected signal frequency in Hertz, 0 if unknown.
+SignalHistory::SignalHistory(int retention, double frequency)
+:first_(0),
+ end_(0),
+ baseSum_(0.0),
+ baseCount_(0),
+ minQ_({{}, 0, 0}),
+ maxQ_({{}, 0, 0}),
+ retention_(retention > 0 ? (uint64_t)retention * MICRO : 0)
+{
+	double expected = frequency > 0 ? std::ceil(frequency * (retention + 1)) : HISTORY_INITIAL_CAPACITY;
+	size_t capacity = 1;
+	while(capacity < expected && capacity < HISTORY_MAX_CAPACITY)
+		{capacity <<= 1;}
+	resize(capacity);
+}
+
+const struct SignalHistory::sample& SignalHistory::at(uint64_t seq) const
+{
+	return samples_[seq & (samples_.size() - 1)];
+}
+
+/// @brief Move samples and queues to rings of a new capacity, not lower
+///  than the number of samples held.
+void SignalHistory::resize(size_t capacity)
+{
+	std::vector<struct sample> samples(capacity);
+	for(uint64_t seq = first_; seq < end_; seq++)
+		{samples[seq & (capacity - 1)] = at(seq);}
+	samples_.swap(samples);
+
+	for(struct monotonicQueue* queue: {&minQ_, &maxQ_})
+	{
+		std::vector<uint64_t> seqs(capacity);
+		for(uint64_t i = queue->head; i < queue->tail; i++)
+			{seqs[i & (capacity - 1)] = queue->seqs[i & (queue->seqs.size() - 1)];}
+		queue->seqs.swap(seqs);
+	}
+}
+
+/// @brief Drop the oldest sample.
+void SignalHistory::evict()
+{
+	const struct sample& oldest = at(first_);
+	baseSum_ = oldest.sum;
+	baseCount_ = oldest.count;
+
+	for(struct monotonicQueue* queue: {&minQ_, &maxQ_})
+	{
+		if(queue->head != queue->tail && queue->seqs[queue->head & (queue->seqs.size() - 1)] == first_)
+			{queue->head++;}
+	}
+	first_++;
+
+	if((first_ & (samples_.size() - 1)) == 0)
+		{rebase();}
+}
+
+/// @brief Recompute running sums and counts from the retained values only,
+///  once per ring wrap so the cost stays constant by sample.
+void SignalHistory::rebase()
+{
+	double sum = 0.0;
+	uint64_t count = 0;
+	for(uint64_t seq = first_; seq < end_; seq++)
+	{
+		struct sample& s = samples_[seq & (samples_.size() - 1)];
+		if(s.value.hasNum())
+		{
+			sum += s.value.numVal;
+			count++;
+		}
+		s.sum = sum;
+		s.count = count;
+	}
+	baseSum_ = 0.0;
+	baseCount_ = 0;
+}
+
+/// @brief Append a sequence number to a monotonic queue, the caller has
+///  already removed the entries it supersedes.
+void SignalHistory::queuePush(struct monotonicQueue& queue, uint64_t seq)
+{
+	queue.seqs[queue.tail & (queue.seqs.size() - 1)] = seq;
+	queue.tail++;
+}
+
+/// @brief Append a value then drop values older than the retention period.
+///  The newest value is always kept. When the ring is full of values still
+///  retained, it grows up to HISTORY_MAX_CAPACITY, then the oldest value is
+///  dropped.
+///
+/// @param[in] timestamp - timestamp of the value in microseconds.
+/// @param[in] value - value to append.
+void SignalHistory::push(uint64_t timestamp, const struct signalValue& value)
+{
+	if(end_ - first_ == samples_.size())
+	{
+		if(timestamp <= at(first_).timestamp + retention_ && samples_.size() < HISTORY_MAX_CAPACITY)
+			{resize(samples_.size() * 2);}
+		else
+			{evict();}
+	}
+
+	double sum = empty() ? baseSum_ : at(end_ - 1).sum;
+	uint64_t count = empty() ? baseCount_ : at(end_ - 1).count;
+	if(value.hasNum())
+	{
+		sum += value.numVal;
+		count++;
+
+		while(minQ_.tail != minQ_.head && at(minQ_.seqs[(minQ_.tail - 1) & (minQ_.seqs.size() - 1)]).value.numVal >= value.numVal)
+			{minQ_.tail--;}
+		queuePush(minQ_, end_);
+		while(maxQ_.tail != maxQ_.head && at(maxQ_.seqs[(maxQ_.tail - 1) & (maxQ_.seqs.size() - 1)]).value.numVal <= value.numVal)
+			{maxQ_.tail--;}
+		queuePush(maxQ_, end_);
+	}
+
+	samples_[end_ & (samples_.size() - 1)] = {timestamp, value, sum, count};
+	end_++;
+
+	while(end_ - first_ > 1 && timestamp > at(first_).timestamp + retention_)
+		{evict();}
+}
+
+bool SignalHistory::empty() const
+{
+	return end_ == first_;
+}
+
+size_t SignalHistory::size() const
+{
+	return end_ - first_;
+}
+
+/// @brief Newest value, the history must not be empty.
+const struct signalValue& SignalHistory::last() const
+{
+	return at(end_ - 1).value;
+}
+
+/// @brief Sequence number of the oldest sample of the last seconds.
+///
+/// @param[in] seconds - window length, 0 for the whole history.
+uint64_t SignalHistory::windowStart(int seconds) const
+{
+	if(seconds <= 0)
+		{return first_;}
+
+	uint64_t newest = at(end_ - 1).timestamp;
+	uint64_t span = (uint64_t)seconds * MICRO;
+	if(newest < span)
+		{return first_;}
+
+	uint64_t begin = newest - span;
+	uint64_t low = first_, high = end_ - 1;
+	while(low < high)
+	{
+		uint64_t mid = low + (high - low) / 2;
+		if(at(mid).timestamp < begin)
+			{low = mid + 1;}
+		else
+			{high = mid;}
+	}
+	return low;
+}
+
+/// @brief Index in a monotonic queue of its first entry not older than a
+///  sample, tail if there is none.
+uint64_t SignalHistory::queueStart(const struct monotonicQueue& queue, uint64_t from) const
+{
+	uint64_t low = queue.head, high = queue.tail;
+	while(low < high)
+	{
+		uint64_t mid = low + (high - low) / 2;
+		if(queue.seqs[mid & (queue.seqs.size() - 1)] < from)
+			{low = mid + 1;}
+		else
+			{high = mid;}
+	}
+	return low;
+}
+
+/// @brief Average of the numerical values of the last seconds.
+///
+/// @param[in] seconds - window length, 0 for the whole history.
+/// @param[out] result - the average.
+///
+/// @return false if there isn't any numerical value in the window.
+bool SignalHistory::average(int seconds, double& result) const
+{
+	if(empty())
+		{return false;}
+
+	uint64_t start = windowStart(seconds);
+	const struct sample& newest = at(end_ - 1);
+	double sum = start == first_ ? baseSum_ : at(start - 1).sum;
+	uint64_t count = start == first_ ? baseCount_ : at(start - 1).count;
+	if(newest.count == count)
+		{return false;}
+
+	result = (newest.sum - sum) / (newest.count - count);
+	return true;
+}
+
+/// @brief Minimum of the numerical values of the last seconds.
+///
+/// @param[in] seconds - window length, 0 for the whole history.
+/// @param[out] result - the minimum.
+///
+/// @return false if there isn't any numerical value in the window.
+bool SignalHistory::minimum(int seconds, double& result) const
+{
+	if(empty())
+		{return false;}
+
+	uint64_t i = seconds > 0 ? queueStart(minQ_, windowStart(seconds)) : minQ_.head;
+	if(i == minQ_.tail)
+		{return false;}
+
+	result = at(minQ_.seqs[i & (minQ_.seqs.size() - 1)]).value.numVal;
+	return true;
+}
+
+/// @brief Maximum of the numerical values of the last seconds.
+///
+/// @param[in] seconds - window length, 0 for the whole history.
+/// @param[out] result - the maximum.
+///
+/// @return false if there isn't any numerical value in the window.
+bool SignalHistory::maximum(int seconds, double& result) const
+{
+	if(empty())
+		{return false;}
+
+	uint64_t i = seconds > 0 ? queueStart(maxQ_, windowStart(seconds)) : maxQ_.head;
+	if(i == maxQ_.tail)
+		{return false;}
+
+	result = at(maxQ_.seqs[i & (maxQ_.seqs.size() - 1)]).value.numVal;
+	return true;
+}
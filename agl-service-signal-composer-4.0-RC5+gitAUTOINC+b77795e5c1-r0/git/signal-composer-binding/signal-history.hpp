@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "signal-value.hpp"
+
+#define HISTORY_INITIAL_CAPACITY 64
+#define HISTORY_MAX_CAPACITY 65536
+
+/// @brief Fixed-capacity ring holding a Signal values over its retention
+///  period, in arrival order which is expected to be the timestamps order.
+///
+///  Each sample holds the running sum and count of numerical values up to it,
+///  so sums over any window are a difference of two samples. Running sums are
+///  recomputed from the retained values each time the ring wraps, so they
+///  don't grow and lose precision over the signal lifetime. Minimum and
+///  maximum are kept by monotonic queues of sample sequence numbers: the front
+///  of a queue is the extremum of the whole history, and the extremum of the
+///  last seconds is the first queue entry inside that window.
+///
+///  Aggregates over the whole retention period are O(1), over a shorter
+///  window O(log n) to find where it begins. The ring is sized from the
+///  retention and frequency of the signal, or grows by doubling up to
+///  HISTORY_MAX_CAPACITY when the frequency is unknown.
+class SignalHistory
+{
+private:
+	struct sample {
+		uint64_t timestamp;
+		struct signalValue value;
+		double sum; ///< sum - sum of numerical values pushed up to this one included.
+		uint64_t count; ///< count - number of numerical values pushed up to this one included.
+	};
+
+	/// @brief Ring of sample sequence numbers, values monotonic from front to back.
+	struct monotonicQueue {
+		std::vector<uint64_t> seqs;
+		uint64_t head;
+		uint64_t tail;
+	};
+
+	std::vector<struct sample> samples_; ///< samples_ - ring of samples, capacity is a power of two.
+	uint64_t first_; ///< first_ - sequence number of the oldest sample.
+	uint64_t end_; ///< end_ - sequence number of the next sample pushed.
+	double baseSum_; ///< baseSum_ - sum of the last sample evicted, 0 if none.
+	uint64_t baseCount_; ///< baseCount_ - count of the last sample evicted, 0 if none.
+	struct monotonicQueue minQ_; ///< minQ_ - candidates to the minimum, increasing values.
+	struct monotonicQueue maxQ_; ///< maxQ_ - candidates to the maximum, decreasing values.
+	uint64_t retention_; ///< retention_ - retention period in microseconds.
+
+	const struct sample& at(uint64_t seq) const;
+	void resize(size_t capacity);
+	void evict();
+	void rebase();
+	uint64_t windowStart(int seconds) const;
+	uint64_t queueStart(const struct monotonicQueue& queue, uint64_t from) const;
+	static void queuePush(struct monotonicQueue& queue, uint64_t seq);
+
+public:
+	SignalHistory(int retention, double frequency);
+
+	void push(uint64_t timestamp, const struct signalValue& value);
+	bool empty() const;
+	size_t size() const;
+	const struct signalValue& last() const;
+
+	bool average(int seconds, double& result) const;
+	bool minimum(int seconds, double& result) const;
+	bool maximum(int seconds, double& result) const;
+};
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <mutex>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include "signal-composer-binding.hpp"
+#include "signal-value.hpp"
+
+/// @brief Interned strings, index 0 is the empty string. A deque keeps
+///  the strings in place when it grows so lookups can return c_str().
+static std::mutex stringsMutex;
+static std::deque<std::string> strings(1);
+static std::unordered_map<std::string, uint32_t> stringIds({{"", 0}});
+
+uint32_t signalStringIntern(const char* s)
+{
+	if(!s || !*s) {return 0;}
+
+	std::lock_guard<std::mutex> lock(stringsMutex);
+	auto it = stringIds.find(s);
+	if(it != stringIds.end())
+		{return it->second;}
+
+	if(strings.size() >= SIGNAL_STRING_TABLE_MAX)
+	{
+		AFB_ERROR("Interned strings table full, refusing '%s'", s);
+		return SIGNAL_STRING_INVALID;
+	}
+
+	uint32_t id = (uint32_t)strings.size();
+	strings.emplace_back(s);
+	stringIds.emplace(strings.back(), id);
+	return id;
+}
+
+const char* signalStringLookup(uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(stringsMutex);
+	return id < strings.size() ? strings[id].c_str() : "";
+}
+
+/// @brief Build a string value, interning the string.
+///
+/// @param[in] s - string to hold
+///
+/// @return the tagged value, an empty value of type SIGNAL_VALUE_NONE if
+///  the string couldn't be interned
+signalValue signalValue::fromString(const char* s)
+{
+	signalValue v;
+	uint32_t id = signalStringIntern(s);
+	if(id == SIGNAL_STRING_INVALID)
+		{return v;}
+	v.type = SIGNAL_VALUE_STR;
+	v.strId = id;
+	return v;
+}
+
+/// @brief Get the string held by a value
+///
+/// @return the interned string, empty if it isn't a string value
+const char* signalValue::strVal() const
+{
+	return type == SIGNAL_VALUE_STR ? signalStringLookup(strId) : "";
+}
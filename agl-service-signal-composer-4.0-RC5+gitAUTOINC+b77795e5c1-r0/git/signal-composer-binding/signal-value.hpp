@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2015, 2016 "IoT.bzh"
+ * Author "Romain Forlot" <romain.forlot@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/// @brief Maximum number of distinct strings interned, further strings are
+///  refused.
+#define SIGNAL_STRING_TABLE_MAX 4096
+
+/// @brief Index returned when a string can't be interned, the value
+///  holding it must be dropped.
+#define SIGNAL_STRING_INVALID UINT32_MAX
+
+/// @brief Type held by a signalValue
+enum signalValueType {
+	SIGNAL_VALUE_NONE = 0,
+	SIGNAL_VALUE_BOOL = 1,
+	SIGNAL_VALUE_NUM = 2,
+	SIGNAL_VALUE_STR = 3
+};
+
+/// @brief Structure holding a possible value of a Signal
+///  as it could be different type of value, it is tagged by its type.
+///  Strings are expected to be enum-like states, they are interned once in
+///  a table and only their index is carried, so that copying a value never
+///  allocates. Layout is plain C to be shared with plugins through signalCBT.
+struct signalValue {
+	uint32_t type; ///< type - one of signalValueType
+	uint32_t strId; ///< strId - index in the interned strings table when type is SIGNAL_VALUE_STR
+	union {
+		bool boolVal;
+		double numVal;
+	};
+
+#ifdef __cplusplus
+	signalValue():
+		type(SIGNAL_VALUE_NONE), strId(0), numVal(0) {};
+	signalValue(bool b):
+		type(SIGNAL_VALUE_BOOL), strId(0), numVal(0) {boolVal = b;};
+	signalValue(int b):
+		type(SIGNAL_VALUE_BOOL), strId(0), numVal(0) {boolVal = b;};
+	signalValue(double d):
+		type(SIGNAL_VALUE_NUM), strId(0), numVal(d) {};
+
+	bool hasBool() const {return type == SIGNAL_VALUE_BOOL;}
+	bool hasNum() const {return type == SIGNAL_VALUE_NUM;}
+	bool hasStr() const {return type == SIGNAL_VALUE_STR;}
+
+	static signalValue fromString(const char* s);
+	const char* strVal() const;
+#endif
+};
+
+/// @brief A value and its timestamp in microseconds, as handed by plugins
+///  which already decoded their source events. A null timestamp is replaced
+///  by the reception time.
+struct signalSample {
+	uint64_t timestamp;
+	struct signalValue value;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Get the index of a string in the interned strings table, adding
+///  it if it isn't there yet. Thread safe. Returns SIGNAL_STRING_INVALID
+///  once the table is full.
+uint32_t signalStringIntern(const char* s);
+
+/// @brief Get an interned string from its index, the empty string if unknown.
+const char* signalStringLookup(uint32_t id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -17,6 +17,7 @@
 
 #include <float.h>
 #include <string.h>
+#include <set>
 
 #include "signal.hpp"
 #include "signal-composer.hpp"
@@ -29,8 +30,10 @@ Signal::Signal()
  dependsSigV_(),
  timestamp_(0.0),
  value_(),
+ history_(0, 0),
  retention_(0),
  frequency_(0),
+ window_(0),
  unit_(""),
  onReceived_(nullptr),
  getSignalsArgs_(nullptr),
@@ -38,14 +41,16 @@ Signal::Signal()
  subscribed_(false)
 {}
 
-Signal::Signal(const std::string& id, const std::string& event, std::vector<std::string>& depends, const std::string& unit, int retention, double frequency, CtlActionT* onReceived, json_object* getSignalsArgs)
+Signal::Signal(const std::string& id, const std::string& event, std::vector<std::string>& depends, const std::string& unit, int retention, double frequency, int window, CtlActionT* onReceived, json_object* getSignalsArgs)
 :id_(id),
  event_(event),
  dependsSigV_(depends),
  timestamp_(0.0),
  value_(),
+ history_(retention, frequency),
  retention_(retention),
  frequency_(frequency),
+ window_(window),
  unit_(unit),
  onReceived_(onReceived),
  getSignalsArgs_(getSignalsArgs),
@@ -58,14 +63,17 @@ Signal::Signal(const std::string& id,
 	const std::string& unit,
 	int retention,
 	double frequency,
+	int window,
 	CtlActionT* onReceived)
 :id_(id),
  event_(),
  dependsSigV_(depends),
  timestamp_(0.0),
  value_(),
+ history_(retention, frequency),
  retention_(retention),
  frequency_(frequency),
+ window_(window),
  unit_(unit),
  onReceived_(onReceived),
  getSignalsArgs_(),
@@ -100,11 +108,45 @@ bool Signal::operator ==(const std::string& aName) const
 	return false;
 }
 
+/// @brief Build a JSON object from a signal value
+///
+/// @param[in] value - value to convert
+///
+/// @return the JSON value, nullptr if there is no value
+static json_object* valueToJSON(const struct signalValue& value)
+{
+	if (value.hasBool()) {return json_object_new_boolean(value.boolVal);}
+	else if (value.hasNum()) {return json_object_new_double(value.numVal);}
+	else if (value.hasStr()) {return json_object_new_string(value.strVal());}
+	return nullptr;
+}
+
 const std::string Signal::id() const
 {
 	return id_;
 }
 
+const std::string Signal::event() const
+{
+	return event_;
+}
+
+int Signal::window() const
+{
+	return window_;
+}
+
+/// @brief Get the signals depending on this one
+///
+/// @return vector of the observers
+std::vector<Signal*> Signal::observers() const
+{
+	std::vector<Signal*> observers;
+	for(const auto& obs: observerList_)
+		{observers.push_back(static_cast<Signal*>(obs));}
+	return observers;
+}
+
 /// @brief Build a JSON object with data members of Signal object
 ///
 /// @return the built JSON object representing the Signal
@@ -144,9 +186,8 @@ json_object* Signal::toJSON() const
 
 	if(timestamp_) {json_object_object_add(queryJ, "timestamp", json_object_new_int64(timestamp_));}
 
-	if (value_.hasBool) {json_object_object_add(queryJ, "value", json_object_new_boolean(value_.boolVal));}
-	else if (value_.hasNum) {json_object_object_add(queryJ, "value", json_object_new_double(value_.numVal));}
-	else if (value_.hasStr) {json_object_object_add(queryJ, "value", json_object_new_string(value_.strVal.c_str()));}
+	json_object* valueJ = valueToJSON(value_);
+	if (valueJ) {json_object_object_add(queryJ, "value", valueJ);}
 
 	return queryJ;
 }
@@ -167,6 +208,10 @@ struct signalCBT* Signal::get_context()
 	{
 		signalCtx_.searchNsetSignalValue = searchNsetSignalValueHandle;
 		signalCtx_.setSignalValue = setSignalValueHandle;
+		signalCtx_.version = SIGNALCBT_VERSION;
+		signalCtx_.internString = signalStringIntern;
+		signalCtx_.lookupString = signalStringLookup;
+		signalCtx_.setSignalSamples = setSignalSamplesHandle;
 
 		signalCtx_.aSignal = (void*)this;
 
@@ -187,18 +232,9 @@ struct signalCBT* Signal::get_context()
 /// @param[in] value - value of change
 void Signal::set(uint64_t timestamp, struct signalValue& value)
 {
-	uint64_t diff = retention_+1;
 	value_ = value;
 	timestamp_ = timestamp;
-	history_[timestamp_] = value_;
-
-	while(diff > retention_)
-	{
-		uint64_t first = history_.begin()->first;
-		diff = (timestamp_ - first)/MICRO;
-		if(diff > retention_)
-			{history_.erase(history_.cbegin());}
-	}
+	history_.push(timestamp_, value_);
 }
 
 /// @brief Observer method called when a Observable Signal has changes.
@@ -218,6 +254,32 @@ void Signal::defaultReceivedCB(json_object *eventJ)
 {
 	uint64_t ts = 0;
 	struct signalValue sv;
+	json_object *valueJ = nullptr, *timestampJ = nullptr;
+
+	// Most sources send "value" and "timestamp" members, get them directly
+	if(json_object_object_get_ex(eventJ, "value", &valueJ))
+	{
+		if(json_object_is_type(valueJ, json_type_double) || json_object_is_type(valueJ, json_type_int))
+			{sv = json_object_get_double(valueJ);}
+		else if(json_object_is_type(valueJ, json_type_boolean))
+			{sv = (bool)json_object_get_boolean(valueJ);}
+		else if(json_object_is_type(valueJ, json_type_string))
+		{
+			// A string that can't be interned is refused, error already logged
+			sv = signalValue::fromString(json_object_get_string(valueJ));
+			if(sv.type == SIGNAL_VALUE_NONE)
+				{return;}
+		}
+	}
+	if(sv.type != SIGNAL_VALUE_NONE)
+	{
+		if(json_object_object_get_ex(eventJ, "timestamp", &timestampJ) && json_object_is_type(timestampJ, json_type_int))
+			{ts = json_object_get_int64(timestampJ);}
+		set(ts ? ts : receptionTime(), sv);
+		return;
+	}
+
+	// Else walk every member to find something looking like a value
 	json_object_iterator iter = json_object_iter_begin(eventJ);
 	json_object_iterator iterEnd = json_object_iter_end(eventJ);
 	while(!json_object_iter_equal(&iter, &iterEnd))
@@ -232,7 +294,7 @@ void Signal::defaultReceivedCB(json_object *eventJ)
 			else if(json_object_is_type(value, json_type_boolean))
 				{sv = json_object_get_int(value);}
 			else if(json_object_is_type(value, json_type_string))
-				{sv = json_object_get_string(value);}
+				{sv = signalValue::fromString(json_object_get_string(value));}
 		}
 		else if (name.find("timestamp"))
 		{
@@ -241,21 +303,28 @@ void Signal::defaultReceivedCB(json_object *eventJ)
 		json_object_iter_next(&iter);
 	}
 
-	if(!sv.hasBool && !sv.hasNum && !sv.hasStr)
+	if(sv.type == SIGNAL_VALUE_NONE)
 	{
 		AFB_ERROR("No data found to set signal %s in %s", id_.c_str(), json_object_to_json_string(eventJ));
 		return;
 	}
 	else if(ts == 0)
-	{
-		struct timespec t_usec;
-		if(!::clock_gettime(CLOCK_MONOTONIC, &t_usec))
-			ts = (t_usec.tv_nsec / 1000ll) + (t_usec.tv_sec* 1000000ll);
-	}
+		{ts = receptionTime();}
 
 	set(ts, sv);
 }
 
+/// @brief Timestamp given to values received without one
+///
+/// @return monotonic clock in microseconds
+uint64_t Signal::receptionTime()
+{
+	struct timespec t_usec;
+	if(::clock_gettime(CLOCK_MONOTONIC, &t_usec))
+		{return 0;}
+	return (t_usec.tv_nsec / 1000ll) + (t_usec.tv_sec* 1000000ll);
+}
+
 /// @brief Notify observers that there is a change and execute callback defined
 /// when signal is received
 ///
@@ -269,17 +338,17 @@ void Signal::onReceivedCB(json_object *eventJ)
 		json_object_iterator iterEnd = json_object_iter_end(eventJ);
 		while(!json_object_iter_equal(&iter, &iterEnd))
 		{
-			const char *name = ::strdup(json_object_iter_peek_name(&iter));
+			const char *name = json_object_iter_peek_name(&iter);
 			json_object *value = json_object_iter_peek_value(&iter);
+			json_object_iter_next(&iter);
 			if(json_object_is_type(value, json_type_int))
 			{
 				int64_t newVal = json_object_get_int64(value);
-				newVal = newVal > USEC_TIMESTAMP_FLAG ? newVal/MICRO:newVal;
-				json_object_object_del(eventJ, name);
-				json_object* luaVal = json_object_new_int64(newVal);
-				json_object_object_add(eventJ, name, luaVal);
+				// Only rescale microseconds timestamps, adding an existing
+				// key replaces its value in place.
+				if(newVal > USEC_TIMESTAMP_FLAG)
+					{json_object_object_add(eventJ, name, json_object_new_int64(newVal/MICRO));}
 			}
-			json_object_iter_next(&iter);
 		}
 	}
 
@@ -289,7 +358,39 @@ void Signal::onReceivedCB(json_object *eventJ)
 	source.request = {nullptr, nullptr};
 	source.context = (void*)get_context();
 	onReceived_ ? ActionExecOne(&source, onReceived_, eventJ) : defaultReceivedCB(eventJ);
-	notify();
+	Composer::instance().signalChanged(this);
+}
+
+/// @brief Evaluate a virtual signal once some of its dependencies changed.
+/// Its onReceived action gets the last dependency change as "name", "value"
+/// and "timestamp" members, and the values of all dependencies in "values".
+///
+/// @param[in] trigger - last dependency which changed
+void Signal::evaluate(Signal* trigger)
+{
+	json_object *eventJ = json_object_new_object(), *valuesJ = json_object_new_object(), *valueJ = nullptr;
+
+	json_object_object_add(eventJ, "uid", json_object_new_string(id_.c_str()));
+	if(trigger)
+	{
+		json_object_object_add(eventJ, "name", json_object_new_string(trigger->id_.c_str()));
+		json_object_object_add(eventJ, "timestamp", json_object_new_int64(trigger->timestamp_));
+		if((valueJ = valueToJSON(trigger->value_)))
+			{json_object_object_add(eventJ, "value", valueJ);}
+	}
+	for(const auto& obs: observableList_)
+	{
+		Signal* dep = static_cast<Signal*>(obs);
+		if((valueJ = valueToJSON(dep->value_)))
+			{json_object_object_add(valuesJ, dep->id_.c_str(), valueJ);}
+	}
+	json_object_object_add(eventJ, "values", valuesJ);
+
+	// An api call takes the ownership of the query
+	bool apiCall = onReceived_ && onReceived_->type == CTL_TYPE_API;
+	onReceivedCB(eventJ);
+	if(!apiCall)
+		{json_object_put(eventJ);}
 }
 
 /// @brief Make a Signal observer observes Signals observables
@@ -316,102 +417,40 @@ void Signal::attachToSourceSignals(Composer& composer)
 
 /// @brief Make an average over the last X 'seconds'
 ///
-/// @param[in] seconds - period to calculate the average
+/// @param[in] seconds - period to calculate the average, 0 for the whole retention period
 ///
 /// @return Average value
 double Signal::average(int seconds) const
 {
-	uint64_t begin = history_.begin()->first;
-	uint64_t end = seconds ?
-		begin+(seconds*MICRO) :
-		history_.rbegin()->first;
-	double total = 0.0;
-	int nbElt = 0;
-
-	for (const auto& val: history_)
-	{
-		if(val.first >= end)
-			{break;}
-		if(val.second.hasNum)
-		{
-			total += val.second.numVal;
-			nbElt++;
-		}
-		else
-		{
-			AFB_ERROR("There isn't numerical value to compare with in that signal '%s'. Stored value : bool %d, num %lf, str: %s",
-			id_.c_str(),
-			val.second.boolVal,
-			val.second.numVal,
-			val.second.strVal.c_str());
-			break;
-		}
-	}
-
-	return total / nbElt;
+	double avg = 0.0;
+	if(!history_.average(seconds, avg))
+		{AFB_ERROR("There isn't numerical value to make an average with in that signal '%s'", id_.c_str());}
+	return avg;
 }
 
 /// @brief Find minimum in the recorded values
 ///
-/// @param[in] seconds - period to find the minimum
+/// @param[in] seconds - period to find the minimum, 0 for the whole retention period
 ///
 /// @return Minimum value contained in the history
 double Signal::minimum(int seconds) const
 {
-	uint64_t begin = history_.begin()->first;
-	uint64_t end = seconds ?
-	begin+(seconds*MICRO) :
-	history_.rbegin()->first;
-
 	double min = DBL_MAX;
-	for (auto& v : history_)
-	{
-		if(v.first >= end)
-			{break;}
-		else if(v.second.hasNum && v.second.numVal < min)
-			{min = v.second.numVal;}
-		else
-		{
-			AFB_ERROR("There isn't numerical value to compare with in that signal '%s'. Stored value : bool %d, num %lf, str: %s",
-			id_.c_str(),
-			v.second.boolVal,
-			v.second.numVal,
-			v.second.strVal.c_str());
-			break;
-		}
-	}
+	if(!history_.minimum(seconds, min))
+		{AFB_ERROR("There isn't numerical value to compare with in that signal '%s'", id_.c_str());}
 	return min;
 }
 
 /// @brief Find maximum in the recorded values
 ///
-/// @param[in] seconds - period to find the maximum
+/// @param[in] seconds - period to find the maximum, 0 for the whole retention period
 ///
 /// @return Maximum value contained in the history
 double Signal::maximum(int seconds) const
 {
-	uint64_t begin = history_.begin()->first;
-	uint64_t end = seconds ?
-	begin+(seconds*MICRO) :
-	history_.rbegin()->first;
-
 	double max = 0.0;
-	for (auto& v : history_)
-	{
-		if(v.first >= end)
-		{break;}
-		else if(v.second.hasNum && v.second.hasNum > max)
-			{max = v.second.numVal;}
-		else
-		{
-			AFB_ERROR("There isn't numerical value to compare with in that signal '%s'. Stored value : bool %d, num %lf, str: %s",
-			id_.c_str(),
-			v.second.boolVal,
-			v.second.numVal,
-			v.second.strVal.c_str());
-			break;
-		}
-	}
+	if(!history_.maximum(seconds, max))
+		{AFB_ERROR("There isn't numerical value to compare with in that signal '%s'", id_.c_str());}
 	return max;
 }
 
@@ -421,43 +460,42 @@ double Signal::maximum(int seconds) const
 struct signalValue Signal::last() const
 {
 	if(history_.empty()) {return signalValue();}
-	return history_.rbegin()->second;
+	return history_.last();
 }
 
 
 /// @brief Recursion check to ensure that there is no infinite loop
 /// in the Observers/Observables structure.
-/// This will check that observer signal is not the same than itself
-/// then trigger the check against the following eventuals observers
+/// This will check that no observer, direct or not, is the signal itself.
 ///
 /// @return 0 if no infinite loop detected, -1 if not.
 int Signal::initialRecursionCheck()
 {
-	for (auto& obs: observerList_)
-	{
-		if(obs == this)
-			{return -1;}
-		if(static_cast<Signal*>(obs)->recursionCheck(static_cast<Signal*>(obs)))
-			{return -1;}
-	}
-	return 0;
+	return recursionCheck(this);
 }
 
-/// @brief Inner recursion check. Argument is the Signal id coming
-/// from the original Signal that made a recursion check.
+/// @brief Inner recursion check. Walks the observers of this signal, each
+/// one once, looking for the signal from which the check started.
 ///
-/// @param[in] origId - name of the origine of the recursion check
+/// @param[in] parentSig - signal at the origin of the recursion check
 ///
 /// @return 0 if no infinite loop detected, -1 if not.
 int Signal::recursionCheck(Signal* parentSig)
 {
-	for (const auto& obs: observerList_)
+	std::vector<Signal*> toVisit = {this};
+	std::set<Signal*> visited;
+	while(!toVisit.empty())
 	{
-		Signal* obsSig = static_cast<Signal*>(obs);
-		if(parentSig->id() == static_cast<Signal*>(obsSig)->id())
-			{return -1;}
-		if(! obsSig->recursionCheck(obsSig))
-			{return -1;}
+		Signal* sig = toVisit.back();
+		toVisit.pop_back();
+		for (const auto& obs: sig->observerList_)
+		{
+			Signal* obsSig = static_cast<Signal*>(obs);
+			if(obsSig == parentSig)
+				{return -1;}
+			if(visited.insert(obsSig).second)
+				{toVisit.push_back(obsSig);}
+		}
 	}
 	return 0;
 }
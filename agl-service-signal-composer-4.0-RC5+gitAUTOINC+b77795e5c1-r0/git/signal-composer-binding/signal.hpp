@@ -23,46 +23,34 @@
 #include <ctl-config.h>
 
 #include "observer-pattern.hpp"
+#include "signal-value.hpp"
+#include "signal-history.hpp"
 
 #define MICRO 1000000
 
 class Composer;
 
-/// @brief Structure holding a possible value of a Signal
-///  as it could be different type of value, we declare all
-///  possibility.
-///  Not very efficient or optimized, maybe use of Variant in
-///  C++17 but this is a bit too new to uses it for now
-struct signalValue {
-	bool hasBool;
-	bool boolVal;
-	bool hasNum;
-	double numVal;
-	bool hasStr;
-	std::string strVal;
-
-	signalValue():
-		hasBool(false), boolVal(false), hasNum(false), numVal(0), hasStr(false), strVal("") {};
-	signalValue(bool b):
-		hasBool(true), boolVal(b), hasNum(false), numVal(0), hasStr(false), strVal("") {};
-	signalValue(int b):
-		hasBool(true), boolVal(b), hasNum(false), numVal(0), hasStr(false), strVal("") {};
-	signalValue(double d):
-		hasBool(false), boolVal(false), hasNum(true), numVal(d), hasStr(false), strVal("") {};
-	signalValue(const std::string& s):
-		hasBool(false), boolVal(false), hasNum(false), numVal(0), hasStr(true), strVal(s) {};
-};
-
 extern "C" void searchNsetSignalValueHandle(const char* aName, uint64_t timestamp, struct signalValue value);
 extern "C" void setSignalValueHandle(void* aSignal, uint64_t timestamp, struct signalValue value);
+extern "C" void setSignalSamplesHandle(void* aSignal, const struct signalSample* samples, size_t count);
+
+#define SIGNALCBT_VERSION 3
 
-/// @brief Holds composer callbacks and obj to manipulate
+/// @brief Holds composer callbacks and obj to manipulate. Members are only
+///  appended, a plugin checks version before using members newer than the
+///  first version.
 struct signalCBT
 {
 	void (*searchNsetSignalValue)(const char* aName, uint64_t timestamp, struct signalValue value);
 	void (*setSignalValue)(void* aSignal, uint64_t timestamp, struct signalValue value);
 	void* aSignal;
 	void* pluginCtx;
+	// Version 2
+	uint32_t version;
+	uint32_t (*internString)(const char* s);
+	const char* (*lookupString)(uint32_t id);
+	// Version 3
+	void (*setSignalSamples)(void* aSignal, const struct signalSample* samples, size_t count);
 };
 
 
@@ -80,9 +68,10 @@ private:
 	std::vector<std::string> dependsSigV_;
 	uint64_t timestamp_;
 	struct signalValue value_;
-	std::map<uint64_t, struct signalValue> history_; ///< history_ - Hold signal value history in map with <timestamp, value>
+	SignalHistory history_; ///< history_ - Hold signal values received during the retention period, with their timestamp
 	int retention_;
 	double frequency_;
+	int window_; ///< window_ - Coalescing window in ms of dependencies changes before evaluating a virtual signal
 	std::string unit_;
 	CtlActionT* onReceived_;
 	json_object* getSignalsArgs_;
@@ -91,8 +80,8 @@ private:
 public:
 	bool subscribed_; ///< subscribed_ - boolean value telling if yes or no the signal has been subcribed to the low level binding.
 	Signal();
-	Signal(const std::string& id, const std::string& event, std::vector<std::string>& depends, const std::string& unit, int retention, double frequency, CtlActionT* onReceived, json_object* getSignalsArgs);
-	Signal(const std::string& id, std::vector<std::string>& depends, const std::string& unit, int retention, double frequency, CtlActionT* onReceived);
+	Signal(const std::string& id, const std::string& event, std::vector<std::string>& depends, const std::string& unit, int retention, double frequency, int window, CtlActionT* onReceived, json_object* getSignalsArgs);
+	Signal(const std::string& id, std::vector<std::string>& depends, const std::string& unit, int retention, double frequency, int window, CtlActionT* onReceived);
 	~Signal();
 
 	explicit operator bool() const;
@@ -100,6 +89,9 @@ public:
 	bool operator==(const std::string& aName) const;
 
 	const std::string id() const;
+	const std::string event() const;
+	int window() const;
+	std::vector<Signal*> observers() const;
 	json_object* toJSON() const;
 	struct signalCBT* get_context();
 
@@ -107,7 +99,9 @@ public:
 	void update(Signal* sig);
 	static int defaultOnReceivedCB(CtlSourceT* source, json_object* argsJ, json_object *queryJ);
 	void defaultReceivedCB(json_object *eventJ);
+	static uint64_t receptionTime();
 	void onReceivedCB(json_object *eventJ);
+	void evaluate(Signal* trigger);
 	void attachToSourceSignals(Composer& composer);
 
 	double average(int seconds = 0) const;
@@ -21,13 +21,13 @@
 SourceAPI::SourceAPI()
 {}
 
-SourceAPI::SourceAPI(const std::string& uid, const std::string& api, const std::string& info, CtlActionT* init, CtlActionT* getSignals, CtlActionT* onReceived, int retention):
+SourceAPI::SourceAPI(const std::string& uid, const std::string& api, const std::string& info, CtlActionT* init, CtlActionT* getSignals, json_object* onReceivedJ, int retention):
  uid_{uid},
  api_{api},
  info_{info},
  init_{init},
  getSignals_{getSignals},
- signalsDefault_({onReceived, retention})
+ signalsDefault_({onReceivedJ, retention})
 {}
 
 bool SourceAPI::operator ==(const SourceAPI& other) const
@@ -67,9 +67,9 @@ const struct signalsDefault& SourceAPI::signalsDefault() const
 	return signalsDefault_;
 }
 
-void SourceAPI::addSignal(const std::string& id, const std::string& event, std::vector<std::string>& depends, int retention, const std::string& unit, double frequency, CtlActionT* onReceived, json_object* getSignalsArgs)
+void SourceAPI::addSignal(const std::string& id, const std::string& event, std::vector<std::string>& depends, int retention, const std::string& unit, double frequency, int window, CtlActionT* onReceived, json_object* getSignalsArgs)
 {
-	std::shared_ptr<Signal> sig = std::make_shared<Signal>(id, event, depends, unit, retention, frequency, onReceived, getSignalsArgs);
+	std::shared_ptr<Signal> sig = std::make_shared<Signal>(id, event, depends, unit, retention, frequency, window, onReceived, getSignalsArgs);
 
 	newSignalsM_[id] = sig;
 }
@@ -20,7 +20,7 @@
 #include "signal.hpp"
 
 struct signalsDefault {
-	CtlActionT* onReceived;
+	json_object* onReceivedJ;
 	int retention;
 };
 
@@ -39,7 +39,7 @@ private:
 
 public:
 	SourceAPI();
-	SourceAPI(const std::string& uid_, const std::string& api, const std::string& info, CtlActionT* init, CtlActionT* getSignal, CtlActionT* onReceived, int retention);
+	SourceAPI(const std::string& uid_, const std::string& api, const std::string& info, CtlActionT* init, CtlActionT* getSignal, json_object* onReceivedJ, int retention);
 
 	bool operator==(const SourceAPI& other) const;
 	bool operator==(const std::string& aName) const;
@@ -47,7 +47,7 @@ public:
 	void init();
 	std::string api() const;
 	const struct signalsDefault& signalsDefault() const;
-	void addSignal(const std::string& id, const std::string& event, std::vector<std::string>& sources, int retention, const std::string& unit, double frequency, CtlActionT* onReceived, json_object* getSignalsArgs);
+	void addSignal(const std::string& id, const std::string& event, std::vector<std::string>& sources, int retention, const std::string& unit, double frequency, int window, CtlActionT* onReceived, json_object* getSignalsArgs);
 
 	void initSignals();
 	std::vector<std::shared_ptr<Signal>> getSignals() const;